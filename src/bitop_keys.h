@@ -13,6 +13,18 @@ typedef struct {
 
 typedef void (*BitOpKeyReporter)(void* ctx, int pos, int flags);
 
+/**
+ * End of a variadic key list followed by an optional `<option> <value>` pair, which is only
+ * recognized when there are at least `min_argc` arguments.
+ */
+static inline int KeysEndBeforeOption(int argc, const char* before_last, const char* option, int min_argc) {
+  if (argc >= min_argc && before_last != NULL && strcmp(before_last, option) == 0) {
+    return argc - 2;
+  }
+
+  return argc;
+}
+
 static inline bool BitOpIsVariadicOperation(const char* operation) {
   return strcmp(operation, "AND") == 0
       || strcmp(operation, "OR") == 0
@@ -68,3 +80,108 @@ static inline size_t BitOpForEachKeyPosition(const char* operation, int argc, vo
 
   return count;
 }
+
+/**
+ * Key positions of the read-only BITOP variants (R.BITOPCARD): every argument after the operation is a source key.
+ */
+static inline size_t BitOpReadForEachKeyPosition(const char* operation, int argc, void* ctx, BitOpKeyReporter reporter) {
+  if (operation == NULL || !BitOpIsVariadicOperation(operation) || argc < 4) {
+    return 0;
+  }
+
+  size_t count = 0;
+  for (int pos = 2; pos < argc; pos++) {
+    if (reporter != NULL) {
+      reporter(ctx, pos, REDISMODULE_CMD_KEY_RO | REDISMODULE_CMD_KEY_ACCESS);
+    }
+    count++;
+  }
+
+  return count;
+}
+
+/**
+ * End of the key arguments of R.BITOPGET: a trailing `LIMIT <count>` after at least one key is not a key.
+ * The command rejects a LIMIT left with a single key, rather than reading `LIMIT` as a key name.
+ */
+static inline int BitOpGetKeysEnd(int argc, const char* before_last) {
+  return KeysEndBeforeOption(argc, before_last, "LIMIT", 5);
+}
+
+/**
+ * End of the key arguments of R.SIMILARITY: a trailing `METRIC <metric>` after at least one key is not a key.
+ */
+static inline int SimilarityKeysEnd(int argc, const char* before_last) {
+  return KeysEndBeforeOption(argc, before_last, "METRIC", 4);
+}
+
+typedef enum {
+  TOPK_SOURCE_KEYS,
+  TOPK_SOURCE_MATCH,
+  TOPK_SOURCE_MEMBERS
+} TopKSource;
+
+/**
+ * End of the candidate arguments of R.TOPK: a trailing `METRIC <metric>` after at least one candidate is not a key.
+ */
+static inline int TopKKeysEnd(int argc, const char* before_last) {
+  return KeysEndBeforeOption(argc, before_last, "METRIC", 6);
+}
+
+/**
+ * Candidates of R.TOPK <query> <k> are either keys, `MATCH <pattern> COUNT <count>` or `MEMBERS <setkey>`.
+ * `option` is the argument after the pattern (argv[5]), NULL when there is none. MATCH without COUNT is
+ * still recognized, so that the command can reject it instead of reading the pattern as a key.
+ */
+static inline TopKSource TopKParseSource(int keys_end, const char* source, const char* option) {
+  if (source == NULL) {
+    return TOPK_SOURCE_KEYS;
+  }
+  if (strcmp(source, "MATCH") == 0
+      && (keys_end == 5 || (keys_end == 7 && option != NULL && strcmp(option, "COUNT") == 0))) {
+    return TOPK_SOURCE_MATCH;
+  }
+  if (keys_end == 5 && strcmp(source, "MEMBERS") == 0) {
+    return TOPK_SOURCE_MEMBERS;
+  }
+
+  return TOPK_SOURCE_KEYS;
+}
+
+/**
+ * Key positions of R.TOPK: the query, then the candidate keys or the set key. Keys found by MATCH are
+ * only known at runtime and cannot be reported.
+ */
+static inline size_t TopKForEachKeyPosition(int argc, const char* source, const char* option, const char* before_last,
+                                            void* ctx, BitOpKeyReporter reporter) {
+  if (argc < 4) {
+    return 0;
+  }
+
+  int keys_end = TopKKeysEnd(argc, before_last);
+  int first = 3;
+  switch (TopKParseSource(keys_end, source, option)) {
+    case TOPK_SOURCE_MATCH:
+      first = keys_end;
+      break;
+    case TOPK_SOURCE_MEMBERS:
+      first = 4;
+      break;
+    case TOPK_SOURCE_KEYS:
+      break;
+  }
+
+  if (reporter != NULL) {
+    reporter(ctx, 1, REDISMODULE_CMD_KEY_RO | REDISMODULE_CMD_KEY_ACCESS);
+  }
+
+  size_t count = 1;
+  for (int pos = first; pos < keys_end; pos++) {
+    if (reporter != NULL) {
+      reporter(ctx, pos, REDISMODULE_CMD_KEY_RO | REDISMODULE_CMD_KEY_ACCESS);
+    }
+    count++;
+  }
+
+  return count;
+}
@@ -0,0 +1,173 @@
+#include "cardinality-cache.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <string.h>
+#include "redismodule.h"
+#include "rmalloc.h"
+
+typedef enum {
+  CARDINALITY_CLEAN,
+  // Opened for writing once since the count was taken, a single adjustment brings it up to date
+  CARDINALITY_WRITING,
+  CARDINALITY_STALE
+} CardinalityState;
+
+typedef struct {
+  uint64_t cardinality;
+  CardinalityState state;
+  bool compacted;
+} CardinalityEntry;
+
+// Only the main thread touches the dict, so the per-command lookups take no lock. Values may be
+// released from the lazyfree thread: those removals are queued under a lock, before the bitmap is
+// freed and its address can be reused, and applied by the main thread before its next lookup.
+static RedisModuleDict* Cardinalities = NULL;
+static pthread_t MainThread;
+
+static pthread_mutex_t PendingLock = PTHREAD_MUTEX_INITIALIZER;
+static const void** PendingRemovals = NULL;
+static size_t PendingCount = 0;
+static size_t PendingCapacity = 0;
+static atomic_bool HasPendingRemovals = false;
+
+// Key of the last entry visited by an interrupted `cardinality_cache_defrag`
+static const void* DefragLast = NULL;
+static bool DefragResume = false;
+
+static void RemoveEntry(const void* bitmap) {
+  CardinalityEntry* entry = NULL;
+  if (RedisModule_DictSize(Cardinalities) > 0) {
+    RedisModule_DictDelC(Cardinalities, (void*) &bitmap, sizeof(bitmap), &entry);
+  }
+  rm_free(entry);
+}
+
+static void ApplyPendingRemovals(void) {
+  if (!atomic_load_explicit(&HasPendingRemovals, memory_order_acquire)) {
+    return;
+  }
+
+  pthread_mutex_lock(&PendingLock);
+  for (size_t i = 0; i < PendingCount; i++) {
+    RemoveEntry(PendingRemovals[i]);
+  }
+  PendingCount = 0;
+  atomic_store_explicit(&HasPendingRemovals, false, memory_order_relaxed);
+  pthread_mutex_unlock(&PendingLock);
+}
+
+static CardinalityEntry* GetEntry(const void* bitmap) {
+  ApplyPendingRemovals();
+  if (RedisModule_DictSize(Cardinalities) == 0) {
+    return NULL;
+  }
+  return RedisModule_DictGetC(Cardinalities, (void*) &bitmap, sizeof(bitmap), NULL);
+}
+
+static CardinalityEntry* GetOrCreateEntry(const void* bitmap) {
+  CardinalityEntry* entry = GetEntry(bitmap);
+  if (entry == NULL) {
+    entry = rm_malloc(sizeof(*entry));
+    *entry = (CardinalityEntry) {.cardinality = 0, .state = CARDINALITY_STALE, .compacted = false};
+    RedisModule_DictSetC(Cardinalities, (void*) &bitmap, sizeof(bitmap), entry);
+  }
+  return entry;
+}
+
+void cardinality_cache_init(void) {
+  Cardinalities = RedisModule_CreateDict(NULL);
+  MainThread = pthread_self();
+}
+
+bool cardinality_cache_get(const void* bitmap, uint64_t* cardinality) {
+  CardinalityEntry* entry = GetEntry(bitmap);
+  bool found = entry != NULL && entry->state == CARDINALITY_CLEAN;
+  if (found) {
+    *cardinality = entry->cardinality;
+  }
+  return found;
+}
+
+void cardinality_cache_set(const void* bitmap, uint64_t cardinality) {
+  CardinalityEntry* entry = GetOrCreateEntry(bitmap);
+  entry->cardinality = cardinality;
+  entry->state = CARDINALITY_CLEAN;
+}
+
+void cardinality_cache_begin_write(const void* bitmap) {
+  CardinalityEntry* entry = GetEntry(bitmap);
+  if (entry != NULL) {
+    entry->state = entry->state == CARDINALITY_CLEAN ? CARDINALITY_WRITING : CARDINALITY_STALE;
+    entry->compacted = false;
+  }
+}
+
+void cardinality_cache_adjust(const void* bitmap, int64_t delta) {
+  CardinalityEntry* entry = GetEntry(bitmap);
+  if (entry != NULL && entry->state == CARDINALITY_WRITING) {
+    entry->cardinality += (uint64_t) delta;
+    entry->state = CARDINALITY_CLEAN;
+  }
+}
+
+bool cardinality_cache_is_compacted(const void* bitmap) {
+  CardinalityEntry* entry = GetEntry(bitmap);
+  return entry != NULL && entry->compacted;
+}
+
+void cardinality_cache_set_compacted(const void* bitmap) {
+  GetOrCreateEntry(bitmap)->compacted = true;
+}
+
+void cardinality_cache_remove(const void* bitmap) {
+  if (pthread_equal(pthread_self(), MainThread)) {
+    ApplyPendingRemovals();
+    RemoveEntry(bitmap);
+    return;
+  }
+
+  pthread_mutex_lock(&PendingLock);
+  if (PendingCount == PendingCapacity) {
+    PendingCapacity = PendingCapacity == 0 ? 64 : PendingCapacity * 2;
+    PendingRemovals = rm_realloc(PendingRemovals, PendingCapacity * sizeof(*PendingRemovals));
+  }
+  PendingRemovals[PendingCount++] = bitmap;
+  atomic_store_explicit(&HasPendingRemovals, true, memory_order_release);
+  pthread_mutex_unlock(&PendingLock);
+}
+
+void cardinality_cache_move(const void* from, const void* to) {
+  CardinalityEntry* entry = NULL;
+  ApplyPendingRemovals();
+  if (RedisModule_DictSize(Cardinalities) > 0 &&
+      RedisModule_DictDelC(Cardinalities, (void*) &from, sizeof(from), &entry) == REDISMODULE_OK) {
+    RedisModule_DictSetC(Cardinalities, (void*) &to, sizeof(to), entry);
+  }
+}
+
+void cardinality_cache_defrag(RedisModuleDefragCtx* ctx) {
+  ApplyPendingRemovals();
+  RedisModuleDictIter* iter = DefragResume
+                                  ? RedisModule_DictIteratorStartC(Cardinalities, ">", &DefragLast, sizeof(DefragLast))
+                                  : RedisModule_DictIteratorStartC(Cardinalities, "^", NULL, 0);
+  DefragResume = false;
+
+  size_t key_len;
+  CardinalityEntry* entry;
+  void* key;
+  while ((key = RedisModule_DictNextC(iter, &key_len, (void**) &entry)) != NULL) {
+    CardinalityEntry* moved = RedisModule_DefragAlloc(ctx, entry);
+    if (moved != NULL) {
+      // Overwriting the value of an existing key doesn't invalidate the iterator
+      RedisModule_DictReplaceC(Cardinalities, key, key_len, moved);
+    }
+
+    if (RedisModule_DefragShouldStop(ctx)) {
+      memcpy(&DefragLast, key, sizeof(DefragLast));
+      DefragResume = true;
+      break;
+    }
+  }
+
+  RedisModule_DictIteratorStop(iter);
+}
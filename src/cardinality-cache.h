@@ -0,0 +1,48 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "redismodule.h"
+
+/**
+ * Cardinalities of the bitmaps stored in the keyspace, keyed by bitmap pointer, so that reading the
+ * count of a key doesn't sum all of its containers every time. Only keyspace values may be cached:
+ * entries are dropped by the type free callbacks, which is what keeps a reused address from hitting
+ * a stale entry.
+ *
+ * Opening a key for writing calls `cardinality_cache_begin_write`. Commands that know how many values
+ * they changed then call `cardinality_cache_adjust`, for every other write the entry is stale and the
+ * next read recomputes it.
+ *
+ * Entries also remember whether the background optimizer compacted the bitmap since it was last opened
+ * for writing.
+ *
+ * Every function but `cardinality_cache_remove` must be called from the main thread, and takes no lock:
+ * a hit costs one dict lookup. `cardinality_cache_remove` may also run on the lazyfree thread.
+ */
+void cardinality_cache_init(void);
+/**
+ * Returns false when the bitmap has no up to date entry.
+ */
+bool cardinality_cache_get(const void* bitmap, uint64_t* cardinality);
+void cardinality_cache_set(const void* bitmap, uint64_t cardinality);
+void cardinality_cache_begin_write(const void* bitmap);
+/**
+ * Applies the change of the write started by the last `cardinality_cache_begin_write`.
+ */
+void cardinality_cache_adjust(const void* bitmap, int64_t delta);
+void cardinality_cache_remove(const void* bitmap);
+/**
+ * Moves the entry of a bitmap relocated from `from` to `to`.
+ */
+void cardinality_cache_move(const void* from, const void* to);
+/**
+ * Relocates the entries for active defragmentation, resuming after the entry where the previous call
+ * stopped.
+ */
+void cardinality_cache_defrag(RedisModuleDefragCtx* ctx);
+/**
+ * Whether the bitmap was compacted and not opened for writing since.
+ */
+bool cardinality_cache_is_compacted(const void* bitmap);
+void cardinality_cache_set_compacted(const void* bitmap);
@@ -66,7 +66,7 @@ static const RedisModuleCommandInfo R_GETBIT_INFO = {
 };
 
 // ===============================
-// R64.GETBITS key offset [offset...]
+// R64.GETBITS key <offset [offset...] | PACKED offsets>
 // ===============================
 static const RedisModuleCommandKeySpec R_GETBITS_KEYSPECS[] = {
   {.flags = REDISMODULE_CMD_KEY_RO | REDISMODULE_CMD_KEY_ACCESS,
@@ -78,13 +78,22 @@ static const RedisModuleCommandKeySpec R_GETBITS_KEYSPECS[] = {
 
 static const RedisModuleCommandArg R_GETBITS_ARGS[] = {
   {.name = "key", .type = REDISMODULE_ARG_TYPE_KEY, .key_spec_index = 0},
-  {.name = "offset", .type = REDISMODULE_ARG_TYPE_INTEGER, .flags = REDISMODULE_CMD_ARG_MULTIPLE},
+  {
+    .name = "offsets",
+    .type = REDISMODULE_ARG_TYPE_ONEOF,
+    .subargs =
+      (RedisModuleCommandArg[]){
+        {.name = "offset", .type = REDISMODULE_ARG_TYPE_INTEGER, .flags = REDISMODULE_CMD_ARG_MULTIPLE},
+        {.name = "packed", .type = REDISMODULE_ARG_TYPE_STRING, .token = "PACKED"},
+        {0},
+      }
+  },
   {0} };
 
 static const RedisModuleCommandInfo R_GETBITS_INFO = {
   .version = REDISMODULE_COMMAND_INFO_VERSION,
   .summary = "Retrieves multiple values of the specified bit from a Roaring key",
-  .complexity = "O(N), where n is the number of offsets",
+  .complexity = "O(N log N), where n is the number of offsets",
   .since = "1.0.0",
   .arity = -3,
   .key_specs = (RedisModuleCommandKeySpec*) R_GETBITS_KEYSPECS,
@@ -118,7 +127,7 @@ static const RedisModuleCommandInfo R_CLEARBITS_INFO = {
 };
 
 // ===============================
-// R64.SETINTARRAY key value [value...]
+// R64.SETINTARRAY key <value [value...] | PACKED [DELTA] [VARINT] values>
 // ===============================
 static const RedisModuleCommandKeySpec R_SETINTARRAY_KEYSPECS[] = {
   {.flags = REDISMODULE_CMD_KEY_OW | REDISMODULE_CMD_KEY_INSERT,
@@ -130,7 +139,27 @@ static const RedisModuleCommandKeySpec R_SETINTARRAY_KEYSPECS[] = {
 
 static const RedisModuleCommandArg R_SETINTARRAY_ARGS[] = {
   {.name = "key", .type = REDISMODULE_ARG_TYPE_KEY, .key_spec_index = 0},
-  {.name = "value", .type = REDISMODULE_ARG_TYPE_INTEGER, .flags = REDISMODULE_CMD_ARG_MULTIPLE},
+  {
+    .name = "values",
+    .type = REDISMODULE_ARG_TYPE_ONEOF,
+    .subargs =
+      (RedisModuleCommandArg[]){
+        {.name = "value", .type = REDISMODULE_ARG_TYPE_INTEGER, .flags = REDISMODULE_CMD_ARG_MULTIPLE},
+        {
+          .name = "packed",
+          .type = REDISMODULE_ARG_TYPE_BLOCK,
+          .token = "PACKED",
+          .subargs =
+            (RedisModuleCommandArg[]){
+              {.name = "delta", .type = REDISMODULE_ARG_TYPE_PURE_TOKEN, .token = "DELTA", .flags = REDISMODULE_CMD_ARG_OPTIONAL},
+              {.name = "varint", .type = REDISMODULE_ARG_TYPE_PURE_TOKEN, .token = "VARINT", .flags = REDISMODULE_CMD_ARG_OPTIONAL},
+              {.name = "values", .type = REDISMODULE_ARG_TYPE_STRING},
+              {0},
+            }
+        },
+        {0},
+      }
+  },
   {0} };
 
 static const RedisModuleCommandInfo R_SETINTARRAY_INFO = {
@@ -196,7 +225,7 @@ static const RedisModuleCommandInfo R_RANGEINTARRAY_INFO = {
 };
 
 // ===============================
-// R64.APPENDINTARRAY key value [value...]
+// R64.APPENDINTARRAY key <value [value...] | PACKED [DELTA] [VARINT] values>
 // ===============================
 static const RedisModuleCommandKeySpec R_APPENDINTARRAY_KEYSPECS[] = {
   {.flags = REDISMODULE_CMD_KEY_RW | REDISMODULE_CMD_KEY_INSERT,
@@ -208,7 +237,27 @@ static const RedisModuleCommandKeySpec R_APPENDINTARRAY_KEYSPECS[] = {
 
 static const RedisModuleCommandArg R_APPENDINTARRAY_ARGS[] = {
   {.name = "key", .type = REDISMODULE_ARG_TYPE_KEY, .key_spec_index = 0},
-  {.name = "value", .type = REDISMODULE_ARG_TYPE_INTEGER, .flags = REDISMODULE_CMD_ARG_MULTIPLE},
+  {
+    .name = "values",
+    .type = REDISMODULE_ARG_TYPE_ONEOF,
+    .subargs =
+      (RedisModuleCommandArg[]){
+        {.name = "value", .type = REDISMODULE_ARG_TYPE_INTEGER, .flags = REDISMODULE_CMD_ARG_MULTIPLE},
+        {
+          .name = "packed",
+          .type = REDISMODULE_ARG_TYPE_BLOCK,
+          .token = "PACKED",
+          .subargs =
+            (RedisModuleCommandArg[]){
+              {.name = "delta", .type = REDISMODULE_ARG_TYPE_PURE_TOKEN, .token = "DELTA", .flags = REDISMODULE_CMD_ARG_OPTIONAL},
+              {.name = "varint", .type = REDISMODULE_ARG_TYPE_PURE_TOKEN, .token = "VARINT", .flags = REDISMODULE_CMD_ARG_OPTIONAL},
+              {.name = "values", .type = REDISMODULE_ARG_TYPE_STRING},
+              {0},
+            }
+        },
+        {0},
+      }
+  },
   {0} };
 
 static const RedisModuleCommandInfo R_APPENDINTARRAY_INFO = {
@@ -466,7 +515,7 @@ static const RedisModuleCommandArg R_BITCOUNT_ARGS[] = {
 static const RedisModuleCommandInfo R_BITCOUNT_INFO = {
   .version = REDISMODULE_COMMAND_INFO_VERSION,
   .summary = "Counts the number of bits that have a value of 1",
-  .complexity = "O(M)",
+  .complexity = "O(1), O(M) after a write",
   .since = "1.0.0",
   .arity = 2,
   .key_specs = (RedisModuleCommandKeySpec*) R_BITCOUNT_KEYSPECS,
@@ -655,6 +704,265 @@ static const RedisModuleCommandInfo R_JACCARD_INFO = {
   .args = (RedisModuleCommandArg*) R_JACCARD_ARGS,
 };
 
+// ===============================
+// R64.GETSERIALIZED key
+// ===============================
+static const RedisModuleCommandKeySpec R_GETSERIALIZED_KEYSPECS[] = {
+  {.flags = REDISMODULE_CMD_KEY_RO | REDISMODULE_CMD_KEY_ACCESS,
+   .begin_search_type = REDISMODULE_KSPEC_BS_INDEX,
+   .bs.index = {.pos = 1},
+   .find_keys_type = REDISMODULE_KSPEC_FK_RANGE,
+   .fk.range = {.lastkey = 0, .keystep = 1, .limit = 0}},
+  {0} };
+
+static const RedisModuleCommandArg R_GETSERIALIZED_ARGS[] = {
+  {.name = "key", .type = REDISMODULE_ARG_TYPE_KEY, .key_spec_index = 0},
+  {0} };
+
+static const RedisModuleCommandInfo R_GETSERIALIZED_INFO = {
+  .version = REDISMODULE_COMMAND_INFO_VERSION,
+  .summary = "Returns the 64-bit Roaring bitmap in the portable serialization format",
+  .complexity = "O(C)",
+  .since = "1.0.0",
+  .arity = 2,
+  .key_specs = (RedisModuleCommandKeySpec*) R_GETSERIALIZED_KEYSPECS,
+  .args = (RedisModuleCommandArg*) R_GETSERIALIZED_ARGS,
+};
+
+// ===============================
+// R64.SETSERIALIZED key serialized
+// ===============================
+static const RedisModuleCommandKeySpec R_SETSERIALIZED_KEYSPECS[] = {
+  {.flags = REDISMODULE_CMD_KEY_OW | REDISMODULE_CMD_KEY_INSERT,
+   .begin_search_type = REDISMODULE_KSPEC_BS_INDEX,
+   .bs.index = {.pos = 1},
+   .find_keys_type = REDISMODULE_KSPEC_FK_RANGE,
+   .fk.range = {.lastkey = 0, .keystep = 1, .limit = 0}},
+  {0} };
+
+static const RedisModuleCommandArg R_SETSERIALIZED_ARGS[] = {
+  {.name = "key", .type = REDISMODULE_ARG_TYPE_KEY, .key_spec_index = 0},
+  {.name = "serialized", .type = REDISMODULE_ARG_TYPE_STRING},
+  {0} };
+
+static const RedisModuleCommandInfo R_SETSERIALIZED_INFO = {
+  .version = REDISMODULE_COMMAND_INFO_VERSION,
+  .summary = "Creates a Roaring key from a 64-bit bitmap in the portable serialization format",
+  .complexity = "O(N), where n is the size of the serialized bitmap",
+  .since = "1.0.0",
+  .arity = 3,
+  .key_specs = (RedisModuleCommandKeySpec*) R_SETSERIALIZED_KEYSPECS,
+  .args = (RedisModuleCommandArg*) R_SETSERIALIZED_ARGS,
+};
+
+// ===============================
+// R64.SCAN key cursor [COUNT count]
+// ===============================
+static const RedisModuleCommandKeySpec R_SCAN_KEYSPECS[] = {
+  {.flags = REDISMODULE_CMD_KEY_RO | REDISMODULE_CMD_KEY_ACCESS,
+   .begin_search_type = REDISMODULE_KSPEC_BS_INDEX,
+   .bs.index = {.pos = 1},
+   .find_keys_type = REDISMODULE_KSPEC_FK_RANGE,
+   .fk.range = {.lastkey = 0, .keystep = 1, .limit = 0}},
+  {0} };
+
+static const RedisModuleCommandArg R_SCAN_ARGS[] = {
+  {.name = "key", .type = REDISMODULE_ARG_TYPE_KEY, .key_spec_index = 0},
+  {.name = "cursor", .type = REDISMODULE_ARG_TYPE_INTEGER},
+  {.name = "count", .type = REDISMODULE_ARG_TYPE_INTEGER, .token = "COUNT", .flags = REDISMODULE_CMD_ARG_OPTIONAL},
+  {0} };
+
+static const RedisModuleCommandInfo R_SCAN_INFO = {
+  .version = REDISMODULE_COMMAND_INFO_VERSION,
+  .summary = "Incrementally iterates over the values of a Roaring key, starting at the cursor",
+  .complexity = "O(M), where m is the number of values returned",
+  .since = "1.0.0",
+  .arity = -3,
+  .key_specs = (RedisModuleCommandKeySpec*) R_SCAN_KEYSPECS,
+  .args = (RedisModuleCommandArg*) R_SCAN_ARGS,
+};
+
+// ===============================
+// R64.RANGEBYVALUE key min max [LIMIT offset count]
+// ===============================
+static const RedisModuleCommandKeySpec R_RANGEBYVALUE_KEYSPECS[] = {
+  {.flags = REDISMODULE_CMD_KEY_RO | REDISMODULE_CMD_KEY_ACCESS,
+   .begin_search_type = REDISMODULE_KSPEC_BS_INDEX,
+   .bs.index = {.pos = 1},
+   .find_keys_type = REDISMODULE_KSPEC_FK_RANGE,
+   .fk.range = {.lastkey = 0, .keystep = 1, .limit = 0}},
+  {0} };
+
+static const RedisModuleCommandArg R_RANGEBYVALUE_ARGS[] = {
+  {.name = "key", .type = REDISMODULE_ARG_TYPE_KEY, .key_spec_index = 0},
+  {.name = "min", .type = REDISMODULE_ARG_TYPE_INTEGER},
+  {.name = "max", .type = REDISMODULE_ARG_TYPE_INTEGER},
+  {
+    .name = "limit",
+    .type = REDISMODULE_ARG_TYPE_BLOCK,
+    .token = "LIMIT",
+    .flags = REDISMODULE_CMD_ARG_OPTIONAL,
+    .subargs =
+      (RedisModuleCommandArg[]){
+        {.name = "offset", .type = REDISMODULE_ARG_TYPE_INTEGER},
+        {.name = "count", .type = REDISMODULE_ARG_TYPE_INTEGER},
+        {0},
+      }
+  },
+  {0} };
+
+static const RedisModuleCommandInfo R_RANGEBYVALUE_INFO = {
+  .version = REDISMODULE_COMMAND_INFO_VERSION,
+  .summary = "Returns the values of a Roaring key between min and max",
+  .complexity = "O(C + M), where m is the number of values returned",
+  .since = "1.0.0",
+  .arity = -4,
+  .key_specs = (RedisModuleCommandKeySpec*) R_RANGEBYVALUE_KEYSPECS,
+  .args = (RedisModuleCommandArg*) R_RANGEBYVALUE_ARGS,
+};
+
+// ===============================
+// R64.COUNTRANGE key min max
+// ===============================
+static const RedisModuleCommandKeySpec R_COUNTRANGE_KEYSPECS[] = {
+  {.flags = REDISMODULE_CMD_KEY_RO | REDISMODULE_CMD_KEY_ACCESS,
+   .begin_search_type = REDISMODULE_KSPEC_BS_INDEX,
+   .bs.index = {.pos = 1},
+   .find_keys_type = REDISMODULE_KSPEC_FK_RANGE,
+   .fk.range = {.lastkey = 0, .keystep = 1, .limit = 0}},
+  {0} };
+
+static const RedisModuleCommandArg R_COUNTRANGE_ARGS[] = {
+  {.name = "key", .type = REDISMODULE_ARG_TYPE_KEY, .key_spec_index = 0},
+  {.name = "min", .type = REDISMODULE_ARG_TYPE_INTEGER},
+  {.name = "max", .type = REDISMODULE_ARG_TYPE_INTEGER},
+  {0} };
+
+static const RedisModuleCommandInfo R_COUNTRANGE_INFO = {
+  .version = REDISMODULE_COMMAND_INFO_VERSION,
+  .summary = "Counts the values of a Roaring key between min and max",
+  .complexity = "O(C)",
+  .since = "1.0.0",
+  .arity = 4,
+  .key_specs = (RedisModuleCommandKeySpec*) R_COUNTRANGE_KEYSPECS,
+  .args = (RedisModuleCommandArg*) R_COUNTRANGE_ARGS,
+};
+
+// ===============================
+// R64.RANK key value [value...]
+// ===============================
+static const RedisModuleCommandKeySpec R_RANK_KEYSPECS[] = {
+  {.flags = REDISMODULE_CMD_KEY_RO | REDISMODULE_CMD_KEY_ACCESS,
+   .begin_search_type = REDISMODULE_KSPEC_BS_INDEX,
+   .bs.index = {.pos = 1},
+   .find_keys_type = REDISMODULE_KSPEC_FK_RANGE,
+   .fk.range = {.lastkey = 0, .keystep = 1, .limit = 0}},
+  {0} };
+
+static const RedisModuleCommandArg R_RANK_ARGS[] = {
+  {.name = "key", .type = REDISMODULE_ARG_TYPE_KEY, .key_spec_index = 0},
+  {.name = "value", .type = REDISMODULE_ARG_TYPE_INTEGER, .flags = REDISMODULE_CMD_ARG_MULTIPLE},
+  {0} };
+
+static const RedisModuleCommandInfo R_RANK_INFO = {
+  .version = REDISMODULE_COMMAND_INFO_VERSION,
+  .summary = "Returns the number of values of a Roaring key smaller or equal to each value",
+  .complexity = "O(C) per value",
+  .since = "1.0.0",
+  .arity = -3,
+  .key_specs = (RedisModuleCommandKeySpec*) R_RANK_KEYSPECS,
+  .args = (RedisModuleCommandArg*) R_RANK_ARGS,
+};
+
+// ===============================
+// R64.SELECT key n [n...]
+// ===============================
+static const RedisModuleCommandKeySpec R_SELECT_KEYSPECS[] = {
+  {.flags = REDISMODULE_CMD_KEY_RO | REDISMODULE_CMD_KEY_ACCESS,
+   .begin_search_type = REDISMODULE_KSPEC_BS_INDEX,
+   .bs.index = {.pos = 1},
+   .find_keys_type = REDISMODULE_KSPEC_FK_RANGE,
+   .fk.range = {.lastkey = 0, .keystep = 1, .limit = 0}},
+  {0} };
+
+static const RedisModuleCommandArg R_SELECT_ARGS[] = {
+  {.name = "key", .type = REDISMODULE_ARG_TYPE_KEY, .key_spec_index = 0},
+  {.name = "n", .type = REDISMODULE_ARG_TYPE_INTEGER, .flags = REDISMODULE_CMD_ARG_MULTIPLE},
+  {0} };
+
+static const RedisModuleCommandInfo R_SELECT_INFO = {
+  .version = REDISMODULE_COMMAND_INFO_VERSION,
+  .summary = "Returns the n-th smallest value of a Roaring key for each 1-based n",
+  .complexity = "O(C) per n",
+  .since = "1.0.0",
+  .arity = -3,
+  .key_specs = (RedisModuleCommandKeySpec*) R_SELECT_KEYSPECS,
+  .args = (RedisModuleCommandArg*) R_SELECT_ARGS,
+};
+
+// ===============================
+// R64.BITOPCARD operation key1 key2 [key...]
+// ===============================
+static const RedisModuleCommandKeySpec R_BITOPCARD_KEYSPECS[] = {
+  {
+    .begin_search_type = REDISMODULE_KSPEC_BS_INDEX,
+    .bs.index.pos = 2,
+    .find_keys_type = REDISMODULE_KSPEC_FK_RANGE,
+    .fk.range = {.lastkey = -1, .keystep = 1, .limit = 0},
+    .flags = REDISMODULE_CMD_KEY_RO | REDISMODULE_CMD_KEY_ACCESS
+  },
+  {0}
+};
+
+static const RedisModuleCommandArg R_BITOPCARD_ARGS[] = {
+  {.name = "operation", .type = REDISMODULE_ARG_TYPE_STRING},
+  {.name = "key", .type = REDISMODULE_ARG_TYPE_KEY, .key_spec_index = 0, .flags = REDISMODULE_CMD_ARG_MULTIPLE},
+  {0}
+};
+
+static const RedisModuleCommandInfo R_BITOPCARD_INFO = {
+  .version = REDISMODULE_COMMAND_INFO_VERSION,
+  .summary = "Returns the cardinality of a set operation on Roaring Bitmaps without storing the result",
+  .complexity = "O(N), where N is the number of keys",
+  .since = "1.0.0",
+  .arity = -4,
+  .key_specs = (RedisModuleCommandKeySpec*) R_BITOPCARD_KEYSPECS,
+  .args = (RedisModuleCommandArg*) R_BITOPCARD_ARGS,
+};
+
+// ===============================
+// R64.BITOPGET operation key1 key2 [key...] [LIMIT count]
+// ===============================
+static const RedisModuleCommandInfo R_BITOPGET_INFO = {
+  .version = REDISMODULE_COMMAND_INFO_VERSION,
+  .summary = "Returns the members of a set operation on Roaring Bitmaps without storing the result",
+  .complexity = "O(N + M), where N is the number of keys and M the number of returned members",
+  .since = "1.0.0",
+  .arity = -4,
+};
+
+// ===============================
+// R64.SIMILARITY key [key...] [METRIC metric]
+// ===============================
+static const RedisModuleCommandInfo R_SIMILARITY_INFO = {
+  .version = REDISMODULE_COMMAND_INFO_VERSION,
+  .summary = "Returns the pairwise similarity matrix of Roaring keys",
+  .complexity = "O(N^2 * C), where N is the number of keys",
+  .since = "1.0.0",
+  .arity = -2,
+};
+
+// ===============================
+// R64.TOPK query k {candidate [candidate...] | MATCH pattern COUNT count | MEMBERS setkey} [METRIC metric]
+// ===============================
+static const RedisModuleCommandInfo R_TOPK_INFO = {
+  .version = REDISMODULE_COMMAND_INFO_VERSION,
+  .summary = "Returns the K Roaring keys most similar to a query key",
+  .complexity = "O(N * C + N * log(K)), where N is the number of candidates",
+  .since = "1.0.0",
+  .arity = -4,
+};
+
 typedef struct {
   const char* name;
   const RedisModuleCommandInfo* info;
@@ -684,6 +992,17 @@ static const NamedCommandInfo R64_COMMAND_INFOS[] = {
   {"R64.CLEAR", &R_CLEAR_INFO},
   {"R64.CONTAINS", &R_CONTAINS_INFO},
   {"R64.JACCARD", &R_JACCARD_INFO},
+  {"R64.GETSERIALIZED", &R_GETSERIALIZED_INFO},
+  {"R64.SETSERIALIZED", &R_SETSERIALIZED_INFO},
+  {"R64.SCAN", &R_SCAN_INFO},
+  {"R64.RANGEBYVALUE", &R_RANGEBYVALUE_INFO},
+  {"R64.COUNTRANGE", &R_COUNTRANGE_INFO},
+  {"R64.RANK", &R_RANK_INFO},
+  {"R64.SELECT", &R_SELECT_INFO},
+  {"R64.BITOPCARD", &R_BITOPCARD_INFO},
+  {"R64.BITOPGET", &R_BITOPGET_INFO},
+  {"R64.SIMILARITY", &R_SIMILARITY_INFO},
+  {"R64.TOPK", &R_TOPK_INFO},
 };
 
 int RegisterR64CommandInfos(RedisModuleCtx* ctx) {
@@ -710,6 +1029,17 @@ int RegisterR64CommandInfos(RedisModuleCtx* ctx) {
   SetCommandInfo(ctx, "R64.CLEAR", &R_CLEAR_INFO);
   SetCommandInfo(ctx, "R64.CONTAINS", &R_CONTAINS_INFO);
   SetCommandInfo(ctx, "R64.JACCARD", &R_JACCARD_INFO);
+  SetCommandInfo(ctx, "R64.GETSERIALIZED", &R_GETSERIALIZED_INFO);
+  SetCommandInfo(ctx, "R64.SETSERIALIZED", &R_SETSERIALIZED_INFO);
+  SetCommandInfo(ctx, "R64.SCAN", &R_SCAN_INFO);
+  SetCommandInfo(ctx, "R64.RANGEBYVALUE", &R_RANGEBYVALUE_INFO);
+  SetCommandInfo(ctx, "R64.COUNTRANGE", &R_COUNTRANGE_INFO);
+  SetCommandInfo(ctx, "R64.RANK", &R_RANK_INFO);
+  SetCommandInfo(ctx, "R64.SELECT", &R_SELECT_INFO);
+  SetCommandInfo(ctx, "R64.BITOPCARD", &R_BITOPCARD_INFO);
+  SetCommandInfo(ctx, "R64.BITOPGET", &R_BITOPGET_INFO);
+  SetCommandInfo(ctx, "R64.SIMILARITY", &R_SIMILARITY_INFO);
+  SetCommandInfo(ctx, "R64.TOPK", &R_TOPK_INFO);
 
   return REDISMODULE_OK;
 }
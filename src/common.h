@@ -1,5 +1,8 @@
 #pragma once
 
+#include <stdbool.h>
+#include "redismodule.h"
+
 #define SetCommandAcls(ctx, cmd, acls)                                                             \
     do {                                                                                           \
         if (RMAPI_FUNC_SUPPORTED(RedisModule_SetCommandACLCategories)) {                          \
@@ -55,3 +58,10 @@
             RedisModule_Log(ctx, "notice", "RedisModule_AddACLCategory not available, skipping ACL category registration for %s (requires Redis 7.4+)", module); \
         }                                                                                          \
     } while (0)
+
+/**
+ * True when write commands reach an AOF or at least one online replica, so that replicating
+ * a command by its effect can pay off. Replicas that went online before the module was loaded
+ * are not counted: their stream keeps the verbatim commands, which is always correct.
+ */
+bool ReplicationStreamActive(RedisModuleCtx* ctx);
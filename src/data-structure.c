@@ -1,8 +1,10 @@
 #include <limits.h>
 #include <math.h>
+#include <string.h>
 #include "data-structure.h"
 
 #include "roaring.h"
+#include "roaring/containers/containers.h"
 #include "rmalloc.h"
 
 /* === Internal data structure === */
@@ -83,6 +85,86 @@ bool* bitmap64_getbits(const Bitmap64* bitmap, size_t n_offsets, const uint64_t*
   return results;
 }
 
+static uint32_t _load_le32(const unsigned char* p) {
+  return (uint32_t) p[0] | ((uint32_t) p[1] << 8) | ((uint32_t) p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+static uint64_t _load_le64(const unsigned char* p) {
+  return (uint64_t) _load_le32(p) | ((uint64_t) _load_le32(p + 4) << 32);
+}
+
+static int _uint64_compare(const void* a, const void* b) {
+  uint64_t x = *(const uint64_t*) a;
+  uint64_t y = *(const uint64_t*) b;
+  return (x > y) - (x < y);
+}
+
+typedef struct {
+  uint64_t offset;
+  size_t index;
+} IndexedOffset;
+
+static int _indexed_offset_compare(const void* a, const void* b) {
+  uint64_t x = ((const IndexedOffset*) a)->offset;
+  uint64_t y = ((const IndexedOffset*) b)->offset;
+  return (x > y) - (x < y);
+}
+
+void bitmap_getbits_packed(const Bitmap* bitmap, size_t n_offsets, const unsigned char* offsets, unsigned char* bits) {
+  memset(bits, 0, (n_offsets + 7) / 8);
+  if (bitmap == NULL || n_offsets == 0) return;
+
+  // Probe in offset order so that consecutive lookups stay in the same container,
+  // the position of the offset in the request is kept in the low 32 bits
+  uint64_t* probes = rm_malloc(sizeof(*probes) * n_offsets);
+  bool sorted = true;
+  for (size_t i = 0; i < n_offsets; i++) {
+    probes[i] = ((uint64_t) _load_le32(offsets + i * sizeof(uint32_t)) << 32) | (uint32_t) i;
+    sorted = sorted && (i == 0 || probes[i] > probes[i - 1]);
+  }
+  if (!sorted) {
+    qsort(probes, n_offsets, sizeof(*probes), _uint64_compare);
+  }
+
+  roaring_bulk_context_t context = CROARING_ZERO_INITIALIZER;
+
+  for (size_t i = 0; i < n_offsets; i++) {
+    if (roaring_bitmap_contains_bulk(bitmap, &context, (uint32_t) (probes[i] >> 32))) {
+      uint32_t index = (uint32_t) probes[i];
+      bits[index >> 3] |= 0x80 >> (index & 7);
+    }
+  }
+
+  rm_free(probes);
+}
+
+void bitmap64_getbits_packed(const Bitmap64* bitmap, size_t n_offsets, const unsigned char* offsets, unsigned char* bits) {
+  memset(bits, 0, (n_offsets + 7) / 8);
+  if (bitmap == NULL || n_offsets == 0) return;
+
+  IndexedOffset* probes = rm_malloc(sizeof(*probes) * n_offsets);
+  bool sorted = true;
+  for (size_t i = 0; i < n_offsets; i++) {
+    probes[i].offset = _load_le64(offsets + i * sizeof(uint64_t));
+    probes[i].index = i;
+    sorted = sorted && (i == 0 || probes[i].offset >= probes[i - 1].offset);
+  }
+  if (!sorted) {
+    qsort(probes, n_offsets, sizeof(*probes), _indexed_offset_compare);
+  }
+
+  roaring64_bulk_context_t context = CROARING_ZERO_INITIALIZER;
+
+  for (size_t i = 0; i < n_offsets; i++) {
+    if (roaring64_bitmap_contains_bulk(bitmap, &context, probes[i].offset)) {
+      size_t index = probes[i].index;
+      bits[index >> 3] |= 0x80 >> (index & 7);
+    }
+  }
+
+  rm_free(probes);
+}
+
 bool bitmap_clearbits(Bitmap* bitmap, size_t n_offsets, const uint32_t* offsets) {
   if (bitmap == NULL) return false;
   if (offsets == NULL) return true;
@@ -199,6 +281,30 @@ double bitmap64_jaccard(const Bitmap64* b1, const Bitmap64* b2) {
   return res;
 }
 
+void bitmap_intersection_matrix_rows(uint32_t n, const Bitmap** bitmaps, uint32_t first_row, uint32_t row_step, uint64_t* matrix) {
+  for (uint32_t i = first_row; i < n; i += row_step) {
+    for (uint32_t j = i + 1; j < n; j++) {
+      uint64_t intersection = bitmaps[i] == bitmaps[j]
+          ? matrix[(uint64_t) i * n + i]
+          : roaring_bitmap_and_cardinality(bitmaps[i], bitmaps[j]);
+      matrix[(uint64_t) i * n + j] = intersection;
+      matrix[(uint64_t) j * n + i] = intersection;
+    }
+  }
+}
+
+void bitmap64_intersection_matrix_rows(uint32_t n, const Bitmap64** bitmaps, uint32_t first_row, uint32_t row_step, uint64_t* matrix) {
+  for (uint32_t i = first_row; i < n; i += row_step) {
+    for (uint32_t j = i + 1; j < n; j++) {
+      uint64_t intersection = bitmaps[i] == bitmaps[j]
+          ? matrix[(uint64_t) i * n + i]
+          : roaring64_bitmap_and_cardinality(bitmaps[i], bitmaps[j]);
+      matrix[(uint64_t) i * n + j] = intersection;
+      matrix[(uint64_t) j * n + i] = intersection;
+    }
+  }
+}
+
 int64_t bitmap_get_nth_element_present(const Bitmap* bitmap, uint64_t n) {
   uint32_t element = 0;
 
@@ -233,6 +339,14 @@ uint64_t bitmap64_get_nth_element_present(const Bitmap64* bitmap, uint64_t n, bo
   return element;
 }
 
+uint64_t bitmap_rank(const Bitmap* bitmap, uint32_t value) {
+  return roaring_bitmap_rank(bitmap, value);
+}
+
+uint64_t bitmap64_rank(const Bitmap64* bitmap, uint64_t value) {
+  return roaring64_bitmap_rank(bitmap, value);
+}
+
 int64_t bitmap_get_nth_element_not_present(const Bitmap* bitmap, uint64_t n) {
   if (bitmap == NULL || n == 0) {
     return -1;
@@ -337,30 +451,31 @@ static void _roaring64_bitmap_overwrite(Bitmap64* dest, const Bitmap64* src) {
   roaring64_bitmap_or_inplace(dest, src);
 }
 
+/**
+ * Replaces the content of `dest` by the content of `src` without copying containers, and frees `src`
+ */
+static void _roaring_bitmap_move(Bitmap* dest, Bitmap* src) {
+  roaring_array_t tmp = dest->high_low_container;
+  dest->high_low_container = src->high_low_container;
+  src->high_low_container = tmp;
+  roaring_bitmap_free(src);
+}
+
 void bitmap_or(Bitmap* r, uint32_t n, const Bitmap** bitmaps) {
   if (n == 0) {
     return roaring_bitmap_clear(r);
   }
   if (n == 1) {
-    roaring_bitmap_overwrite(r, bitmaps[0]);
-    return;
-  }
-
-  // Only overwrite if r != bitmaps[0], otherwise r would be cleared and then copied from itself (resulting in empty)
-  if (r != bitmaps[0]) {
-    roaring_bitmap_overwrite(r, bitmaps[0]);
-  }
-
-  for (size_t i = 1; i < n; i++) {
-    if (bitmaps[i] != r) {  // Skip if same pointer to avoid memcpy overlap
-      // Use non-inplace operation to avoid memcpy overlap in shared containers
-      Bitmap* temp = roaring_bitmap_lazy_or(r, bitmaps[i], false);
-      roaring_bitmap_overwrite(r, temp);
-      roaring_bitmap_free(temp);
+    if (r != bitmaps[0]) {
+      roaring_bitmap_overwrite(r, bitmaps[0]);
     }
+    return;
   }
 
-  roaring_bitmap_repair_after_lazy(r);
+  // Single pass wide union: the sources are merged lazily into one fresh bitmap, so the cost is
+  // proportional to the output instead of copying the accumulator once per source.
+  // `r` may be one of the sources, it is only replaced once the union is complete
+  _roaring_bitmap_move(r, roaring_bitmap_or_many(n, bitmaps));
 }
 
 void bitmap64_or(Bitmap64* r, uint32_t n, const Bitmap64** bitmaps) {
@@ -377,38 +492,59 @@ void bitmap64_or(Bitmap64* r, uint32_t n, const Bitmap64** bitmaps) {
   _roaring64_bitmap_overwrite(r, bitmaps[0]);
   }
 
+  // Accumulate in place: a temporary per source would copy the growing result once per source.
+  // roaring64 bitmaps don't share containers, so only r itself has to be skipped
   for (uint32_t i = 1; i < n; i++) {
-    if (bitmaps[i] != r) {  // Skip if same pointer to avoid memcpy overlap
-      // Use non-inplace operation to avoid memcpy overlap in shared containers
-      Bitmap64* temp = roaring64_bitmap_or(r, bitmaps[i]);
-      _roaring64_bitmap_overwrite(r, temp);
-      roaring64_bitmap_free(temp);
+    if (bitmaps[i] != r) {
+      roaring64_bitmap_or_inplace(r, bitmaps[i]);
     }
   }
 }
 
+typedef struct {
+  uint64_t cardinality;
+  const void* bitmap;
+} SizedBitmap;
+
+static int _sized_bitmap_compare(const void* a, const void* b) {
+  uint64_t ca = ((const SizedBitmap*) a)->cardinality;
+  uint64_t cb = ((const SizedBitmap*) b)->cardinality;
+  return (ca > cb) - (ca < cb);
+}
+
 void bitmap_and(Bitmap* r, uint32_t n, const Bitmap** bitmaps) {
   if (n == 0) {
     return roaring_bitmap_clear(r);
   }
   if (n == 1) {
-    roaring_bitmap_overwrite(r, bitmaps[0]);
+    if (r != bitmaps[0]) {
+      roaring_bitmap_overwrite(r, bitmaps[0]);
+    }
     return;
   }
 
-  // Only overwrite if r != bitmaps[0], otherwise r would be cleared and then copied from itself (resulting in empty)
-  if (r != bitmaps[0]) {
-    roaring_bitmap_overwrite(r, bitmaps[0]);
+  // Intersect from the smallest source: every step is bounded by the running result,
+  // and an empty intermediate result ends the operation
+  SizedBitmap* sorted = rm_malloc(n * sizeof(*sorted));
+  for (uint32_t i = 0; i < n; i++) {
+    sorted[i].cardinality = roaring_bitmap_get_cardinality(bitmaps[i]);
+    sorted[i].bitmap = bitmaps[i];
   }
+  qsort(sorted, n, sizeof(*sorted), _sized_bitmap_compare);
 
-  for (uint32_t i = 1; i < n; i++) {
-    if (bitmaps[i] != r) {  // Skip if same pointer to avoid memcpy overlap
-      // Use non-inplace operation to avoid memcpy overlap in shared containers
-      Bitmap* temp = roaring_bitmap_and(r, bitmaps[i]);
-      roaring_bitmap_overwrite(r, temp);
-      roaring_bitmap_free(temp);
-    }
+  if (sorted[0].cardinality == 0) {
+    rm_free(sorted);
+    return roaring_bitmap_clear(r);
+  }
+
+  // The running result is a private bitmap, so `r` may be any of the sources
+  Bitmap* result = roaring_bitmap_and(sorted[0].bitmap, sorted[1].bitmap);
+  for (uint32_t i = 2; i < n && !roaring_bitmap_is_empty(result); i++) {
+    roaring_bitmap_and_inplace(result, sorted[i].bitmap);
   }
+  rm_free(sorted);
+
+  _roaring_bitmap_move(r, result);
 }
 
 void bitmap64_and(Bitmap64* r, uint32_t n, const Bitmap64** bitmaps) {
@@ -416,23 +552,32 @@ void bitmap64_and(Bitmap64* r, uint32_t n, const Bitmap64** bitmaps) {
     return roaring64_bitmap_clear(r);
   }
   if (n == 1) {
-    _roaring64_bitmap_overwrite(r, bitmaps[0]);
+    if (r != bitmaps[0]) {
+      _roaring64_bitmap_overwrite(r, bitmaps[0]);
+    }
     return;
   }
 
-  // Only overwrite if r != bitmaps[0], otherwise r would be cleared and then copied from itself (resulting in empty)
-  if (r != bitmaps[0]) {
-  _roaring64_bitmap_overwrite(r, bitmaps[0]);
+  SizedBitmap* sorted = rm_malloc(n * sizeof(*sorted));
+  for (uint32_t i = 0; i < n; i++) {
+    sorted[i].cardinality = roaring64_bitmap_get_cardinality(bitmaps[i]);
+    sorted[i].bitmap = bitmaps[i];
   }
+  qsort(sorted, n, sizeof(*sorted), _sized_bitmap_compare);
 
-  for (uint32_t i = 1; i < n; i++) {
-    if (bitmaps[i] != r) {  // Skip if same pointer to avoid memcpy overlap
-      // Use non-inplace operation to avoid memcpy overlap in shared containers
-      Bitmap64* temp = roaring64_bitmap_and(r, bitmaps[i]);
-      _roaring64_bitmap_overwrite(r, temp);
-      roaring64_bitmap_free(temp);
-    }
+  if (sorted[0].cardinality == 0) {
+    rm_free(sorted);
+    return roaring64_bitmap_clear(r);
+  }
+
+  Bitmap64* result = roaring64_bitmap_and(sorted[0].bitmap, sorted[1].bitmap);
+  for (uint32_t i = 2; i < n && !roaring64_bitmap_is_empty(result); i++) {
+    roaring64_bitmap_and_inplace(result, sorted[i].bitmap);
   }
+  rm_free(sorted);
+
+  _roaring64_bitmap_overwrite(r, result);
+  roaring64_bitmap_free(result);
 }
 
 void bitmap_xor(Bitmap* r, uint32_t n, const Bitmap** bitmaps) {
@@ -490,46 +635,19 @@ void bitmap_andor(Bitmap* r, uint32_t n, const Bitmap** bitmaps) {
     return roaring_bitmap_clear(r);
   }
   if (n == 1) {
-    roaring_bitmap_overwrite(r, bitmaps[0]);
-    return;
-  }
-  if (n < 2) {
-    return bitmap_and(r, n, bitmaps);
-  }
-
-  // If r == bitmaps[0], we need to make a copy because we'll overwrite r
-  Bitmap* x_copy = NULL;
-  const Bitmap* x = bitmaps[0];
-  if (r == bitmaps[0]) {
-    x_copy = roaring_bitmap_copy(bitmaps[0]);
-    x = x_copy;
-  }
-
-  // Only overwrite if r != bitmaps[1], otherwise r would be cleared and then copied from itself
-  if (r != bitmaps[1]) {
-    roaring_bitmap_overwrite(r, bitmaps[1]);
-  }
-
-  for (size_t i = 2; i < n; i++) {
-    if (bitmaps[i] != r) {  // Skip if same pointer to avoid memcpy overlap
-      // Use non-inplace operation to avoid memcpy overlap in shared containers
-      Bitmap* temp = roaring_bitmap_lazy_or(r, bitmaps[i], false);
-      roaring_bitmap_overwrite(r, temp);
-      roaring_bitmap_free(temp);
+    if (r != bitmaps[0]) {
+      roaring_bitmap_overwrite(r, bitmaps[0]);
     }
+    return;
   }
 
-  roaring_bitmap_repair_after_lazy(r);
+  // X AND (Y1 OR Y2 OR ...), with the union done in a single pass.
+  // Both steps build new bitmaps, so `r` may be any of the sources
+  Bitmap* ys = roaring_bitmap_or_many(n - 1, bitmaps + 1);
+  Bitmap* result = roaring_bitmap_and(bitmaps[0], ys);
+  roaring_bitmap_free(ys);
 
-  // Now AND with x (either bitmaps[0] or our copy if r was bitmaps[0])
-  Bitmap* temp = roaring_bitmap_and(r, x);
-  roaring_bitmap_overwrite(r, temp);
-  roaring_bitmap_free(temp);
-
-  // Clean up copy if we made one
-  if (x_copy) {
-    roaring_bitmap_free(x_copy);
-  }
+  _roaring_bitmap_move(r, result);
 }
 
 void bitmap_andnot(Bitmap* r, uint32_t n, const Bitmap** bitmaps) {
@@ -694,17 +812,13 @@ void bitmap64_andor(Bitmap64* r, uint32_t n, const Bitmap64** bitmaps) {
   }
 
   for (size_t i = 2; i < n; i++) {
-    if (bitmaps[i] != r) {  // Skip if same pointer to avoid memcpy overlap
-      Bitmap64* temp = roaring64_bitmap_or(r, bitmaps[i]);
-      _roaring64_bitmap_overwrite(r, temp);
-      roaring64_bitmap_free(temp);
+    if (bitmaps[i] != r) {
+      roaring64_bitmap_or_inplace(r, bitmaps[i]);
     }
   }
 
   // Now AND with x (either bitmaps[0] or our copy if r was bitmaps[0])
-  Bitmap64* temp = roaring64_bitmap_and(r, x);
-  _roaring64_bitmap_overwrite(r, temp);
-  roaring64_bitmap_free(temp);
+  roaring64_bitmap_and_inplace(r, x);
 
   // Clean up copy if we made one
   if (x_copy) {
@@ -712,48 +826,152 @@ void bitmap64_andor(Bitmap64* r, uint32_t n, const Bitmap64** bitmaps) {
   }
 }
 
+/**
+ * Makes `view` a frozen view of `count` containers of `bitmap` starting at `index`
+ */
+static void _roaring_bitmap_container_view(const Bitmap* bitmap, int32_t index, int32_t count, Bitmap* view) {
+  const roaring_array_t* ra = &bitmap->high_low_container;
+
+  memset(view, 0, sizeof(*view));
+  view->high_low_container.size = count;
+  view->high_low_container.allocation_size = count;
+  view->high_low_container.containers = ra->containers + index;
+  view->high_low_container.keys = ra->keys + index;
+  view->high_low_container.typecodes = ra->typecodes + index;
+  // Frozen: roaring never frees nor reallocates the borrowed arrays
+  view->high_low_container.flags = ROARING_FLAG_FROZEN;
+}
+
 void bitmap_one(Bitmap* r, uint32_t n, const Bitmap** bitmaps) {
   if (n == 0) {
     return roaring_bitmap_clear(r);
   }
   if (n == 1) {
-    roaring_bitmap_overwrite(r, bitmaps[0]);
+    if (r != bitmaps[0]) {
+      roaring_bitmap_overwrite(r, bitmaps[0]);
+    }
     return;
   }
-  // Do simple xor for two bitmaps
-  if (n < 2) {
-    return bitmap_xor(r, n, bitmaps);
+
+  // Merge the sources container key by container key. A container held by a single source is
+  // copied as is; otherwise values seen once and values seen more than once are tracked for that
+  // container only, so temporaries never grow beyond one container
+  Bitmap* result = roaring_bitmap_create();
+  int32_t* positions = rm_calloc(n, sizeof(*positions));
+  uint32_t* holders = rm_malloc(n * sizeof(*holders));
+  Bitmap* views = rm_malloc(n * sizeof(*views));
+
+  while (true) {
+    int32_t key = -1;
+    uint32_t n_views = 0;
+    for (uint32_t i = 0; i < n; i++) {
+      const roaring_array_t* ra = &bitmaps[i]->high_low_container;
+      if (positions[i] >= ra->size) {
+        continue;
+      }
+      int32_t current = ra->keys[positions[i]];
+      if (key == -1 || current < key) {
+        key = current;
+        n_views = 0;
+      }
+      if (current == key) {
+        holders[n_views++] = i;
+      }
+    }
+
+    if (key == -1) {
+      break;
+    }
+
+    for (uint32_t j = 0; j < n_views; j++) {
+      uint32_t i = holders[j];
+      _roaring_bitmap_container_view(bitmaps[i], positions[i]++, 1, &views[j]);
+    }
+
+    if (n_views == 1) {
+      roaring_bitmap_or_inplace(result, &views[0]);
+      continue;
+    }
+
+    Bitmap* once = roaring_bitmap_copy(&views[0]);
+    Bitmap* more = roaring_bitmap_create();
+    for (uint32_t j = 1; j < n_views; j++) {
+      Bitmap* both = roaring_bitmap_and(once, &views[j]);
+      roaring_bitmap_or_inplace(more, both);
+      roaring_bitmap_free(both);
+      roaring_bitmap_xor_inplace(once, &views[j]);
+    }
+    roaring_bitmap_andnot_inplace(once, more);
+
+    // Keys are visited in increasing order, so this appends the container
+    roaring_bitmap_or_inplace(result, once);
+    roaring_bitmap_free(once);
+    roaring_bitmap_free(more);
   }
 
-  // Helper bitmap to track bits seen in more than one key
-  Bitmap* helper = roaring_bitmap_create();
+  rm_free(views);
+  rm_free(holders);
+  rm_free(positions);
 
-  // Start with the first bitmap
-  roaring_bitmap_overwrite(r, bitmaps[0]);
+  // `r` may be one of the sources, it is only replaced once the merge is complete
+  _roaring_bitmap_move(r, result);
+}
 
-  for (uint32_t i = 1; i < n; i++) {
-    if (bitmaps[i] != r) {  // Skip if same pointer to avoid memcpy overlap
-      // Track bits that appear in both current result and new bitmap
-      // These are bits that now appear in more than one key
-      Bitmap* intersection = roaring_bitmap_and(r, bitmaps[i]);
-      Bitmap* helper_temp = roaring_bitmap_or(helper, intersection);
-      roaring_bitmap_overwrite(helper, helper_temp);
-      roaring_bitmap_free(helper_temp);
-      roaring_bitmap_free(intersection);
+void bitmap_container_range_view(const Bitmap* bitmap, uint16_t first_key, uint16_t last_key, Bitmap* view) {
+  const roaring_array_t* ra = &bitmap->high_low_container;
 
-      // XOR the new bitmap with current result
-      Bitmap* xor_temp = roaring_bitmap_xor(r, bitmaps[i]);
-      roaring_bitmap_overwrite(r, xor_temp);
-      roaring_bitmap_free(xor_temp);
+  // Containers are sorted by key, find the first one in range
+  int32_t low = 0;
+  int32_t high = ra->size;
+  while (low < high) {
+    int32_t mid = low + (high - low) / 2;
+    if (ra->keys[mid] < first_key) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
 
-      // Remove bits that have been seen in more than one key
-      Bitmap* andnot_temp = roaring_bitmap_andnot(r, helper);
-      roaring_bitmap_overwrite(r, andnot_temp);
-      roaring_bitmap_free(andnot_temp);
+  int32_t end = low;
+  while (end < ra->size && ra->keys[end] <= last_key) {
+    end++;
+  }
+
+  _roaring_bitmap_container_view(bitmap, low, end - low, view);
+}
+
+uint32_t bitmap_partition_keys(uint32_t n, const Bitmap** bitmaps, uint32_t max_parts, uint64_t min_containers, uint16_t* first_keys) {
+  first_keys[0] = 0;
+
+  uint64_t total = 0;
+  const roaring_array_t* largest = NULL;
+  for (uint32_t i = 0; i < n; i++) {
+    const roaring_array_t* ra = &bitmaps[i]->high_low_container;
+    total += (uint64_t) ra->size;
+    if (largest == NULL || ra->size > largest->size) {
+      largest = ra;
+    }
+  }
+
+  uint64_t parts = min_containers == 0 ? max_parts : total / min_containers;
+  if (parts > max_parts) {
+    parts = max_parts;
+  }
+  if (parts <= 1 || largest == NULL || largest->size < 2) {
+    return 1;
+  }
+
+  // Sources usually share their key distribution, so the boundaries are taken at evenly spaced
+  // containers of the largest one
+  uint32_t count = 1;
+  for (uint64_t i = 1; i < parts; i++) {
+    uint16_t key = largest->keys[(i * (uint64_t) largest->size) / parts];
+    if (key > first_keys[count - 1]) {
+      first_keys[count++] = key;
     }
   }
 
-  roaring_bitmap_free(helper);
+  return count;
 }
 
 void bitmap64_one(Bitmap64* r, uint32_t n, const Bitmap64** bitmaps) {
@@ -799,6 +1017,205 @@ void bitmap64_one(Bitmap64* r, uint32_t n, const Bitmap64** bitmaps) {
   roaring64_bitmap_free(helper);
 }
 
+/**
+ * Moves the source with the largest cardinality to the end of `sorted` (a copy of `bitmaps`)
+ */
+static void _bitmap_largest_last(uint32_t n, const Bitmap** bitmaps, const Bitmap** sorted) {
+  uint32_t largest = 0;
+  uint64_t largest_cardinality = 0;
+  for (uint32_t i = 0; i < n; i++) {
+    sorted[i] = bitmaps[i];
+    uint64_t cardinality = roaring_bitmap_get_cardinality(bitmaps[i]);
+    if (cardinality > largest_cardinality) {
+      largest = i;
+      largest_cardinality = cardinality;
+    }
+  }
+  sorted[largest] = bitmaps[n - 1];
+  sorted[n - 1] = bitmaps[largest];
+}
+
+static void _bitmap64_largest_last(uint32_t n, const Bitmap64** bitmaps, const Bitmap64** sorted) {
+  uint32_t largest = 0;
+  uint64_t largest_cardinality = 0;
+  for (uint32_t i = 0; i < n; i++) {
+    sorted[i] = bitmaps[i];
+    uint64_t cardinality = roaring64_bitmap_get_cardinality(bitmaps[i]);
+    if (cardinality > largest_cardinality) {
+      largest = i;
+      largest_cardinality = cardinality;
+    }
+  }
+  sorted[largest] = bitmaps[n - 1];
+  sorted[n - 1] = bitmaps[largest];
+}
+
+static Bitmap64* _roaring64_bitmap_or_many(uint32_t n, const Bitmap64** bitmaps) {
+  Bitmap64* r = roaring64_bitmap_copy(bitmaps[0]);
+  for (uint32_t i = 1; i < n; i++) {
+    roaring64_bitmap_or_inplace(r, bitmaps[i]);
+  }
+  return r;
+}
+
+uint64_t bitmap_operation_cardinality(int operation, uint32_t n, const Bitmap** bitmaps) {
+  if (n == 0 || (operation == BITMAP_OPERATION_ORNOT && n == 1)) {
+    return 0;
+  }
+  if (n == 1) {
+    return roaring_bitmap_get_cardinality(bitmaps[0]);
+  }
+
+  if (n == 2) {
+    switch (operation) {
+      case BITMAP_OPERATION_AND:
+        return roaring_bitmap_and_cardinality(bitmaps[0], bitmaps[1]);
+      case BITMAP_OPERATION_OR:
+        return roaring_bitmap_or_cardinality(bitmaps[0], bitmaps[1]);
+      case BITMAP_OPERATION_XOR:
+      case BITMAP_OPERATION_ONE:
+        return roaring_bitmap_xor_cardinality(bitmaps[0], bitmaps[1]);
+      case BITMAP_OPERATION_ANDOR:
+        return roaring_bitmap_and_cardinality(bitmaps[0], bitmaps[1]);
+      case BITMAP_OPERATION_ANDNOT:
+        return roaring_bitmap_andnot_cardinality(bitmaps[0], bitmaps[1]);
+      case BITMAP_OPERATION_ORNOT:
+        return roaring_bitmap_andnot_cardinality(bitmaps[1], bitmaps[0]);
+    }
+  }
+
+  uint64_t cardinality = 0;
+  const Bitmap** sorted = NULL;
+  Bitmap* scratch = NULL;
+
+  switch (operation) {
+    case BITMAP_OPERATION_AND:
+    case BITMAP_OPERATION_OR:
+    case BITMAP_OPERATION_XOR:
+      // Combine all the sources but the largest, which is only counted against the combination
+      sorted = rm_malloc(n * sizeof(*sorted));
+      _bitmap_largest_last(n, bitmaps, sorted);
+      if (operation == BITMAP_OPERATION_AND) {
+        scratch = bitmap_alloc();
+        bitmap_and(scratch, n - 1, sorted);
+      } else if (operation == BITMAP_OPERATION_OR) {
+        scratch = roaring_bitmap_or_many(n - 1, sorted);
+      } else {
+        scratch = roaring_bitmap_xor_many(n - 1, sorted);
+      }
+
+      if (operation == BITMAP_OPERATION_AND) {
+        cardinality = roaring_bitmap_and_cardinality(scratch, sorted[n - 1]);
+      } else if (operation == BITMAP_OPERATION_OR) {
+        cardinality = roaring_bitmap_or_cardinality(scratch, sorted[n - 1]);
+      } else {
+        cardinality = roaring_bitmap_xor_cardinality(scratch, sorted[n - 1]);
+      }
+      rm_free(sorted);
+      break;
+    case BITMAP_OPERATION_ANDOR:
+    case BITMAP_OPERATION_ANDNOT:
+    case BITMAP_OPERATION_ORNOT:
+      // X against the union of Y1..Yn
+      scratch = roaring_bitmap_or_many(n - 1, bitmaps + 1);
+      if (operation == BITMAP_OPERATION_ANDOR) {
+        cardinality = roaring_bitmap_and_cardinality(bitmaps[0], scratch);
+      } else if (operation == BITMAP_OPERATION_ANDNOT) {
+        cardinality = roaring_bitmap_andnot_cardinality(bitmaps[0], scratch);
+      } else {
+        cardinality = roaring_bitmap_andnot_cardinality(scratch, bitmaps[0]);
+      }
+      break;
+    case BITMAP_OPERATION_ONE:
+      scratch = bitmap_alloc();
+      bitmap_one(scratch, n, bitmaps);
+      cardinality = roaring_bitmap_get_cardinality(scratch);
+      break;
+  }
+
+  if (scratch != NULL) {
+    roaring_bitmap_free(scratch);
+  }
+
+  return cardinality;
+}
+
+uint64_t bitmap64_operation_cardinality(int operation, uint32_t n, const Bitmap64** bitmaps) {
+  if (n == 0 || (operation == BITMAP_OPERATION_ORNOT && n == 1)) {
+    return 0;
+  }
+  if (n == 1) {
+    return roaring64_bitmap_get_cardinality(bitmaps[0]);
+  }
+
+  if (n == 2) {
+    switch (operation) {
+      case BITMAP_OPERATION_AND:
+        return roaring64_bitmap_and_cardinality(bitmaps[0], bitmaps[1]);
+      case BITMAP_OPERATION_OR:
+        return roaring64_bitmap_or_cardinality(bitmaps[0], bitmaps[1]);
+      case BITMAP_OPERATION_XOR:
+      case BITMAP_OPERATION_ONE:
+        return roaring64_bitmap_xor_cardinality(bitmaps[0], bitmaps[1]);
+      case BITMAP_OPERATION_ANDOR:
+        return roaring64_bitmap_and_cardinality(bitmaps[0], bitmaps[1]);
+      case BITMAP_OPERATION_ANDNOT:
+        return roaring64_bitmap_andnot_cardinality(bitmaps[0], bitmaps[1]);
+      case BITMAP_OPERATION_ORNOT:
+        return roaring64_bitmap_andnot_cardinality(bitmaps[1], bitmaps[0]);
+    }
+  }
+
+  uint64_t cardinality = 0;
+  const Bitmap64** sorted = NULL;
+  Bitmap64* scratch = NULL;
+
+  switch (operation) {
+    case BITMAP_OPERATION_AND:
+    case BITMAP_OPERATION_OR:
+    case BITMAP_OPERATION_XOR:
+      sorted = rm_malloc(n * sizeof(*sorted));
+      _bitmap64_largest_last(n, bitmaps, sorted);
+      if (operation == BITMAP_OPERATION_AND) {
+        scratch = bitmap64_alloc();
+        bitmap64_and(scratch, n - 1, sorted);
+        cardinality = roaring64_bitmap_and_cardinality(scratch, sorted[n - 1]);
+      } else if (operation == BITMAP_OPERATION_OR) {
+        scratch = _roaring64_bitmap_or_many(n - 1, sorted);
+        cardinality = roaring64_bitmap_or_cardinality(scratch, sorted[n - 1]);
+      } else {
+        scratch = bitmap64_alloc();
+        bitmap64_xor(scratch, n - 1, sorted);
+        cardinality = roaring64_bitmap_xor_cardinality(scratch, sorted[n - 1]);
+      }
+      rm_free(sorted);
+      break;
+    case BITMAP_OPERATION_ANDOR:
+    case BITMAP_OPERATION_ANDNOT:
+    case BITMAP_OPERATION_ORNOT:
+      scratch = _roaring64_bitmap_or_many(n - 1, bitmaps + 1);
+      if (operation == BITMAP_OPERATION_ANDOR) {
+        cardinality = roaring64_bitmap_and_cardinality(bitmaps[0], scratch);
+      } else if (operation == BITMAP_OPERATION_ANDNOT) {
+        cardinality = roaring64_bitmap_andnot_cardinality(bitmaps[0], scratch);
+      } else {
+        cardinality = roaring64_bitmap_andnot_cardinality(scratch, bitmaps[0]);
+      }
+      break;
+    case BITMAP_OPERATION_ONE:
+      scratch = bitmap64_alloc();
+      bitmap64_one(scratch, n, bitmaps);
+      cardinality = roaring64_bitmap_get_cardinality(scratch);
+      break;
+  }
+
+  if (scratch != NULL) {
+    roaring64_bitmap_free(scratch);
+  }
+
+  return cardinality;
+}
+
 Bitmap* bitmap_not_array(uint32_t unused, const Bitmap** bitmaps) {
   (void) (unused);
   uint32_t last = roaring_bitmap_maximum(bitmaps[0]);
@@ -837,6 +1254,108 @@ Bitmap64* bitmap64_from_int_array(size_t n, const uint64_t* array) {
   return roaring64_bitmap_of_ptr(n, array);
 }
 
+/**
+ * Reads one unsigned LEB128 varint of at most `bits` bits, returns the number of bytes consumed
+ * or 0 if the varint is truncated or does not fit.
+ */
+static size_t _load_varint(const unsigned char* p, size_t size, unsigned bits, uint64_t* value) {
+  uint64_t result = 0;
+  for (size_t i = 0, shift = 0; i < size && shift < bits; i++, shift += 7) {
+    uint64_t chunk = p[i] & 0x7F;
+    if (bits - shift < 7 && (chunk >> (bits - shift)) != 0) {
+      return 0;
+    }
+    result |= chunk << shift;
+    if ((p[i] & 0x80) == 0) {
+      *value = result;
+      return i + 1;
+    }
+  }
+  return 0;
+}
+
+bool bitmap_decode_int_array(size_t size, const unsigned char* buffer, int encoding, uint32_t** values, size_t* n) {
+  size_t capacity = (encoding & BITMAP_INT_ENCODING_VARINT) ? size : size / sizeof(uint32_t);
+  if (!(encoding & BITMAP_INT_ENCODING_VARINT) && size % sizeof(uint32_t) != 0) {
+    return false;
+  }
+
+  uint32_t* array = rm_malloc(sizeof(*array) * (capacity > 0 ? capacity : 1));
+  size_t count = 0;
+
+  if (encoding & BITMAP_INT_ENCODING_VARINT) {
+    for (size_t pos = 0; pos < size; count++) {
+      uint64_t value;
+      size_t consumed = _load_varint(buffer + pos, size - pos, 32, &value);
+      if (consumed == 0) {
+        rm_free(array);
+        return false;
+      }
+      array[count] = (uint32_t) value;
+      pos += consumed;
+    }
+  } else {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    memcpy(array, buffer, size);
+    count = capacity;
+#else
+    for (; count < capacity; count++) {
+      array[count] = _load_le32(buffer + count * sizeof(uint32_t));
+    }
+#endif
+  }
+
+  if (encoding & BITMAP_INT_ENCODING_DELTA) {
+    for (size_t i = 1; i < count; i++) {
+      array[i] += array[i - 1];
+    }
+  }
+
+  *values = array;
+  *n = count;
+  return true;
+}
+
+bool bitmap64_decode_int_array(size_t size, const unsigned char* buffer, int encoding, uint64_t** values, size_t* n) {
+  size_t capacity = (encoding & BITMAP_INT_ENCODING_VARINT) ? size : size / sizeof(uint64_t);
+  if (!(encoding & BITMAP_INT_ENCODING_VARINT) && size % sizeof(uint64_t) != 0) {
+    return false;
+  }
+
+  uint64_t* array = rm_malloc(sizeof(*array) * (capacity > 0 ? capacity : 1));
+  size_t count = 0;
+
+  if (encoding & BITMAP_INT_ENCODING_VARINT) {
+    for (size_t pos = 0; pos < size; count++) {
+      size_t consumed = _load_varint(buffer + pos, size - pos, 64, &array[count]);
+      if (consumed == 0) {
+        rm_free(array);
+        return false;
+      }
+      pos += consumed;
+    }
+  } else {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    memcpy(array, buffer, size);
+    count = capacity;
+#else
+    for (; count < capacity; count++) {
+      array[count] = _load_le64(buffer + count * sizeof(uint64_t));
+    }
+#endif
+  }
+
+  if (encoding & BITMAP_INT_ENCODING_DELTA) {
+    for (size_t i = 1; i < count; i++) {
+      array[i] += array[i - 1];
+    }
+  }
+
+  *values = array;
+  *n = count;
+  return true;
+}
+
 uint32_t* bitmap_get_int_array(const Bitmap* bitmap, size_t* n) {
   *n = roaring_bitmap_get_cardinality(bitmap);
   uint32_t* ans = rm_malloc(sizeof(*ans) * (*n));
@@ -863,26 +1382,30 @@ uint32_t* bitmap_range_int_array(const Bitmap* bitmap, size_t start_offset, size
   }
 
   size_t range_size = (end_offset - start_offset) + 1;
-  if (range_size == 0 || range_size > (SIZE_MAX / sizeof(uint32_t))) {
+  if (range_size == 0) {
     return NULL;
   }
 
-  // Avoid rm_calloc_try here: RedisModule_TryCalloc is missing on Redis 6.2/7.0 and crashes
-  // when invoked; see https://github.com/aviggiano/redis-roaring/issues/139#issuecomment-3776839439
-  uint32_t* ans = rm_calloc(range_size, sizeof(uint32_t));
+  // Size the result to what the bitmap holds in the range, not to the requested range
+  uint64_t cardinality = roaring_bitmap_get_cardinality(bitmap);
+  size_t count = 0;
+  if (start_offset < cardinality) {
+    count = cardinality - start_offset < range_size ? cardinality - start_offset : range_size;
+  }
+
+  // Never return NULL for an empty result, NULL is reserved for failures
+  uint32_t* ans = rm_malloc(sizeof(*ans) * (count > 0 ? count : 1));
   if (ans == NULL) {
     return NULL;
   }
 
-  size_t i = 0;
-  while (i < range_size) {
-    if (!roaring_bitmap_select(bitmap, start_offset + i, &ans[i])) {
-      break;
-    }
-    i++;
+  // Skips whole containers by their cardinality, then copies the values in bulk
+  if (count > 0 && !roaring_bitmap_range_uint32_array(bitmap, start_offset, count, ans)) {
+    rm_free(ans);
+    return NULL;
   }
 
-  if (result_count) *result_count = i;
+  if (result_count) *result_count = count;
 
   return ans;
 }
@@ -907,26 +1430,33 @@ uint64_t* bitmap64_range_int_array(const Bitmap64* bitmap, uint64_t start_offset
     return NULL;
   }
 
-  // Avoid rm_calloc_try here: RedisModule_TryCalloc is missing on Redis 6.2/7.0 and crashes
-  // when invoked; see https://github.com/aviggiano/redis-roaring/issues/139#issuecomment-3776839439
-  uint64_t* ans = rm_calloc(range_size, sizeof(uint64_t));
+  uint64_t cardinality = roaring64_bitmap_get_cardinality(bitmap);
+  uint64_t count = 0;
+  if (start_offset < cardinality) {
+    count = cardinality - start_offset < range_size ? cardinality - start_offset : range_size;
+  }
 
-  if (ans == NULL) {
+  if (count > SIZE_MAX / sizeof(uint64_t)) {
     return NULL;
   }
 
-  uint64_t i = 0;
+  uint64_t* ans = rm_malloc(sizeof(*ans) * (count > 0 ? count : 1));
+  if (ans == NULL) {
+    return NULL;
+  }
 
-  // [TODO] replace with roaring64_bitmap_range_uint64_array in next version of CRoaring
-  while (i < range_size) {
-    if (!roaring64_bitmap_select(bitmap, start_offset + i, &ans[i])) {
-      break;
-    }
+  if (count > 0) {
+    // A single select finds the first value, the iterator reads the rest in bulk
+    uint64_t first;
+    roaring64_bitmap_select(bitmap, start_offset, &first);
 
-    i++;
+    roaring64_iterator_t* iterator = roaring64_iterator_create(bitmap);
+    roaring64_iterator_move_equalorlarger(iterator, first);
+    count = roaring64_iterator_read(iterator, ans, count);
+    roaring64_iterator_free(iterator);
   }
 
-  if (result_count) *result_count = i;
+  if (result_count) *result_count = count;
 
   return ans;
 }
@@ -1045,6 +1575,22 @@ bool bitmap64_optimize(Bitmap64* bitmap, int shrink_to_fit) {
   return was_modified;
 }
 
+size_t bitmap_compact(Bitmap* bitmap) {
+  size_t before = roaring_bitmap_size_in_bytes(bitmap);
+  roaring_bitmap_run_optimize(bitmap);
+  size_t released = roaring_bitmap_shrink_to_fit(bitmap);
+  size_t after = roaring_bitmap_size_in_bytes(bitmap);
+  return released + (before > after ? before - after : 0);
+}
+
+size_t bitmap64_compact(Bitmap64* bitmap) {
+  size_t before = roaring64_bitmap_portable_size_in_bytes(bitmap);
+  roaring64_bitmap_run_optimize(bitmap);
+  size_t released = roaring64_bitmap_shrink_to_fit(bitmap);
+  size_t after = roaring64_bitmap_portable_size_in_bytes(bitmap);
+  return released + (before > after ? before - after : 0);
+}
+
 void bitmap_statistics(const Bitmap* bitmap, Bitmap_statistics* stat) {
   roaring_bitmap_statistics(bitmap, stat);
 }
@@ -1053,6 +1599,280 @@ void bitmap64_statistics(const Bitmap64* bitmap, Bitmap64_statistics* stat) {
   roaring64_bitmap_statistics(bitmap, stat);
 }
 
+static size_t _container_allocated_size(const container_t* container, uint8_t typecode, bool frozen) {
+  switch (typecode) {
+    case SHARED_CONTAINER_TYPE: {
+      const shared_container_t* shared = container;
+      return sizeof(*shared) + _container_allocated_size(shared->container, shared->typecode, frozen);
+    }
+    case BITSET_CONTAINER_TYPE:
+      return sizeof(bitset_container_t) + (frozen ? 0 : BITSET_CONTAINER_SIZE_IN_WORDS * sizeof(uint64_t));
+    case ARRAY_CONTAINER_TYPE: {
+      const array_container_t* array = container;
+      return sizeof(*array) + (frozen ? 0 : (size_t) array->capacity * sizeof(uint16_t));
+    }
+    case RUN_CONTAINER_TYPE: {
+      const run_container_t* run = container;
+      return sizeof(*run) + (frozen ? 0 : (size_t) run->capacity * sizeof(rle16_t));
+    }
+  }
+  return 0;
+}
+
+size_t bitmap_allocated_size(const Bitmap* bitmap, size_t sample_size) {
+  const roaring_array_t* ra = &bitmap->high_low_container;
+  bool frozen = (ra->flags & ROARING_FLAG_FROZEN) != 0;
+  size_t n = (size_t) ra->size;
+  size_t size = sizeof(*bitmap) +
+                (size_t) ra->allocation_size * (sizeof(*ra->containers) + sizeof(*ra->keys) + sizeof(*ra->typecodes));
+
+  if (sample_size == 0 || sample_size >= n) {
+    for (size_t i = 0; i < n; i++) {
+      size += _container_allocated_size(ra->containers[i], ra->typecodes[i], frozen);
+    }
+    return size;
+  }
+
+  size_t sampled = 0;
+  for (size_t i = 0; i < sample_size; i++) {
+    size_t index = i * n / sample_size;
+    sampled += _container_allocated_size(ra->containers[index], ra->typecodes[index], frozen);
+  }
+  return size + (size_t) ((double) sampled / (double) sample_size * (double) n);
+}
+
+size_t bitmap64_allocated_size(const Bitmap64* bitmap) {
+  roaring64_statistics_t stats;
+  roaring64_bitmap_statistics(bitmap, &stats);
+  // Container headers, plus a leaf and its share of the inner nodes of the index per container
+  size_t overhead = (size_t) stats.n_array_containers * (sizeof(array_container_t) + BITMAP64_INDEX_BYTES_PER_CONTAINER) +
+                    (size_t) stats.n_run_containers * (sizeof(run_container_t) + BITMAP64_INDEX_BYTES_PER_CONTAINER) +
+                    (size_t) stats.n_bitset_containers * (sizeof(bitset_container_t) + BITMAP64_INDEX_BYTES_PER_CONTAINER);
+  return overhead + (size_t) (stats.n_bytes_array_containers + stats.n_bytes_run_containers + stats.n_bytes_bitset_containers);
+}
+
+size_t bitmap64_container_count(const Bitmap64* bitmap, size_t limit) {
+  size_t count = 0;
+  roaring64_iterator_t* iterator = roaring64_iterator_create(bitmap);
+  while (count < limit && roaring64_iterator_has_value(iterator)) {
+    count++;
+    // Jump to the first value of the next container
+    uint64_t next = (roaring64_iterator_value(iterator) | 0xFFFF) + 1;
+    if (next == 0 || !roaring64_iterator_move_equalorlarger(iterator, next)) {
+      break;
+    }
+  }
+  roaring64_iterator_free(iterator);
+  return count;
+}
+
+static container_t* _container_relocate(container_t* container, uint8_t typecode,
+                                        void* (*relocate)(void* ptr, void* arg), void* arg) {
+  container_t* moved = relocate(container, arg);
+  if (moved != NULL) {
+    container = moved;
+  }
+
+  switch (typecode) {
+    case BITSET_CONTAINER_TYPE: {
+      bitset_container_t* bitset = container;
+      uint64_t* words = relocate(bitset->words, arg);
+      if (words != NULL) {
+        bitset->words = words;
+      }
+      break;
+    }
+    case ARRAY_CONTAINER_TYPE: {
+      array_container_t* array = container;
+      uint16_t* values = array->array != NULL ? relocate(array->array, arg) : NULL;
+      if (values != NULL) {
+        array->array = values;
+      }
+      break;
+    }
+    case RUN_CONTAINER_TYPE: {
+      run_container_t* run = container;
+      rle16_t* runs = run->runs != NULL ? relocate(run->runs, arg) : NULL;
+      if (runs != NULL) {
+        run->runs = runs;
+      }
+      break;
+    }
+  }
+
+  return container;
+}
+
+uint32_t bitmap_relocate(Bitmap* bitmap, uint32_t from, void* (*relocate)(void* ptr, void* arg),
+                         bool (*should_stop)(void* arg), void* arg) {
+  roaring_array_t* ra = &bitmap->high_low_container;
+  if (ra->flags & ROARING_FLAG_FROZEN) {
+    return 0;
+  }
+
+  // Containers, keys and typecodes share one allocation, only move it when laid out as expected
+  if (from == 0 && ra->allocation_size > 0 && (void*) ra->keys == (void*) (ra->containers + ra->allocation_size) &&
+      (void*) ra->typecodes == (void*) (ra->keys + ra->allocation_size)) {
+    container_t** containers = relocate(ra->containers, arg);
+    if (containers != NULL) {
+      ra->containers = containers;
+      ra->keys = (uint16_t*) (containers + ra->allocation_size);
+      ra->typecodes = (uint8_t*) (ra->keys + ra->allocation_size);
+    }
+  }
+
+  for (int32_t i = (int32_t) from; i < ra->size; i++) {
+    // Shared containers belong to several bitmaps
+    if (ra->typecodes[i] != SHARED_CONTAINER_TYPE) {
+      ra->containers[i] = _container_relocate(ra->containers[i], ra->typecodes[i], relocate, arg);
+    }
+    if (i + 1 < ra->size && should_stop(arg)) {
+      return (uint32_t) (i + 1);
+    }
+  }
+
+  return 0;
+}
+
+uint64_t bitmap_chunk_count(const Bitmap* bitmap, uint32_t max_containers) {
+  roaring_statistics_t stats;
+  roaring_bitmap_statistics(bitmap, &stats);
+  return ((uint64_t) stats.n_containers + max_containers - 1) / max_containers;
+}
+
+uint64_t bitmap64_chunk_count(const Bitmap64* bitmap, uint32_t max_containers) {
+  roaring64_statistics_t stats;
+  roaring64_bitmap_statistics(bitmap, &stats);
+  return (stats.n_containers + max_containers - 1) / max_containers;
+}
+
+uint32_t bitmap_run_last(const Bitmap* bitmap, uint32_t start) {
+  // [start, start + lo] is known to be set, the run can't go past start + hi
+  uint64_t lo = 0;
+  uint64_t hi = UINT32_MAX - start;
+  uint64_t step = 1;
+  while (lo < hi) {
+    uint64_t probe = step < hi - lo ? lo + step : hi;
+    if (!roaring_bitmap_contains_range(bitmap, start, (uint64_t) start + probe + 1)) {
+      hi = probe - 1;
+      break;
+    }
+    lo = probe;
+    step *= 2;
+  }
+
+  while (lo < hi) {
+    uint64_t mid = lo + (hi - lo + 1) / 2;
+    if (roaring_bitmap_contains_range(bitmap, start, (uint64_t) start + mid + 1)) {
+      lo = mid;
+    } else {
+      hi = mid - 1;
+    }
+  }
+
+  return (uint32_t) (start + lo);
+}
+
+static inline bool bitmap64_contains_range_closed(const Bitmap64* bitmap, uint64_t min, uint64_t max) {
+  if (max == UINT64_MAX) {
+    return roaring64_bitmap_contains(bitmap, max) && (min == max || roaring64_bitmap_contains_range(bitmap, min, max));
+  }
+  return roaring64_bitmap_contains_range(bitmap, min, max + 1);
+}
+
+uint64_t bitmap64_run_last(const Bitmap64* bitmap, uint64_t start) {
+  // [start, start + lo] is known to be set, the run can't go past start + hi
+  uint64_t lo = 0;
+  uint64_t hi = UINT64_MAX - start;
+  uint64_t step = 1;
+  while (lo < hi) {
+    uint64_t probe = step < hi - lo ? lo + step : hi;
+    if (!bitmap64_contains_range_closed(bitmap, start, start + probe)) {
+      hi = probe - 1;
+      break;
+    }
+    lo = probe;
+    step *= 2;
+  }
+
+  while (lo < hi) {
+    uint64_t mid = lo + (hi - lo) / 2 + 1;
+    if (bitmap64_contains_range_closed(bitmap, start, start + mid)) {
+      lo = mid;
+    } else {
+      hi = mid - 1;
+    }
+  }
+
+  return start + lo;
+}
+
+Bitmap* bitmap_next_chunk(const Bitmap* bitmap, roaring_uint32_iterator_t* iterator, uint32_t max_containers) {
+  if (!iterator->has_value) {
+    return NULL;
+  }
+
+  uint32_t min = iterator->current_value;
+  uint32_t max;
+  uint32_t containers = 0;
+  do {
+    max = iterator->current_value | 0xFFFF;
+    containers++;
+  } while (max != UINT32_MAX && roaring_uint32_iterator_move_equalorlarger(iterator, max + 1) && containers < max_containers);
+
+  if (max == UINT32_MAX) {
+    // the last container can't be skipped with move_equalorlarger, drain it instead
+    while (roaring_uint32_iterator_advance(iterator)) {}
+  }
+
+  // Copy the containers of the chunk, a range mask would hold one container per key in [min, max]
+  Bitmap view;
+  bitmap_container_range_view(bitmap, (uint16_t) (min >> 16), (uint16_t) (max >> 16), &view);
+  return roaring_bitmap_copy(&view);
+}
+
+Bitmap64* bitmap64_next_chunk(const Bitmap64* bitmap, roaring64_iterator_t* iterator, uint32_t max_containers) {
+  if (!roaring64_iterator_has_value(iterator)) {
+    return NULL;
+  }
+
+  uint64_t min = roaring64_iterator_value(iterator);
+  uint64_t max;
+  uint32_t containers = 0;
+  do {
+    max = roaring64_iterator_value(iterator) | 0xFFFF;
+    containers++;
+  } while (max != UINT64_MAX && roaring64_iterator_move_equalorlarger(iterator, max + 1) && containers < max_containers);
+
+  if (max == UINT64_MAX) {
+    // the last container can't be skipped with move_equalorlarger, drain it instead
+    while (roaring64_iterator_advance(iterator)) {}
+  }
+
+  // Collect the values of the chunk in batches, a range mask would hold one container per key in
+  // [min, max] however far apart the containers are
+  Bitmap64* chunk = roaring64_bitmap_create();
+  roaring64_iterator_t* values = roaring64_iterator_create(bitmap);
+  roaring64_iterator_move_equalorlarger(values, min);
+
+  uint64_t buffer[BITMAP64_CHUNK_READ_BATCH];
+  uint64_t n;
+  do {
+    n = roaring64_iterator_read(values, buffer, BITMAP64_CHUNK_READ_BATCH);
+    uint64_t in_chunk = n;
+    while (in_chunk > 0 && buffer[in_chunk - 1] > max) {
+      in_chunk--;
+    }
+    roaring64_bitmap_add_many(chunk, in_chunk, buffer);
+    if (in_chunk < n) {
+      break;
+    }
+  } while (n == BITMAP64_CHUNK_READ_BATCH);
+
+  roaring64_iterator_free(values);
+  return chunk;
+}
+
 static inline int bitmap_stat_json(const Bitmap* bitmap, char** result) {
   roaring_statistics_t stats;
   roaring_bitmap_statistics(bitmap, &stats);
@@ -1280,3 +2100,151 @@ char* bitmap64_statistics_str(const Bitmap64* bitmap, int format, int* size) {
 
   return result;
 }
+
+char* bitmap_serialize(const Bitmap* bitmap, size_t* size) {
+  char* buffer = rm_malloc(roaring_bitmap_portable_size_in_bytes(bitmap));
+  *size = roaring_bitmap_portable_serialize(bitmap, buffer);
+  return buffer;
+}
+
+char* bitmap64_serialize(const Bitmap64* bitmap, size_t* size) {
+  char* buffer = rm_malloc(roaring64_bitmap_portable_size_in_bytes(bitmap));
+  *size = roaring64_bitmap_portable_serialize(bitmap, buffer);
+  return buffer;
+}
+
+Bitmap* bitmap_deserialize(const char* buffer, size_t size) {
+  // Trailing bytes are rejected too, so a blob round-trips to exactly one bitmap
+  if (roaring_bitmap_portable_deserialize_size(buffer, size) != size) {
+    return NULL;
+  }
+
+  Bitmap* bitmap = roaring_bitmap_portable_deserialize_safe(buffer, size);
+  if (bitmap == NULL) {
+    return NULL;
+  }
+
+  // deserialize_safe only bounds the reads, inconsistent containers must be caught here
+  const char* reason = NULL;
+  if (!roaring_bitmap_internal_validate(bitmap, &reason)) {
+    roaring_bitmap_free(bitmap);
+    return NULL;
+  }
+
+  return bitmap;
+}
+
+Bitmap64* bitmap64_deserialize(const char* buffer, size_t size) {
+  if (roaring64_bitmap_portable_deserialize_size(buffer, size) != size) {
+    return NULL;
+  }
+
+  Bitmap64* bitmap = roaring64_bitmap_portable_deserialize_safe(buffer, size);
+  if (bitmap == NULL) {
+    return NULL;
+  }
+
+  const char* reason = NULL;
+  if (!roaring64_bitmap_internal_validate(bitmap, &reason)) {
+    roaring64_bitmap_free(bitmap);
+    return NULL;
+  }
+
+  return bitmap;
+}
+
+uint32_t* bitmap_scan(const Bitmap* bitmap, uint32_t cursor, uint32_t count, size_t* n, bool* has_more) {
+  // COUNT is a hint, don't allocate more than the bitmap can return
+  uint64_t cardinality = roaring_bitmap_get_cardinality(bitmap);
+  uint32_t* values = rm_malloc(sizeof(*values) * (cardinality < count ? cardinality : count));
+  *n = 0;
+  *has_more = false;
+
+  roaring_uint32_iterator_t* iterator = roaring_iterator_create(bitmap);
+  if (roaring_uint32_iterator_move_equalorlarger(iterator, cursor)) {
+    *n = roaring_uint32_iterator_read(iterator, values, count);
+    *has_more = iterator->has_value;
+  }
+  roaring_uint32_iterator_free(iterator);
+
+  return values;
+}
+
+uint64_t* bitmap64_scan(const Bitmap64* bitmap, uint64_t cursor, uint64_t count, uint64_t* n, bool* has_more) {
+  uint64_t cardinality = roaring64_bitmap_get_cardinality(bitmap);
+  uint64_t* values = rm_malloc(sizeof(*values) * (cardinality < count ? cardinality : count));
+  *n = 0;
+  *has_more = false;
+
+  roaring64_iterator_t* iterator = roaring64_iterator_create(bitmap);
+  if (roaring64_iterator_move_equalorlarger(iterator, cursor)) {
+    *n = roaring64_iterator_read(iterator, values, count);
+    *has_more = roaring64_iterator_has_value(iterator);
+  }
+  roaring64_iterator_free(iterator);
+
+  return values;
+}
+
+uint64_t bitmap_range_cardinality(const Bitmap* bitmap, uint32_t min, uint32_t max) {
+  return roaring_bitmap_range_cardinality(bitmap, min, (uint64_t) max + 1);
+}
+
+uint64_t bitmap64_range_cardinality(const Bitmap64* bitmap, uint64_t min, uint64_t max) {
+  return roaring64_bitmap_range_closed_cardinality(bitmap, min, max);
+}
+
+uint32_t* bitmap_range_by_value(const Bitmap* bitmap, uint32_t min, uint32_t max, uint64_t offset, uint64_t count, size_t* n) {
+  uint64_t available = bitmap_range_cardinality(bitmap, min, max);
+  uint64_t size = offset < available ? available - offset : 0;
+  if (count < size) {
+    size = count;
+  }
+
+  uint32_t* values = rm_malloc(sizeof(*values) * (size > 0 ? size : 1));
+  *n = 0;
+  if (size == 0) {
+    return values;
+  }
+
+  uint32_t first = min;
+  if (offset > 0) {
+    uint64_t below = min > 0 ? roaring_bitmap_rank(bitmap, min - 1) : 0;
+    roaring_bitmap_select(bitmap, (uint32_t) (below + offset), &first);
+  }
+
+  // `size` values past `first` are all in the window, so the read needs no bound check
+  roaring_uint32_iterator_t* iterator = roaring_iterator_create(bitmap);
+  roaring_uint32_iterator_move_equalorlarger(iterator, first);
+  *n = roaring_uint32_iterator_read(iterator, values, (uint32_t) size);
+  roaring_uint32_iterator_free(iterator);
+
+  return values;
+}
+
+uint64_t* bitmap64_range_by_value(const Bitmap64* bitmap, uint64_t min, uint64_t max, uint64_t offset, uint64_t count, uint64_t* n) {
+  uint64_t available = bitmap64_range_cardinality(bitmap, min, max);
+  uint64_t size = offset < available ? available - offset : 0;
+  if (count < size) {
+    size = count;
+  }
+
+  uint64_t* values = rm_malloc(sizeof(*values) * (size > 0 ? size : 1));
+  *n = 0;
+  if (size == 0) {
+    return values;
+  }
+
+  uint64_t first = min;
+  if (offset > 0) {
+    uint64_t below = min > 0 ? roaring64_bitmap_rank(bitmap, min - 1) : 0;
+    roaring64_bitmap_select(bitmap, below + offset, &first);
+  }
+
+  roaring64_iterator_t* iterator = roaring64_iterator_create(bitmap);
+  roaring64_iterator_move_equalorlarger(iterator, first);
+  *n = roaring64_iterator_read(iterator, values, size);
+  roaring64_iterator_free(iterator);
+
+  return values;
+}
@@ -11,6 +11,23 @@
 #define BITMAP_INTERSECT_MODE_ALL_STRICT 2
 #define BITMAP_INTERSECT_MODE_EQ 3
 
+#define BITMAP_OPERATION_AND 0
+#define BITMAP_OPERATION_OR 1
+#define BITMAP_OPERATION_XOR 2
+#define BITMAP_OPERATION_ANDOR 3
+#define BITMAP_OPERATION_ONE 4
+#define BITMAP_OPERATION_ANDNOT 5
+#define BITMAP_OPERATION_ORNOT 6
+
+#define BITMAP_INT_ENCODING_FIXED 0
+#define BITMAP_INT_ENCODING_DELTA 1
+#define BITMAP_INT_ENCODING_VARINT 2
+
+// bitmap64_allocated_size: estimated bytes of the 64-bit index (leaf and inner nodes) per container
+#define BITMAP64_INDEX_BYTES_PER_CONTAINER 48
+// bitmap64_next_chunk: values read from the iterator at a time
+#define BITMAP64_CHUNK_READ_BATCH 1024
+
 typedef roaring_bitmap_t Bitmap;
 typedef roaring_statistics_t Bitmap_statistics;
 
@@ -29,6 +46,14 @@ bool bitmap_getbit(const Bitmap* bitmap, uint32_t offset);
 bool bitmap64_getbit(const Bitmap64* bitmap, uint64_t offset);
 bool* bitmap64_getbits(const Bitmap64* bitmap, size_t n_offsets, const uint64_t* offsets);
 bool* bitmap_getbits(const Bitmap* bitmap, size_t n_offsets, const uint32_t* offsets);
+/**
+ * Batch membership over `n_offsets` packed little-endian offsets (4 bytes each for Bitmap,
+ * 8 bytes for Bitmap64). Writes one bit per offset into `bits`, which must hold (n_offsets + 7) / 8
+ * bytes, most significant bit first like Redis string bitmaps. The offsets are probed in sorted order,
+ * `n_offsets` must be below 2^32 for Bitmap.
+ */
+void bitmap_getbits_packed(const Bitmap* bitmap, size_t n_offsets, const unsigned char* offsets, unsigned char* bits);
+void bitmap64_getbits_packed(const Bitmap64* bitmap, size_t n_offsets, const unsigned char* offsets, unsigned char* bits);
 bool bitmap_clearbits(Bitmap* bitmap, size_t n_offsets, const uint32_t* offsets);
 bool bitmap64_clearbits(Bitmap64* bitmap, size_t n_offsets, const uint64_t* offsets);
 bool bitmap_intersect(const Bitmap* b1, const Bitmap* b2, uint32_t mode);
@@ -37,6 +62,14 @@ size_t bitmap_clearbits_count(Bitmap* bitmap, size_t n_offsets, const uint32_t*
 size_t bitmap64_clearbits_count(Bitmap64* bitmap, size_t n_offsets, const uint64_t* offsets);
 double bitmap_jaccard(const Bitmap* b1, const Bitmap* b2);
 double bitmap64_jaccard(const Bitmap64* b1, const Bitmap64* b2);
+/**
+ * Fills the rows i = first_row, first_row + row_step, ... of the n x n intersection cardinality matrix,
+ * `matrix[i * n + j] = matrix[j * n + i] = |bitmaps[i] ∩ bitmaps[j]|` for j > i. The diagonal must already
+ * hold the cardinalities, it is read for pairs of identical bitmaps and never written.
+ * Disjoint sets of rows can be filled concurrently.
+ */
+void bitmap_intersection_matrix_rows(uint32_t n, const Bitmap** bitmaps, uint32_t first_row, uint32_t row_step, uint64_t* matrix);
+void bitmap64_intersection_matrix_rows(uint32_t n, const Bitmap64** bitmaps, uint32_t first_row, uint32_t row_step, uint64_t* matrix);
 /**
  * Gets the n-th element of the set.
  *
@@ -49,6 +82,18 @@ double bitmap64_jaccard(const Bitmap64* b1, const Bitmap64* b2);
  */
 int64_t bitmap_get_nth_element_present(const Bitmap* bitmap, uint64_t n);
 uint64_t bitmap64_get_nth_element_present(const Bitmap64* bitmap, uint64_t n, bool* found);
+/**
+ * Counts the elements of the set smaller or equal to `value`, the inverse of `bitmap_get_nth_element_present`
+ *
+ * @param bitmap - the bitmap set
+ * @param value - the element to rank, present in the set or not
+ *
+ * @return the rank of the element
+ *
+ * @example set {1, 10, 100, 1000} and value=1 returns 1, value=50 returns 2, value=0 returns 0
+ */
+uint64_t bitmap_rank(const Bitmap* bitmap, uint32_t value);
+uint64_t bitmap64_rank(const Bitmap64* bitmap, uint64_t value);
 /**
  * Gets the n-th element not present in the set
  *
@@ -80,6 +125,26 @@ void bitmap_ornot(Bitmap* r, uint32_t n, const Bitmap** bitmaps);
 void bitmap64_ornot(Bitmap64* r, uint32_t n, const Bitmap64** bitmaps);
 void bitmap_one(Bitmap* r, uint32_t n, const Bitmap** bitmaps);
 void bitmap64_one(Bitmap64* r, uint32_t n, const Bitmap64** bitmaps);
+/**
+ * Cardinality of the result of `bitmap_<operation>(r, n, bitmaps)` (BITMAP_OPERATION_*), computed with
+ * the roaring cardinality kernels: at most one scratch bitmap is built and the largest source is never copied
+ */
+uint64_t bitmap_operation_cardinality(int operation, uint32_t n, const Bitmap** bitmaps);
+uint64_t bitmap64_operation_cardinality(int operation, uint32_t n, const Bitmap64** bitmaps);
+/**
+ * Makes `view` a read-only view of the containers of `bitmap` whose key (the high 16 bits of their values)
+ * is in [first_key, last_key]. The view shares the containers of `bitmap`: it must not be modified nor freed,
+ * and it is valid only as long as `bitmap` is not modified.
+ */
+void bitmap_container_range_view(const Bitmap* bitmap, uint16_t first_key, uint16_t last_key, Bitmap* view);
+/**
+ * Splits the container key space of `bitmaps` into at most `max_parts` consecutive ranges holding a similar
+ * number of containers, with at least `min_containers` containers per range in total.
+ * Range i starts at key first_keys[i] and ends right before first_keys[i + 1] (the last one ends at 0xFFFF).
+ *
+ * @return the number of ranges written to `first_keys`, 1 when the work is too small to be split
+ */
+uint32_t bitmap_partition_keys(uint32_t n, const Bitmap** bitmaps, uint32_t max_parts, uint64_t min_containers, uint16_t* first_keys);
 Bitmap* bitmap_flip(const Bitmap* bitmap, uint32_t end);
 Bitmap64* bitmap64_flip(const Bitmap64* bitmap, uint64_t end);
 char* bitmap_statistics_str(const Bitmap* bitmap, int format, int* size_out);
@@ -100,8 +165,24 @@ Bitmap* bitmap_not(const Bitmap* bitmap);
 Bitmap64* bitmap64_not(const Bitmap64* bitmap);
 Bitmap* bitmap_from_int_array(size_t n, const uint32_t* array);
 Bitmap64* bitmap64_from_int_array(size_t n, const uint64_t* array);
+/**
+ * Decodes a packed integer array: little-endian fixed width values (4 bytes for Bitmap, 8 bytes for Bitmap64)
+ * or unsigned LEB128 varints with BITMAP_INT_ENCODING_VARINT. With BITMAP_INT_ENCODING_DELTA every value is
+ * the difference to the previous one, modulo 2^32 (2^64). The flags can be combined.
+ * Returns false on a truncated buffer or an out of range varint, otherwise `*values` is an rm_malloc'd array
+ * of `*n` values.
+ */
+bool bitmap_decode_int_array(size_t size, const unsigned char* buffer, int encoding, uint32_t** values, size_t* n);
+bool bitmap64_decode_int_array(size_t size, const unsigned char* buffer, int encoding, uint64_t** values, size_t* n);
 uint32_t* bitmap_get_int_array(const Bitmap* bitmap, size_t* n);
 uint64_t* bitmap64_get_int_array(const Bitmap64* bitmap, uint64_t* n);
+/**
+ * Returns the values ranked `start_offset` to `end_offset` (inclusive, 0-based) in increasing order.
+ * The cost depends on the number of values returned, not on the requested range.
+ *
+ * @param result_count - the number of values returned, fewer than requested past the end of the bitmap
+ * @return the values, to be released with `rm_free`, or NULL when the range is invalid
+ */
 uint32_t* bitmap_range_int_array(const Bitmap* bitmap, size_t start_offset, size_t end_offset, size_t* result_count);
 uint64_t* bitmap64_range_int_array(const Bitmap64* bitmap, uint64_t start_offset, uint64_t end_offset, uint64_t* result_count);
 /**
@@ -140,7 +221,135 @@ uint32_t bitmap_max(const Bitmap* bitmap);
 uint64_t bitmap64_max(const Bitmap64* bitmap);
 bool bitmap_optimize(Bitmap* bitmap, int shrink_to_fit);
 bool bitmap64_optimize(Bitmap64* bitmap, int shrink_to_fit);
+/**
+ * Converts every container to its smallest type and releases the unused capacity
+ *
+ * @return the number of bytes reclaimed, as measured by the serialized size and the capacity released
+ */
+size_t bitmap_compact(Bitmap* bitmap);
+size_t bitmap64_compact(Bitmap64* bitmap);
 void bitmap_statistics(const Bitmap* bitmap, Bitmap_statistics* stat);
 void bitmap64_statistics(const Bitmap64* bitmap, Bitmap64_statistics* stat);
+/**
+ * Heap bytes held by the bitmap: the bitmap itself, its container index and the allocated capacity
+ * of its containers. The containers of a frozen bitmap are only counted for their headers, their
+ * values belong to the buffer the bitmap was deserialized from.
+ *
+ * @param sample_size - when non-zero and lower than the number of containers, only that many containers
+ *                      spread over the bitmap are measured and their average is extrapolated
+ */
+size_t bitmap_allocated_size(const Bitmap* bitmap, size_t sample_size);
+/**
+ * Estimate of the heap bytes held by the bitmap from its container statistics, the layout of the
+ * 64-bit index is not exposed by CRoaring
+ */
+size_t bitmap64_allocated_size(const Bitmap64* bitmap);
+/**
+ * Counts the containers of the bitmap, stopping at `limit`
+ */
+size_t bitmap64_container_count(const Bitmap64* bitmap, size_t limit);
+/**
+ * Moves the container index and the containers of the bitmap, from container `from` on, to the
+ * allocations returned by `relocate`, which returns NULL to leave an allocation in place. The index is
+ * only moved when starting from 0, the bitmap itself is never moved. Frozen bitmaps are left alone.
+ *
+ * @param should_stop - checked after each container to stop early
+ * @return the container to resume from, 0 once every container was visited
+ */
+uint32_t bitmap_relocate(Bitmap* bitmap, uint32_t from, void* (*relocate)(void* ptr, void* arg),
+                         bool (*should_stop)(void* arg), void* arg);
+/**
+ * Counts the chunks `bitmap_next_chunk` splits the bitmap into
+ *
+ * @param bitmap - the bitmap to be split
+ * @param max_containers - the maximum number of containers of a chunk
+ * @return the number of chunks, 0 for an empty bitmap
+ */
+uint64_t bitmap_chunk_count(const Bitmap* bitmap, uint32_t max_containers);
+uint64_t bitmap64_chunk_count(const Bitmap64* bitmap, uint32_t max_containers);
+/**
+ * Finds the end of the run of consecutive values starting at `start`, using a galloping search
+ * over range checks instead of visiting every value of the run.
+ *
+ * @param bitmap - the bitmap set
+ * @param start - the first value of the run, it must be present in the bitmap
+ * @return the last value of the run
+ *
+ * @example set {1, 2, 3, 7} and start=1 returns 3, start=7 returns 7
+ */
+uint32_t bitmap_run_last(const Bitmap* bitmap, uint32_t start);
+uint64_t bitmap64_run_last(const Bitmap64* bitmap, uint64_t start);
+/**
+ * Copies the next `max_containers` non-empty containers (values sharing their upper bits,
+ * all but the lowest 16) starting at the iterator position, and moves the iterator to the
+ * first value after them. The extra memory needed is bounded by the chunk, not the bitmap nor the
+ * distance between its containers.
+ *
+ * @param bitmap - the bitmap being split
+ * @param iterator - an iterator over `bitmap`
+ * @param max_containers - the maximum number of containers of the chunk
+ * @return the chunk, or NULL when the iterator is exhausted
+ *
+ * @example set {1, 2, 65536, 131072} and max_containers=2 returns {1, 2}, {65536, 131072}, NULL
+ */
+Bitmap* bitmap_next_chunk(const Bitmap* bitmap, roaring_uint32_iterator_t* iterator, uint32_t max_containers);
+Bitmap64* bitmap64_next_chunk(const Bitmap64* bitmap, roaring64_iterator_t* iterator, uint32_t max_containers);
+/**
+ * Serializes a bitmap in the portable format, shared with the Java, Go and C++ roaring libraries
+ *
+ * @param bitmap - the bitmap to be serialized
+ * @param size - the serialized size
+ * @return the serialized bitmap, to be released with `rm_free`
+ */
+char* bitmap_serialize(const Bitmap* bitmap, size_t* size);
+char* bitmap64_serialize(const Bitmap64* bitmap, size_t* size);
+/**
+ * Deserializes an untrusted bitmap in the portable format. Reads never go past `size` and the
+ * containers are validated before the bitmap is returned.
+ *
+ * @param buffer - the serialized bitmap
+ * @param size - the buffer size, which must match the serialized size exactly
+ * @return the bitmap, or NULL when the buffer isn't a valid serialized bitmap
+ */
+Bitmap* bitmap_deserialize(const char* buffer, size_t size);
+Bitmap64* bitmap64_deserialize(const char* buffer, size_t size);
+/**
+ * Reads up to `count` values equal or larger than `cursor`, in increasing order. The iterator
+ * jumps straight to `cursor`, so the cost depends on `count` and not on the position.
+ *
+ * @param bitmap - the bitmap to be scanned
+ * @param cursor - the first value to consider
+ * @param count - the maximum number of values to read
+ * @param n - the number of values read
+ * @param has_more - whether values remain after the ones read
+ * @return the values read, to be released with `rm_free`
+ *
+ * @example set {1, 5, 7, 9}, cursor=2 and count=2 returns {5, 7} and has_more=true
+ */
+uint32_t* bitmap_scan(const Bitmap* bitmap, uint32_t cursor, uint32_t count, size_t* n, bool* has_more);
+uint64_t* bitmap64_scan(const Bitmap64* bitmap, uint64_t cursor, uint64_t count, uint64_t* n, bool* has_more);
+/**
+ * Counts the values between `min` and `max` (inclusive)
+ *
+ * @example set {1, 5, 7, 9}, min=2 and max=7 returns 2
+ */
+uint64_t bitmap_range_cardinality(const Bitmap* bitmap, uint32_t min, uint32_t max);
+uint64_t bitmap64_range_cardinality(const Bitmap64* bitmap, uint64_t min, uint64_t max);
+/**
+ * Reads the values between `min` and `max` (inclusive) in increasing order, skipping the first
+ * `offset` ones. The skipped values are jumped over by rank, and nothing outside the window is read.
+ *
+ * @param bitmap - the bitmap set
+ * @param min - the smallest value of the window
+ * @param max - the largest value of the window
+ * @param offset - the number of values of the window to skip
+ * @param count - the maximum number of values to read
+ * @param n - the number of values read
+ * @return the values read, to be released with `rm_free`
+ *
+ * @example set {1, 5, 7, 9, 12}, min=2, max=10, offset=1 and count=5 returns {7, 9}
+ */
+uint32_t* bitmap_range_by_value(const Bitmap* bitmap, uint32_t min, uint32_t max, uint64_t offset, uint64_t count, size_t* n);
+uint64_t* bitmap64_range_by_value(const Bitmap64* bitmap, uint64_t min, uint64_t max, uint64_t offset, uint64_t count, uint64_t* n);
 
 #endif
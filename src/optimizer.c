@@ -0,0 +1,141 @@
+#include "optimizer.h"
+#include "r_32.h"
+#include "r_64.h"
+#include "rmalloc.h"
+
+static uint32_t OptimizerInterval = 0;
+static uint32_t OptimizerBudget = 0;
+static uint64_t OptimizerMaxBytes = 0;
+
+// Position of the walk: database, cursor in it, and whether the cursor reached its end
+static int OptimizerDb = 0;
+static RedisModuleScanCursor* OptimizerCursor = NULL;
+static bool OptimizerDbDone = false;
+
+// Keys the scan returned after the budget of the tick ran out, visited first by the next tick
+static RedisModuleString** Pending = NULL;
+static size_t PendingCount = 0;
+static size_t PendingCapacity = 0;
+static size_t PendingNext = 0;
+
+static uint64_t OptimizerPasses = 0;
+static uint64_t OptimizerKeysCompacted = 0;
+static uint64_t OptimizerBytesReclaimed = 0;
+static uint64_t OptimizerKeysTooLarge = 0;
+
+static bool BudgetExhausted(uint64_t deadline) {
+  return RedisModule_MonotonicMicroseconds() >= deadline;
+}
+
+static void PendingPush(RedisModuleString* keyname) {
+  if (PendingCount == PendingCapacity) {
+    PendingCapacity = PendingCapacity == 0 ? 16 : PendingCapacity * 2;
+    Pending = rm_realloc(Pending, PendingCapacity * sizeof(*Pending));
+  }
+  Pending[PendingCount++] = RedisModule_CreateStringFromString(NULL, keyname);
+}
+
+static void CompactKey(RedisModuleKey* key) {
+  if (RedisModule_KeyType(key) != REDISMODULE_KEYTYPE_MODULE) {
+    return;
+  }
+
+  RedisModuleType* type = RedisModule_ModuleTypeGetType(key);
+  OptimizerCompactResult result = OPTIMIZER_COMPACT_SKIPPED;
+  size_t reclaimed = 0;
+  if (type == BitmapType) {
+    result = BitmapBackgroundCompact(RedisModule_ModuleTypeGetValue(key), OptimizerMaxBytes, &reclaimed);
+  } else if (type == Bitmap64Type) {
+    result = Bitmap64BackgroundCompact(RedisModule_ModuleTypeGetValue(key), OptimizerMaxBytes, &reclaimed);
+  }
+
+  if (result == OPTIMIZER_COMPACT_DONE) {
+    OptimizerKeysCompacted++;
+    OptimizerBytesReclaimed += reclaimed;
+  } else if (result == OPTIMIZER_COMPACT_TOO_LARGE) {
+    OptimizerKeysTooLarge++;
+  }
+}
+
+static void OptimizerScanKey(RedisModuleCtx* ctx, RedisModuleString* keyname, RedisModuleKey* key, void* privdata) {
+  REDISMODULE_NOT_USED(ctx);
+  const uint64_t* deadline = privdata;
+
+  if (key != NULL && RedisModule_KeyType(key) != REDISMODULE_KEYTYPE_MODULE) {
+    return;
+  }
+
+  if (key == NULL || BudgetExhausted(*deadline)) {
+    PendingPush(keyname);
+    return;
+  }
+
+  CompactKey(key);
+}
+
+static void CompactPendingKey(RedisModuleCtx* ctx, RedisModuleString* keyname) {
+  // Don't let the walk count as an access for eviction or keyspace statistics
+  RedisModuleKey* key =
+      RedisModule_OpenKey(ctx, keyname, REDISMODULE_READ | REDISMODULE_OPEN_KEY_NOTOUCH | REDISMODULE_OPEN_KEY_NOSTATS);
+  CompactKey(key);
+  RedisModule_CloseKey(key);
+  RedisModule_FreeString(NULL, keyname);
+}
+
+static void OptimizerTick(RedisModuleCtx* ctx, void* data) {
+  REDISMODULE_NOT_USED(data);
+  uint64_t deadline = RedisModule_MonotonicMicroseconds() + (uint64_t) OptimizerBudget * 1000;
+
+  if (RedisModule_SelectDb(ctx, OptimizerDb) != REDISMODULE_OK) {
+    OptimizerDb = 0;
+    OptimizerDbDone = false;
+    RedisModule_ScanCursorRestart(OptimizerCursor);
+    RedisModule_SelectDb(ctx, OptimizerDb);
+  }
+
+  while (!BudgetExhausted(deadline)) {
+    if (PendingNext < PendingCount) {
+      CompactPendingKey(ctx, Pending[PendingNext++]);
+      continue;
+    }
+    PendingCount = 0;
+    PendingNext = 0;
+
+    if (OptimizerDbDone) {
+      OptimizerDbDone = false;
+      RedisModule_ScanCursorRestart(OptimizerCursor);
+      if (RedisModule_SelectDb(ctx, ++OptimizerDb) != REDISMODULE_OK) {
+        // Every database was walked, the next pass starts with the next tick
+        OptimizerDb = 0;
+        OptimizerPasses++;
+        break;
+      }
+      continue;
+    }
+
+    OptimizerDbDone = !RedisModule_Scan(ctx, OptimizerCursor, OptimizerScanKey, &deadline);
+  }
+
+  RedisModule_CreateTimer(ctx, OptimizerInterval, OptimizerTick, NULL);
+}
+
+void optimizer_start(RedisModuleCtx* ctx, uint32_t interval_ms, uint32_t budget_ms, uint64_t max_bytes) {
+  if (interval_ms == 0 || OptimizerCursor != NULL) {
+    return;
+  }
+
+  OptimizerInterval = interval_ms;
+  OptimizerBudget = budget_ms;
+  OptimizerMaxBytes = max_bytes;
+  OptimizerCursor = RedisModule_ScanCursorCreate();
+  RedisModule_CreateTimer(ctx, OptimizerInterval, OptimizerTick, NULL);
+}
+
+void optimizer_info(RedisModuleInfoCtx* ctx) {
+  RedisModule_InfoAddSection(ctx, "optimizer");
+  RedisModule_InfoAddFieldULongLong(ctx, "optimizer_enabled", OptimizerCursor != NULL);
+  RedisModule_InfoAddFieldULongLong(ctx, "optimizer_passes", OptimizerPasses);
+  RedisModule_InfoAddFieldULongLong(ctx, "optimizer_keys_compacted", OptimizerKeysCompacted);
+  RedisModule_InfoAddFieldULongLong(ctx, "optimizer_bytes_reclaimed", OptimizerBytesReclaimed);
+  RedisModule_InfoAddFieldULongLong(ctx, "optimizer_keys_too_large", OptimizerKeysTooLarge);
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "redismodule.h"
+
+#define OPTIMIZER_DEFAULT_MAX_BYTES (1024 * 1024)
+
+typedef enum {
+  OPTIMIZER_COMPACT_SKIPPED,
+  OPTIMIZER_COMPACT_DONE,
+  // Above the size cap of the optimizer, compacting it at once would overrun the budget of a step
+  OPTIMIZER_COMPACT_TOO_LARGE
+} OptimizerCompactResult;
+
+/**
+ * Starts the background optimizer: every `interval_ms` milliseconds a module timer resumes a walk
+ * of the keyspace and compacts the bitmaps written since their last visit, for at most `budget_ms`
+ * milliseconds. Bitmaps larger than `max_bytes` are left to R.OPTIMIZE, 0 lifts the cap. An interval
+ * of 0 leaves the optimizer disabled.
+ */
+void optimizer_start(RedisModuleCtx* ctx, uint32_t interval_ms, uint32_t budget_ms, uint64_t max_bytes);
+/**
+ * Adds the optimizer counters to INFO.
+ */
+void optimizer_info(RedisModuleInfoCtx* ctx);
@@ -1,16 +1,34 @@
 #include "r_32.h"
 #include <limits.h>
+#include <pthread.h>
 #include <stdio.h>
 #include "rmalloc.h"
 #include "roaring.h"
 #include "common.h"
 #include "parse.h"
 #include "bitop_keys.h"
+#include "similarity.h"
+#include "thread-pool.h"
+#include "cardinality-cache.h"
 #include "cmd_info/command_info.h"
 
 RedisModuleType* BitmapType = NULL;
 Bitmap* BITMAP_NILL = NULL;
 
+/**
+ * Bitmaps stored as a single portable buffer in the RDB (encver 2, or encver 3 with one chunk)
+ * are loaded as frozen views over the buffer returned by RedisModule_LoadStringBuffer:
+ * loading neither copies the payload nor allocates containers.
+ * Each view owns its buffer through this registry (bitmap pointer -> buffer). Views are
+ * read-only, so they are thawed into regular bitmaps the first time their key is opened for
+ * writing. The lock is needed because lazyfree may release values from a background thread.
+ * Only bitmaps flagged ROARING_FLAG_FROZEN are looked up, so regular bitmaps never take the lock.
+ */
+static RedisModuleDict* FrozenBitmaps = NULL;
+static pthread_mutex_t FrozenBitmapsLock = PTHREAD_MUTEX_INITIALIZER;
+
+void BitmapFree(void* value);
+
 #define ERRORMSG_KEY_MISSED "Roaring: key does not exist"
 #define ERRORMSG_KEY_EXISTS "Roaring: key already exist"
 #define ERRORMSG_SET_VALUE "Roaring: error setting value"
@@ -69,6 +87,61 @@ static int ReplyWithJaccardRatio(RedisModuleCtx* ctx, uint64_t intersection, uin
   return RedisModule_ReplyWithStringBuffer(ctx, buffer, (size_t) len);
 }
 
+static bool IsFrozenBitmap(const Bitmap* bitmap) {
+  return (bitmap->high_low_container.flags & ROARING_FLAG_FROZEN) != 0;
+}
+
+/**
+ * Buffer a frozen bitmap is a view of, `remove` also drops it from the registry
+ */
+static char* FrozenBuffer(const Bitmap* bitmap, bool remove) {
+  if (!IsFrozenBitmap(bitmap)) {
+    return NULL;
+  }
+  char* buffer = NULL;
+  pthread_mutex_lock(&FrozenBitmapsLock);
+  if (remove) {
+    RedisModule_DictDelC(FrozenBitmaps, (void*) &bitmap, sizeof(bitmap), &buffer);
+  } else {
+    buffer = RedisModule_DictGetC(FrozenBitmaps, (void*) &bitmap, sizeof(bitmap), NULL);
+  }
+  pthread_mutex_unlock(&FrozenBitmapsLock);
+  return buffer;
+}
+
+static Bitmap* FrozenView(const char* buffer, size_t size) {
+  if (roaring_bitmap_portable_deserialize_size(buffer, size) != size) {
+    return NULL;
+  }
+  return roaring_bitmap_portable_deserialize_frozen(buffer);
+}
+
+static Bitmap* FreezeBitmap(char* buffer, size_t size) {
+  Bitmap* bitmap = FrozenView(buffer, size);
+  if (bitmap == NULL) {
+    return NULL;
+  }
+  pthread_mutex_lock(&FrozenBitmapsLock);
+  RedisModule_DictSetC(FrozenBitmaps, &bitmap, sizeof(bitmap), buffer);
+  pthread_mutex_unlock(&FrozenBitmapsLock);
+  return bitmap;
+}
+
+/**
+ * Replaces a frozen view stored in `key` by a regular, writable copy (TTL is preserved).
+ * Returns the bitmap that is now stored in the key.
+ */
+static Bitmap* ThawBitmap(RedisModuleKey* key, Bitmap* bitmap) {
+  if (!IsFrozenBitmap(bitmap)) {
+    return bitmap;
+  }
+  Bitmap* thawed = roaring_bitmap_copy(bitmap);
+  void* frozen = NULL;
+  RedisModule_ModuleTypeReplaceValue(key, BitmapType, thawed, &frozen);
+  BitmapFree(frozen);
+  return thawed;
+}
+
 static int GetBitmapKey(RedisModuleCtx* ctx, RedisModuleString* keyName, Bitmap** value_out, int mode) {
   RedisModuleKey* key = RedisModule_OpenKey(ctx, keyName, mode);
   if (RedisModule_KeyType(key) == REDISMODULE_KEYTYPE_EMPTY) {
@@ -79,6 +152,10 @@ static int GetBitmapKey(RedisModuleCtx* ctx, RedisModuleString* keyName, Bitmap*
     INNER_ERROR(REDISMODULE_ERRORMSG_WRONGTYPE);
   }
   *value_out = RedisModule_ModuleTypeGetValue(key);
+  if (mode & REDISMODULE_WRITE) {
+    *value_out = ThawBitmap(key, *value_out);
+    cardinality_cache_begin_write(*value_out);
+  }
   RedisModule_CloseKey(key);
   return REDISMODULE_OK;
 }
@@ -94,25 +171,187 @@ static int TryGetBitmapKey(RedisModuleCtx* ctx, RedisModuleString* keyName, Bitm
   } else {
     *key_out = key;
     *value_out = RedisModule_ModuleTypeGetValue(key);
+    if (mode & REDISMODULE_WRITE) {
+      *value_out = ThawBitmap(key, *value_out);
+      cardinality_cache_begin_write(*value_out);
+    }
   }
 
   return REDISMODULE_OK;
 }
 
-void BitmapRdbSave(RedisModuleIO* rdb, void* value) {
-  Bitmap* bitmap = value;
-  size_t serialized_max_size = roaring_bitmap_size_in_bytes(bitmap);
-  char* serialized_bitmap = rm_malloc(serialized_max_size);
-  size_t serialized_size = roaring_bitmap_serialize(bitmap, serialized_bitmap);
+/**
+ * Cardinality of a bitmap stored in the keyspace, from the cardinality cache when it is up to date.
+ * Must not be called on temporary bitmaps, nor on a key opened for writing before a change to its cardinality.
+ */
+static uint64_t BitmapCardinality(const Bitmap* bitmap) {
+  if (bitmap == BITMAP_NILL) {
+    return 0;
+  }
+  uint64_t cardinality;
+  if (!cardinality_cache_get(bitmap, &cardinality)) {
+    cardinality = bitmap_get_cardinality(bitmap);
+    cardinality_cache_set(bitmap, cardinality);
+  }
+  return cardinality;
+}
+
+/**
+ * Heavy commands whose keys hold at least this many elements run on the worker pool and only block
+ * their own client. 0 runs everything inline. Only commands whose work outweighs snapshotting their
+ * keys on the main thread are offloaded: R.GETINTARRAY, and R.BITOP but for AND and ANDOR.
+ */
+uint64_t BitmapBackgroundThreshold = 0;
+
+static bool ShouldRunInBackground(RedisModuleCtx* ctx, uint64_t elements) {
+  if (BitmapBackgroundThreshold == 0 || elements < BitmapBackgroundThreshold || thread_pool_size() == 0) {
+    return false;
+  }
+
+  // Transactions, scripts, the replication stream and AOF loading cannot block
+  int flags = RedisModule_GetContextFlags(ctx);
+  int inline_flags = REDISMODULE_CTX_FLAGS_MULTI | REDISMODULE_CTX_FLAGS_LUA | REDISMODULE_CTX_FLAGS_REPLICATED
+      | REDISMODULE_CTX_FLAGS_LOADING | REDISMODULE_CTX_FLAGS_DENY_BLOCKING;
+  return (flags & inline_flags) == 0;
+}
+
+/**
+ * A command running on the worker pool. `bitmaps` are private snapshots of the keys taken on the
+ * main thread. Read commands reply through a thread safe context, write commands store `result`
+ * from the worker with the GIL held, so that it lands even when the client disconnects first.
+ */
+typedef struct {
+  RedisModuleBlockedClient* bc;
+  uint32_t n;
+  Bitmap** bitmaps;
+  Bitmap* result;
+  void (*operation)(Bitmap*, uint32_t, const Bitmap**);
+  RedisModuleString* key;
+  uint64_t cardinality;
+  const char* error;
+} BackgroundJob;
+
+static BackgroundJob* BackgroundJobCreate(uint32_t n) {
+  BackgroundJob* job = rm_calloc(1, sizeof(*job));
+  job->n = n;
+  job->bitmaps = rm_calloc(n, sizeof(*job->bitmaps));
+  return job;
+}
+
+static void BackgroundJobFree(RedisModuleCtx* ctx, void* privdata) {
+  BackgroundJob* job = privdata;
+  for (uint32_t i = 0; i < job->n; i++) {
+    if (job->bitmaps[i] != NULL) {
+      bitmap_free(job->bitmaps[i]);
+    }
+  }
+  if (job->result != NULL) {
+    bitmap_free(job->result);
+  }
+  if (job->key != NULL) {
+    RedisModule_FreeString(NULL, job->key);
+  }
+  rm_free(job->bitmaps);
+  rm_free(job);
+}
+
+static int RunInBackground(RedisModuleCtx* ctx, BackgroundJob* job, ThreadPoolTask task, RedisModuleCmdFunc reply_callback) {
+  job->bc = RedisModule_BlockClient(ctx, reply_callback, NULL, BackgroundJobFree, 0);
+  if (!thread_pool_submit(task, job)) {
+    RedisModule_AbortBlock(job->bc);
+    BackgroundJobFree(ctx, job);
+    INNER_ERROR("ERR Roaring: worker threads are not running");
+  }
+  return REDISMODULE_OK;
+}
+
+/**
+ * Finishes a read command whose reply was written from the worker.
+ */
+static void FinishBackgroundRead(RedisModuleCtx* thread_ctx, BackgroundJob* job) {
+  RedisModule_FreeThreadSafeContext(thread_ctx);
+  RedisModule_UnblockClient(job->bc, job);
+}
+
+static void BitmapRdbSaveChunk(RedisModuleIO* rdb, const Bitmap* chunk) {
+  size_t serialized_size;
+  char* serialized_bitmap = bitmap_serialize(chunk, &serialized_size);
   RedisModule_SaveStringBuffer(rdb, serialized_bitmap, serialized_size);
   rm_free(serialized_bitmap);
 }
 
+void BitmapRdbSave(RedisModuleIO* rdb, void* value) {
+  Bitmap* bitmap = value;
+  uint64_t chunk_count = bitmap_chunk_count(bitmap, BITMAP_RDB_CHUNK_CONTAINERS);
+  RedisModule_SaveUnsigned(rdb, chunk_count);
+
+  if (chunk_count == 1) {
+    BitmapRdbSaveChunk(rdb, bitmap);
+    return;
+  }
+
+  // Serialize one chunk at a time so the extra memory doesn't grow with the bitmap
+  roaring_uint32_iterator_t* iterator = roaring_iterator_create(bitmap);
+  for (uint64_t i = 0; i < chunk_count; i++) {
+    Bitmap* chunk = bitmap_next_chunk(bitmap, iterator, BITMAP_RDB_CHUNK_CONTAINERS);
+    BitmapRdbSaveChunk(rdb, chunk);
+    bitmap_free(chunk);
+  }
+  roaring_uint32_iterator_free(iterator);
+}
+
+static Bitmap* BitmapRdbLoadFrozen(RedisModuleIO* rdb) {
+  size_t size;
+  char* serialized_bitmap = RedisModule_LoadStringBuffer(rdb, &size);
+
+  // The loaded buffer becomes the backing store of the bitmap, see FrozenBitmaps
+  Bitmap* bitmap = FreezeBitmap(serialized_bitmap, size);
+  if (bitmap == NULL) {
+    RedisModule_LogIOError(rdb, "warning", "Can't load corrupted bitmap of %zu bytes", size);
+    rm_free(serialized_bitmap);
+  }
+  return bitmap;
+}
+
+static Bitmap* BitmapRdbLoadChunks(RedisModuleIO* rdb) {
+  uint64_t chunk_count = RedisModule_LoadUnsigned(rdb);
+  if (chunk_count == 1) {
+    return BitmapRdbLoadFrozen(rdb);
+  }
+
+  Bitmap* bitmap = bitmap_alloc();
+  for (uint64_t i = 0; i < chunk_count; i++) {
+    size_t size;
+    char* serialized_chunk = RedisModule_LoadStringBuffer(rdb, &size);
+    Bitmap* chunk = FrozenView(serialized_chunk, size);
+    if (chunk == NULL) {
+      RedisModule_LogIOError(rdb, "warning", "Can't load corrupted bitmap chunk of %zu bytes", size);
+      rm_free(serialized_chunk);
+      bitmap_free(bitmap);
+      return NULL;
+    }
+    // Chunks are disjoint and ordered, so this only appends copies of the chunk containers
+    roaring_bitmap_or_inplace(bitmap, chunk);
+    bitmap_free(chunk);
+    rm_free(serialized_chunk);
+  }
+  return bitmap;
+}
+
 void* BitmapRdbLoad(RedisModuleIO* rdb, int encver) {
-  if (encver != BITMAP_ENCODING_VERSION) {
+  if (encver < BITMAP_ENCODING_VERSION_NATIVE || encver > BITMAP_ENCODING_VERSION) {
     RedisModule_LogIOError(rdb, "warning", "Can't load data with version %d", encver);
     return NULL;
   }
+
+  if (encver == BITMAP_ENCODING_VERSION_PORTABLE) {
+    return BitmapRdbLoadFrozen(rdb);
+  }
+
+  if (encver == BITMAP_ENCODING_VERSION) {
+    return BitmapRdbLoadChunks(rdb);
+  }
+
   size_t size;
   char* serialized_bitmap = RedisModule_LoadStringBuffer(rdb, &size);
   Bitmap* bitmap = roaring_bitmap_deserialize(serialized_bitmap);
@@ -120,33 +359,176 @@ void* BitmapRdbLoad(RedisModuleIO* rdb, int encver) {
   return bitmap;
 }
 
-typedef struct Bitmap_aof_rewrite_callback_params_s {
-  RedisModuleIO* aof;
-  RedisModuleString* key;
-} Bitmap_aof_rewrite_callback_params;
+static void BitmapAofRewriteValues(RedisModuleIO* aof, RedisModuleString* key, const uint32_t* values, size_t n) {
+  if (n == 0) {
+    return;
+  }
 
-static bool BitmapAofRewriteCallback(uint32_t offset, void* param) {
-  Bitmap_aof_rewrite_callback_params* params = param;
-  RedisModule_EmitAOF(params->aof, "R.SETBIT", "sll", params->key, offset, 1);
-  return true;
+  RedisModuleString* args[BITMAP_AOF_BATCH_SIZE];
+  for (size_t i = 0; i < n; i++) {
+    args[i] = RedisModule_CreateStringFromLongLong(NULL, values[i]);
+  }
+  RedisModule_EmitAOF(aof, "R.APPENDINTARRAY", "sv", key, args, n);
+  for (size_t i = 0; i < n; i++) {
+    RedisModule_FreeString(NULL, args[i]);
+  }
 }
 
+/**
+ * Rewrites the bitmap as R.SETRANGE commands for runs of at least BITMAP_AOF_MIN_RANGE
+ * consecutive values and R.APPENDINTARRAY batches for everything else, so the AOF grows with
+ * the compressed size of the bitmap rather than with its cardinality.
+ */
 void BitmapAofRewrite(RedisModuleIO* aof, RedisModuleString* key, void* value) {
   Bitmap* bitmap = value;
-  Bitmap_aof_rewrite_callback_params params = {
-      .aof = aof,
-      .key = key
-  };
-  roaring_iterate(bitmap, BitmapAofRewriteCallback, &params);
+  uint32_t values[BITMAP_AOF_BATCH_SIZE];
+  size_t n = 0;
+
+  roaring_uint32_iterator_t* iterator = roaring_iterator_create(bitmap);
+  while (iterator->has_value) {
+    uint32_t start = iterator->current_value;
+    uint32_t last = bitmap_run_last(bitmap, start);
+
+    if ((uint64_t) last - start + 1 >= BITMAP_AOF_MIN_RANGE) {
+      // R.SETRANGE end is exclusive, so UINT32_MAX itself has to be appended
+      uint64_t end = (uint64_t) last + 1;
+      if (end > UINT32_MAX) {
+        end = UINT32_MAX;
+        values[n++] = UINT32_MAX;
+      }
+      RedisModule_EmitAOF(aof, "R.SETRANGE", "sll", key, (long long) start, (long long) end);
+    } else {
+      for (uint64_t v = start; v <= last; v++) {
+        values[n++] = (uint32_t) v;
+        if (n == BITMAP_AOF_BATCH_SIZE) {
+          BitmapAofRewriteValues(aof, key, values, n);
+          n = 0;
+        }
+      }
+    }
+
+    if (n == BITMAP_AOF_BATCH_SIZE) {
+      BitmapAofRewriteValues(aof, key, values, n);
+      n = 0;
+    }
+
+    if (last == UINT32_MAX || !roaring_uint32_iterator_move_equalorlarger(iterator, last + 1)) {
+      break;
+    }
+  }
+  roaring_uint32_iterator_free(iterator);
+
+  BitmapAofRewriteValues(aof, key, values, n);
+}
+
+OptimizerCompactResult BitmapBackgroundCompact(Bitmap* bitmap, uint64_t max_bytes, size_t* reclaimed) {
+  if (IsFrozenBitmap(bitmap) || cardinality_cache_is_compacted(bitmap)) {
+    return OPTIMIZER_COMPACT_SKIPPED;
+  }
+  size_t size = roaring_bitmap_size_in_bytes(bitmap);
+  if (size < BITMAP_COMPACT_MIN_BYTES) {
+    return OPTIMIZER_COMPACT_SKIPPED;
+  }
+  if (max_bytes != 0 && size > max_bytes) {
+    return OPTIMIZER_COMPACT_TOO_LARGE;
+  }
+  *reclaimed = bitmap_compact(bitmap);
+  cardinality_cache_set_compacted(bitmap);
+  return OPTIMIZER_COMPACT_DONE;
+}
+
+/**
+ * Heap bytes held by a bitmap, including the RDB buffer a frozen bitmap is a view of
+ */
+static size_t BitmapAllocatedSize(const Bitmap* bitmap, size_t sample_size) {
+  size_t size = bitmap_allocated_size(bitmap, sample_size);
+
+  char* buffer = FrozenBuffer(bitmap, false);
+  if (buffer != NULL) {
+    size += RedisModule_MallocSize(buffer);
+  }
+
+  return size;
 }
 
 size_t BitmapMemUsage(const void* value) {
+  return BitmapAllocatedSize(value, 0);
+}
+
+size_t BitmapMemUsage2(RedisModuleKeyOptCtx* ctx, const void* value, size_t sample_size) {
+  REDISMODULE_NOT_USED(ctx);
+  return BitmapAllocatedSize(value, sample_size);
+}
+
+/**
+ * Number of allocations released by BitmapFree, large bitmaps are then freed by the lazyfree thread
+ */
+size_t BitmapFreeEffort(RedisModuleString* key, const void* value) {
+  REDISMODULE_NOT_USED(key);
   const Bitmap* bitmap = value;
-  return roaring_bitmap_size_in_bytes(bitmap);
+  // A frozen bitmap is a single allocation over the RDB buffer
+  if (IsFrozenBitmap(bitmap)) {
+    return 2;
+  }
+  return (size_t) bitmap->high_low_container.size + 1;
+}
+
+static void* DefragRelocate(void* ptr, void* arg) {
+  return RedisModule_DefragAlloc(arg, ptr);
+}
+
+static bool DefragShouldStop(void* arg) {
+  return RedisModule_DefragShouldStop(arg);
+}
+
+/**
+ * Active defragmentation: moves the bitmap and its index on the first call, then its containers,
+ * resuming from the cursor when Redis interrupts the key. Frozen bitmaps are left in place, their
+ * containers are views over the RDB buffer.
+ */
+int BitmapDefrag(RedisModuleDefragCtx* ctx, RedisModuleString* key, void** value) {
+  REDISMODULE_NOT_USED(key);
+  Bitmap* bitmap = *value;
+  if (IsFrozenBitmap(bitmap)) {
+    return 0;
+  }
+
+  unsigned long cursor = 0;
+  RedisModule_DefragCursorGet(ctx, &cursor);
+
+  if (cursor == 0) {
+    Bitmap* moved = RedisModule_DefragAlloc(ctx, bitmap);
+    if (moved != NULL) {
+      cardinality_cache_move(bitmap, moved);
+      bitmap = moved;
+      *value = moved;
+    }
+  }
+
+  cursor = bitmap_relocate(bitmap, (uint32_t) cursor, DefragRelocate, DefragShouldStop, ctx);
+  if (cursor == 0) {
+    return 0;
+  }
+  RedisModule_DefragCursorSet(ctx, cursor);
+  return 1;
+}
+
+/**
+ * The key is gone from the keyspace, its value may still wait for the lazyfree thread
+ */
+void BitmapUnlink(RedisModuleString* key, const void* value) {
+  REDISMODULE_NOT_USED(key);
+  cardinality_cache_remove(value);
 }
 
 void BitmapFree(void* value) {
+  char* buffer = FrozenBuffer(value, true);
+
+  cardinality_cache_remove(value);
   bitmap_free(value);
+  if (buffer != NULL) {
+    rm_free(buffer);
+  }
 }
 
 /**
@@ -248,6 +630,7 @@ int RSetBitCommand(RedisModuleCtx* ctx, RedisModuleString** argv, int argc) {
 
   /* Set bit with value */
   bool old_value = bitmap_setbit(bitmap, offset, value);
+  cardinality_cache_adjust(bitmap, (int64_t) value - (int64_t) old_value);
   RedisModule_ReplicateVerbatim(ctx);
   return RedisModule_ReplyWithLongLong(ctx, old_value);
 }
@@ -280,8 +663,35 @@ int RGetBitCommand(RedisModuleCtx* ctx, RedisModuleString** argv, int argc) {
   return RedisModule_ReplyWithLongLong(ctx, value);
 }
 
+/**
+ * Replies to the PACKED form of R.GETBITS: `packed` holds little-endian uint32 offsets and the reply is
+ * a bit-vector string with one bit per offset, most significant bit first. A missing key answers all zeros.
+ * */
+static int GetBitsPackedReply(RedisModuleCtx* ctx, const Bitmap* bitmap, RedisModuleString* packed) {
+  size_t len;
+  const char* buffer = RedisModule_StringPtrLen(packed, &len);
+  if (len % sizeof(uint32_t) != 0) {
+    INNER_ERROR(ERRORMSG_WRONGARG("offsets", "length must be a multiple of 4 bytes"));
+  }
+
+  size_t n_offsets = len / sizeof(uint32_t);
+  if (n_offsets > UINT32_MAX) {
+    INNER_ERROR(ERRORMSG_WRONGARG("offsets", "too many offsets"));
+  }
+
+  size_t n_bytes = (n_offsets + 7) / 8;
+  unsigned char* bits = rm_malloc(n_bytes + 1);
+  bitmap_getbits_packed(bitmap, n_offsets, (const unsigned char*) buffer, bits);
+
+  RedisModule_ReplyWithStringBuffer(ctx, (const char*) bits, n_bytes);
+  rm_free(bits);
+
+  return REDISMODULE_OK;
+}
+
 /**
  * R.GETBITS <key> offset [offset1 offset2 ... offsetN]
+ * R.GETBITS <key> PACKED <offsets>
  * */
 int RGetBitManyCommand(RedisModuleCtx* ctx, RedisModuleString** argv, int argc) {
   if (argc < 3) {
@@ -296,6 +706,10 @@ int RGetBitManyCommand(RedisModuleCtx* ctx, RedisModuleString** argv, int argc)
     return REDISMODULE_ERR;
   }
 
+  if (argc == 4 && strcmp(RedisModule_StringPtrLen(argv[2], NULL), "PACKED") == 0) {
+    return GetBitsPackedReply(ctx, bitmap, argv[3]);
+  }
+
   if (bitmap == BITMAP_NILL) {
     return RedisModule_ReplyWithEmptyArray(ctx);
   }
@@ -369,14 +783,15 @@ int RClearBitsCommand(RedisModuleCtx* ctx, RedisModuleString** argv, int argc) {
 
   RedisModule_ReplicateVerbatim(ctx);
 
+  // Counting the removed bits costs the same as removing them and keeps the cardinality cache up to date
+  size_t count = bitmap_clearbits_count(bitmap, n_offsets, offsets);
+  cardinality_cache_adjust(bitmap, -(int64_t) count);
+  rm_free(offsets);
+
   if (count_mode) {
-    size_t count = bitmap_clearbits_count(bitmap, n_offsets, offsets);
-    rm_free(offsets);
     return RedisModule_ReplyWithLongLong(ctx, (long long) count);
   }
 
-  bitmap_clearbits(bitmap, n_offsets, offsets);
-  rm_free(offsets);
   return RedisModule_ReplyWithSimpleString(ctx, "OK");
 }
 
@@ -414,8 +829,51 @@ int ROptimizeBitCommand(RedisModuleCtx* ctx, RedisModuleString** argv, int argc)
 }
 
 
+/**
+ * Parses the values of SETINTARRAY and APPENDINTARRAY starting at argv[2], either decimal arguments
+ * or the packed form `PACKED [DELTA] [VARINT] <values>`. The packed buffer is decoded without going
+ * through per-value string parsing. Returns false after replying with an error.
+ * */
+static bool ParseIntArray(RedisModuleCtx* ctx, RedisModuleString** argv, int argc, uint32_t** values, size_t* n) {
+  if (argc < 4 || argc > 6 || strcmp(RedisModule_StringPtrLen(argv[2], NULL), "PACKED") != 0) {
+    *n = (size_t) (argc - 2);
+    *values = rm_malloc(sizeof(**values) * (*n));
+    for (size_t i = 0; i < *n; i++) {
+      if (!StrToUInt32(argv[2 + i], &(*values)[i])) {
+        rm_free(*values);
+        RedisModule_ReplyWithError(ctx, ERRORMSG_WRONGARG_UINT32("value"));
+        return false;
+      }
+    }
+    return true;
+  }
+
+  int encoding = BITMAP_INT_ENCODING_FIXED;
+  for (int i = 3; i < argc - 1; i++) {
+    const char* option = RedisModule_StringPtrLen(argv[i], NULL);
+    if (strcmp(option, "DELTA") == 0) {
+      encoding |= BITMAP_INT_ENCODING_DELTA;
+    } else if (strcmp(option, "VARINT") == 0) {
+      encoding |= BITMAP_INT_ENCODING_VARINT;
+    } else {
+      RedisModule_ReplyWithError(ctx, "ERR syntax error");
+      return false;
+    }
+  }
+
+  size_t len;
+  const char* buffer = RedisModule_StringPtrLen(argv[argc - 1], &len);
+  if (!bitmap_decode_int_array(len, (const unsigned char*) buffer, encoding, values, n)) {
+    RedisModule_ReplyWithError(ctx, ERRORMSG_WRONGARG("values", "malformed packed integer array"));
+    return false;
+  }
+
+  return true;
+}
+
 /**
  * R.SETINTARRAY <key> <value1> [<value2> <value3> ... <valueN>]
+ * R.SETINTARRAY <key> PACKED [DELTA] [VARINT] <values>
  * */
 int RSetIntArrayCommand(RedisModuleCtx* ctx, RedisModuleString** argv, int argc) {
   if (argc < 3) {
@@ -430,13 +888,10 @@ int RSetIntArrayCommand(RedisModuleCtx* ctx, RedisModuleString** argv, int argc)
     return REDISMODULE_ERR;
   }
 
-  size_t length = (size_t) (argc - 2);
-  uint32_t* values = rm_malloc(sizeof(*values) * length);
-  for (int i = 0; i < length; i++) {
-    if (!StrToUInt32(argv[2 + i], &values[i])) {
-      rm_free(values);
-      INNER_ERROR(ERRORMSG_WRONGARG_UINT32("value"));
-    }
+  size_t length;
+  uint32_t* values;
+  if (!ParseIntArray(ctx, argv, argc, &values, &length)) {
+    return REDISMODULE_ERR;
   }
 
   bitmap = bitmap_from_int_array(length, values);
@@ -494,6 +949,7 @@ int RDiffCommand(RedisModuleCtx* ctx, RedisModuleString** argv, int argc) {
 
 /**
  * R.APPENDINTARRAY <key> <value1> [<value2> <value3> ... <valueN>]
+ * R.APPENDINTARRAY <key> PACKED [DELTA] [VARINT] <values>
  * */
 int RAppendIntArrayCommand(RedisModuleCtx* ctx, RedisModuleString** argv, int argc) {
   if (argc < 3) {
@@ -508,13 +964,10 @@ int RAppendIntArrayCommand(RedisModuleCtx* ctx, RedisModuleString** argv, int ar
     return REDISMODULE_ERR;
   }
 
-  size_t length = (size_t) (argc - 2);
-  uint32_t* values = rm_malloc(sizeof(*values) * length);
-  for (int i = 0; i < length; i++) {
-    if (!StrToUInt32(argv[2 + i], &values[i])) {
-      rm_free(values);
-      INNER_ERROR(ERRORMSG_WRONGARG_UINT32("value"));
-    }
+  size_t length;
+  uint32_t* values;
+  if (!ParseIntArray(ctx, argv, argc, &values, &length)) {
+    return REDISMODULE_ERR;
   }
 
   if (bitmap == BITMAP_NILL) {
@@ -568,7 +1021,8 @@ int RDeleteIntArrayCommand(RedisModuleCtx* ctx, RedisModuleString** argv, int ar
     }
   }
 
-  roaring_bitmap_remove_many(bitmap, length, values);
+  size_t removed = bitmap_clearbits_count(bitmap, length, values);
+  cardinality_cache_adjust(bitmap, -(int64_t) removed);
   rm_free(values);
 
   RedisModule_ReplicateVerbatim(ctx);
@@ -635,10 +1089,10 @@ int RRangeIntArrayCommand(RedisModuleCtx* ctx, RedisModuleString** argv, int arg
 }
 
 /**
- * R.GETINTARRAY <key>
+ * R.SCAN <key> <cursor> [COUNT count]
  * */
-int RGetIntArrayCommand(RedisModuleCtx* ctx, RedisModuleString** argv, int argc) {
-  if (argc != 2) {
+int RScanCommand(RedisModuleCtx* ctx, RedisModuleString** argv, int argc) {
+  if (argc != 3 && argc != 5) {
     return RedisModule_WrongArity(ctx);
   }
 
@@ -650,30 +1104,55 @@ int RGetIntArrayCommand(RedisModuleCtx* ctx, RedisModuleString** argv, int argc)
     return REDISMODULE_ERR;
   }
 
+  uint32_t cursor;
+  ParseUint32OrReturn(ctx, argv[2], "cursor", cursor);
+
+  uint32_t count = BITMAP_SCAN_DEFAULT_COUNT;
+  if (argc == 5) {
+    const char* option = RedisModule_StringPtrLen(argv[3], NULL);
+    if (strcmp(option, "COUNT") != 0) {
+      return ReplyWithErrorFmt(ctx, "ERR invalid option argument: %s", option);
+    }
+
+    ParseUint32OrReturn(ctx, argv[4], "count", count);
+
+    if (count == 0) {
+      INNER_ERROR(ERRORMSG_WRONGARG("count", "must be greater than 0"));
+    }
+
+    if (count > BITMAP_MAX_RANGE_SIZE) {
+      return ReplyWithErrorFmt(ctx, ERRORMSG_RANGE_LIMIT, BITMAP_MAX_RANGE_SIZE);
+    }
+  }
+
+  RedisModule_ReplyWithArray(ctx, 2);
+
   if (bitmap == BITMAP_NILL) {
+    RedisModule_ReplyWithLongLong(ctx, 0);
     return RedisModule_ReplyWithEmptyArray(ctx);
   }
 
-  size_t n = 0;
-  uint32_t* array = bitmap_get_int_array(bitmap, &n);
+  size_t n;
+  bool has_more;
+  uint32_t* values = bitmap_scan(bitmap, cursor, count, &n, &has_more);
 
-  RedisModule_ReplyWithArray(ctx, n);
+  // The next cursor is the value after the last one returned, 0 once the scan is complete
+  RedisModule_ReplyWithLongLong(ctx, (long long) (has_more ? values[n - 1] + 1 : 0));
 
+  RedisModule_ReplyWithArray(ctx, (long) n);
   for (size_t i = 0; i < n; i++) {
-    RedisModule_ReplyWithLongLong(ctx, array[i]);
+    RedisModule_ReplyWithLongLong(ctx, (long long) values[i]);
   }
 
-  rm_free(array);
-
+  rm_free(values);
   return REDISMODULE_OK;
 }
 
-
 /**
- * R.SETBITARRAY <key> <value1>
+ * R.RANGEBYVALUE <key> <min> <max> [LIMIT offset count]
  * */
-int RSetBitArrayCommand(RedisModuleCtx* ctx, RedisModuleString** argv, int argc) {
-  if (argc != 3) {
+int RRangeByValueCommand(RedisModuleCtx* ctx, RedisModuleString** argv, int argc) {
+  if (argc != 4 && argc != 7) {
     return RedisModule_WrongArity(ctx);
   }
 
@@ -681,28 +1160,57 @@ int RSetBitArrayCommand(RedisModuleCtx* ctx, RedisModuleString** argv, int argc)
   RedisModuleKey* key;
   Bitmap* bitmap;
 
-  if (TryGetBitmapKey(ctx, argv[1], &bitmap, &key, REDISMODULE_READ | REDISMODULE_WRITE) == REDISMODULE_ERR) {
+  if (TryGetBitmapKey(ctx, argv[1], &bitmap, &key, REDISMODULE_READ) == REDISMODULE_ERR) {
     return REDISMODULE_ERR;
   }
 
-  size_t len;
-  const char* array = RedisModule_StringPtrLen(argv[2], &len);
-  bitmap = bitmap_from_bit_array(len, array);
+  uint32_t min;
+  ParseUint32OrReturn(ctx, argv[2], "min", min);
 
-  if (RedisModule_ModuleTypeSetValue(key, BitmapType, bitmap) != REDISMODULE_OK) {
-    RedisModule_CloseKey(key);
-    INNER_ERROR(ERRORMSG_SET_VALUE);
+  uint32_t max;
+  ParseUint32OrReturn(ctx, argv[3], "max", max);
+
+  uint64_t offset = 0;
+  uint64_t count = UINT64_MAX;
+  if (argc == 7) {
+    const char* option = RedisModule_StringPtrLen(argv[4], NULL);
+    if (strcmp(option, "LIMIT") != 0) {
+      return ReplyWithErrorFmt(ctx, "ERR invalid option argument: %s", option);
+    }
+
+    ParseUint64OrReturn(ctx, argv[5], "offset", offset);
+    ParseUint64OrReturn(ctx, argv[6], "count", count);
   }
 
-  RedisModule_ReplicateVerbatim(ctx);
-  return RedisModule_ReplyWithSimpleString(ctx, "OK");
+  if (bitmap == BITMAP_NILL || min > max || count == 0) {
+    return RedisModule_ReplyWithEmptyArray(ctx);
+  }
+
+  // Without a small enough LIMIT the whole window is returned, refuse windows too large to reply
+  if (count > BITMAP_MAX_RANGE_SIZE) {
+    uint64_t available = bitmap_range_cardinality(bitmap, min, max);
+    if (available > offset && available - offset > BITMAP_MAX_RANGE_SIZE) {
+      return ReplyWithErrorFmt(ctx, ERRORMSG_RANGE_LIMIT, BITMAP_MAX_RANGE_SIZE);
+    }
+  }
+
+  size_t n;
+  uint32_t* values = bitmap_range_by_value(bitmap, min, max, offset, count, &n);
+
+  RedisModule_ReplyWithArray(ctx, (long) n);
+  for (size_t i = 0; i < n; i++) {
+    RedisModule_ReplyWithLongLong(ctx, (long long) values[i]);
+  }
+
+  rm_free(values);
+  return REDISMODULE_OK;
 }
 
 /**
- * R.GETBITARRAY <key>
+ * R.COUNTRANGE <key> <min> <max>
  * */
-int RGetBitArrayCommand(RedisModuleCtx* ctx, RedisModuleString** argv, int argc) {
-  if (argc != 2) {
+int RCountRangeCommand(RedisModuleCtx* ctx, RedisModuleString** argv, int argc) {
+  if (argc != 4) {
     return RedisModule_WrongArity(ctx);
   }
 
@@ -714,30 +1222,442 @@ int RGetBitArrayCommand(RedisModuleCtx* ctx, RedisModuleString** argv, int argc)
     return REDISMODULE_ERR;
   }
 
-  if (bitmap == BITMAP_NILL) {
-    return RedisModule_ReplyWithSimpleString(ctx, "");
-  }
+  uint32_t min;
+  ParseUint32OrReturn(ctx, argv[2], "min", min);
 
-  size_t size;
-  char* array = bitmap_get_bit_array(bitmap, &size);
-  RedisModule_ReplyWithStringBuffer(ctx, array, size);
+  uint32_t max;
+  ParseUint32OrReturn(ctx, argv[3], "max", max);
 
-  bitmap_free_bit_array(array);
+  if (bitmap == BITMAP_NILL || min > max) {
+    return RedisModule_ReplyWithLongLong(ctx, 0);
+  }
 
-  return REDISMODULE_OK;
+  return RedisModule_ReplyWithLongLong(ctx, (long long) bitmap_range_cardinality(bitmap, min, max));
 }
 
 /**
- * R.BITOP <op> <key> <keys...>
+ * R.RANK <key> <value> [value ...]
  * */
-int RBitOp(RedisModuleCtx* ctx, RedisModuleString** argv, int argc, void (*operation)(Bitmap*, uint32_t, const Bitmap**)) {
-  if (argc < 5) {
+int RRankCommand(RedisModuleCtx* ctx, RedisModuleString** argv, int argc) {
+  if (argc < 3) {
     return RedisModule_WrongArity(ctx);
   }
 
-  uint32_t num_sources = ((uint32_t) (argc - 2));
+  RedisModule_AutoMemory(ctx);
+  RedisModuleKey* key;
+  Bitmap* bitmap;
 
-  // Allocate arrays
+  if (TryGetBitmapKey(ctx, argv[1], &bitmap, &key, REDISMODULE_READ) == REDISMODULE_ERR) {
+    return REDISMODULE_ERR;
+  }
+
+  size_t n_values = (size_t) (argc - 2);
+  uint32_t* values = rm_malloc(sizeof(*values) * n_values);
+
+  for (size_t i = 0; i < n_values; i++) {
+    if (!StrToUInt32(argv[2 + i], &values[i])) {
+      rm_free(values);
+      INNER_ERROR(ERRORMSG_WRONGARG_UINT32("value"));
+    }
+  }
+
+  // Always an array, even for a single value, so the reply shape doesn't depend on the arguments
+  RedisModule_ReplyWithArray(ctx, (long) n_values);
+
+  for (size_t i = 0; i < n_values; i++) {
+    uint64_t rank = bitmap == BITMAP_NILL ? 0 : bitmap_rank(bitmap, values[i]);
+    RedisModule_ReplyWithLongLong(ctx, (long long) rank);
+  }
+
+  rm_free(values);
+  return REDISMODULE_OK;
+}
+
+/**
+ * R.SELECT <key> <n> [n ...]
+ * */
+int RSelectCommand(RedisModuleCtx* ctx, RedisModuleString** argv, int argc) {
+  if (argc < 3) {
+    return RedisModule_WrongArity(ctx);
+  }
+
+  RedisModule_AutoMemory(ctx);
+  RedisModuleKey* key;
+  Bitmap* bitmap;
+
+  if (TryGetBitmapKey(ctx, argv[1], &bitmap, &key, REDISMODULE_READ) == REDISMODULE_ERR) {
+    return REDISMODULE_ERR;
+  }
+
+  size_t n_ranks = (size_t) (argc - 2);
+  uint64_t* ranks = rm_malloc(sizeof(*ranks) * n_ranks);
+
+  for (size_t i = 0; i < n_ranks; i++) {
+    if (!StrToUInt64(argv[2 + i], &ranks[i])) {
+      rm_free(ranks);
+      INNER_ERROR(ERRORMSG_WRONGARG_UINT64("n"));
+    }
+  }
+
+  RedisModule_ReplyWithArray(ctx, (long) n_ranks);
+
+  for (size_t i = 0; i < n_ranks; i++) {
+    // n is 1-based, -1 when the bitmap has fewer than n elements
+    int64_t element = bitmap == BITMAP_NILL ? -1 : bitmap_get_nth_element_present(bitmap, ranks[i]);
+    RedisModule_ReplyWithLongLong(ctx, element);
+  }
+
+  rm_free(ranks);
+  return REDISMODULE_OK;
+}
+
+static void RGetIntArrayBackground(void* arg) {
+  BackgroundJob* job = arg;
+  RedisModuleCtx* ctx = RedisModule_GetThreadSafeContext(job->bc);
+
+  size_t n = 0;
+  uint32_t* array = bitmap_get_int_array(job->bitmaps[0], &n);
+
+  RedisModule_ReplyWithArray(ctx, n);
+
+  for (size_t i = 0; i < n; i++) {
+    RedisModule_ReplyWithLongLong(ctx, array[i]);
+  }
+
+  rm_free(array);
+  FinishBackgroundRead(ctx, job);
+}
+
+/**
+ * R.GETINTARRAY <key>
+ * */
+int RGetIntArrayCommand(RedisModuleCtx* ctx, RedisModuleString** argv, int argc) {
+  if (argc != 2) {
+    return RedisModule_WrongArity(ctx);
+  }
+
+  RedisModule_AutoMemory(ctx);
+  RedisModuleKey* key;
+  Bitmap* bitmap;
+
+  if (TryGetBitmapKey(ctx, argv[1], &bitmap, &key, REDISMODULE_READ) == REDISMODULE_ERR) {
+    return REDISMODULE_ERR;
+  }
+
+  if (bitmap == BITMAP_NILL) {
+    return RedisModule_ReplyWithEmptyArray(ctx);
+  }
+
+  if (ShouldRunInBackground(ctx, BitmapCardinality(bitmap))) {
+    BackgroundJob* job = BackgroundJobCreate(1);
+    job->bitmaps[0] = roaring_bitmap_copy(bitmap);
+    return RunInBackground(ctx, job, RGetIntArrayBackground, NULL);
+  }
+
+  size_t n = 0;
+  uint32_t* array = bitmap_get_int_array(bitmap, &n);
+
+  RedisModule_ReplyWithArray(ctx, n);
+
+  for (size_t i = 0; i < n; i++) {
+    RedisModule_ReplyWithLongLong(ctx, array[i]);
+  }
+
+  rm_free(array);
+
+  return REDISMODULE_OK;
+}
+
+
+/**
+ * R.SETBITARRAY <key> <value1>
+ * */
+int RSetBitArrayCommand(RedisModuleCtx* ctx, RedisModuleString** argv, int argc) {
+  if (argc != 3) {
+    return RedisModule_WrongArity(ctx);
+  }
+
+  RedisModule_AutoMemory(ctx);
+  RedisModuleKey* key;
+  Bitmap* bitmap;
+
+  if (TryGetBitmapKey(ctx, argv[1], &bitmap, &key, REDISMODULE_READ | REDISMODULE_WRITE) == REDISMODULE_ERR) {
+    return REDISMODULE_ERR;
+  }
+
+  size_t len;
+  const char* array = RedisModule_StringPtrLen(argv[2], &len);
+  bitmap = bitmap_from_bit_array(len, array);
+
+  if (RedisModule_ModuleTypeSetValue(key, BitmapType, bitmap) != REDISMODULE_OK) {
+    RedisModule_CloseKey(key);
+    INNER_ERROR(ERRORMSG_SET_VALUE);
+  }
+
+  RedisModule_ReplicateVerbatim(ctx);
+  return RedisModule_ReplyWithSimpleString(ctx, "OK");
+}
+
+/**
+ * R.GETBITARRAY <key>
+ * */
+int RGetBitArrayCommand(RedisModuleCtx* ctx, RedisModuleString** argv, int argc) {
+  if (argc != 2) {
+    return RedisModule_WrongArity(ctx);
+  }
+
+  RedisModule_AutoMemory(ctx);
+  RedisModuleKey* key;
+  Bitmap* bitmap;
+
+  if (TryGetBitmapKey(ctx, argv[1], &bitmap, &key, REDISMODULE_READ) == REDISMODULE_ERR) {
+    return REDISMODULE_ERR;
+  }
+
+  if (bitmap == BITMAP_NILL) {
+    return RedisModule_ReplyWithSimpleString(ctx, "");
+  }
+
+  size_t size;
+  char* array = bitmap_get_bit_array(bitmap, &size);
+  RedisModule_ReplyWithStringBuffer(ctx, array, size);
+
+  bitmap_free_bit_array(array);
+
+  return REDISMODULE_OK;
+}
+
+/**
+ * R.GETSERIALIZED <key>
+ * */
+int RGetSerializedCommand(RedisModuleCtx* ctx, RedisModuleString** argv, int argc) {
+  if (argc != 2) {
+    return RedisModule_WrongArity(ctx);
+  }
+
+  RedisModule_AutoMemory(ctx);
+  RedisModuleKey* key;
+  Bitmap* bitmap;
+
+  if (TryGetBitmapKey(ctx, argv[1], &bitmap, &key, REDISMODULE_READ) == REDISMODULE_ERR) {
+    return REDISMODULE_ERR;
+  }
+
+  if (bitmap == BITMAP_NILL) {
+    return RedisModule_ReplyWithNull(ctx);
+  }
+
+  size_t size;
+  char* serialized = bitmap_serialize(bitmap, &size);
+  RedisModule_ReplyWithStringBuffer(ctx, serialized, size);
+  rm_free(serialized);
+
+  return REDISMODULE_OK;
+}
+
+/**
+ * R.SETSERIALIZED <key> <serialized>
+ * */
+int RSetSerializedCommand(RedisModuleCtx* ctx, RedisModuleString** argv, int argc) {
+  if (argc != 3) {
+    return RedisModule_WrongArity(ctx);
+  }
+
+  RedisModule_AutoMemory(ctx);
+  RedisModuleKey* key;
+  Bitmap* bitmap;
+
+  if (TryGetBitmapKey(ctx, argv[1], &bitmap, &key, REDISMODULE_READ | REDISMODULE_WRITE) == REDISMODULE_ERR) {
+    return REDISMODULE_ERR;
+  }
+
+  // Deserialize before touching the key, so an invalid blob leaves it unchanged
+  size_t len;
+  const char* serialized = RedisModule_StringPtrLen(argv[2], &len);
+  bitmap = bitmap_deserialize(serialized, len);
+  if (bitmap == NULL) {
+    INNER_ERROR(ERRORMSG_WRONGARG("serialized", "must be a valid portable roaring bitmap"));
+  }
+
+  if (RedisModule_ModuleTypeSetValue(key, BitmapType, bitmap) != REDISMODULE_OK) {
+    bitmap_free(bitmap);
+    INNER_ERROR(ERRORMSG_SET_VALUE);
+  }
+
+  RedisModule_ReplicateVerbatim(ctx);
+  return RedisModule_ReplyWithSimpleString(ctx, "OK");
+}
+
+typedef void (*BitOpOperation)(Bitmap*, uint32_t, const Bitmap**);
+
+typedef struct {
+  BitOpOperation operation;
+  uint32_t n;
+  const Bitmap** sources;
+  uint16_t first_key;
+  uint16_t last_key;
+  Bitmap* result;
+} BitOpPartition;
+
+/**
+ * Runs the operation over the containers of the sources in [first_key, last_key].
+ * Every BITOP operation is evaluated value by value, so the partial results of disjoint key ranges
+ * are disjoint slices of the full result.
+ */
+static void BitOpPartitionRun(void* arg) {
+  BitOpPartition* partition = arg;
+
+  Bitmap* views = rm_malloc(partition->n * sizeof(*views));
+  const Bitmap** view_ptrs = rm_malloc(partition->n * sizeof(*view_ptrs));
+  for (uint32_t i = 0; i < partition->n; i++) {
+    bitmap_container_range_view(partition->sources[i], partition->first_key, partition->last_key, &views[i]);
+    view_ptrs[i] = &views[i];
+  }
+
+  partition->result = bitmap_alloc();
+  partition->operation(partition->result, partition->n, view_ptrs);
+
+  rm_free(view_ptrs);
+  rm_free(views);
+}
+
+/**
+ * Computes `operation` into `r`, splitting it by container key over the worker pool when the
+ * sources are large enough. `r` must not be one of the sources.
+ */
+static void BitOpRun(Bitmap* r, uint32_t n, const Bitmap** sources, BitOpOperation operation) {
+  uint32_t max_parts = thread_pool_size() * BITMAP_BITOP_PARTITIONS_PER_THREAD;
+  if (max_parts == 0 || n < 2) {
+    operation(r, n, sources);
+    return;
+  }
+
+  uint16_t* first_keys = rm_malloc(max_parts * sizeof(*first_keys));
+  uint32_t n_parts = bitmap_partition_keys(n, sources, max_parts, BITMAP_BITOP_PARALLEL_MIN_CONTAINERS, first_keys);
+  if (n_parts <= 1) {
+    rm_free(first_keys);
+    operation(r, n, sources);
+    return;
+  }
+
+  BitOpPartition* partitions = rm_malloc(n_parts * sizeof(*partitions));
+  void** args = rm_malloc(n_parts * sizeof(*args));
+  for (uint32_t i = 0; i < n_parts; i++) {
+    partitions[i] = (BitOpPartition) {
+        .operation = operation,
+        .n = n,
+        .sources = sources,
+        .first_key = first_keys[i],
+        .last_key = i + 1 < n_parts ? first_keys[i + 1] - 1 : UINT16_MAX,
+        .result = NULL
+    };
+    args[i] = &partitions[i];
+  }
+
+  thread_pool_run(BitOpPartitionRun, args, n_parts);
+
+  // Partial results hold increasing, disjoint keys: merging them only appends containers
+  roaring_bitmap_clear(r);
+  for (uint32_t i = 0; i < n_parts; i++) {
+    roaring_bitmap_or_inplace(r, partitions[i].result);
+    bitmap_free(partitions[i].result);
+  }
+
+  rm_free(args);
+  rm_free(partitions);
+  rm_free(first_keys);
+}
+
+/**
+ * Replicates `result` as R.SETSERIALIZED, followed by the TTL of `key` which R.SETSERIALIZED clears
+ * on replicas.
+ */
+static void ReplicateBitOpResult(RedisModuleCtx* ctx, RedisModuleString* key, const Bitmap* result, mstime_t expire) {
+  size_t size;
+  char* serialized = bitmap_serialize(result, &size);
+  RedisModule_Replicate(ctx, "R.SETSERIALIZED", "sb", key, serialized, size);
+  rm_free(serialized);
+  if (expire != REDISMODULE_NO_EXPIRE) {
+    RedisModule_Replicate(ctx, "PEXPIREAT", "sl", key, (long long) expire);
+  }
+}
+
+/**
+ * Stores the result computed from the snapshots, with the GIL held. The sources may have changed
+ * since, so the result itself is replicated rather than the command. An existing destination keeps
+ * its TTL, like the inline R.BITOP which writes into it. Its previous value is returned in `old`, to
+ * be freed once the GIL is released.
+ */
+static bool RBitOpStore(RedisModuleCtx* ctx, BackgroundJob* job, void** old) {
+  RedisModuleKey* key = RedisModule_OpenKey(ctx, job->key, REDISMODULE_READ | REDISMODULE_WRITE);
+  bool exists = RedisModule_KeyType(key) != REDISMODULE_KEYTYPE_EMPTY;
+  if (exists && RedisModule_ModuleTypeGetType(key) != BitmapType) {
+    RedisModule_CloseKey(key);
+    job->error = REDISMODULE_ERRORMSG_WRONGTYPE;
+    return false;
+  }
+
+  mstime_t expire = REDISMODULE_NO_EXPIRE;
+  if (exists) {
+    RedisModule_ModuleTypeReplaceValue(key, BitmapType, job->result, old);
+    expire = RedisModule_GetAbsExpire(key);
+  } else if (RedisModule_ModuleTypeSetValue(key, BitmapType, job->result) != REDISMODULE_OK) {
+    RedisModule_CloseKey(key);
+    job->error = ERRORMSG_SET_VALUE;
+    return false;
+  }
+  RedisModule_CloseKey(key);
+
+  ReplicateBitOpResult(ctx, job->key, job->result, expire);
+  return true;
+}
+
+/**
+ * Computes and stores the result from the worker rather than from the reply callback, which is
+ * skipped when the client disconnects first: the write must happen once the command was accepted.
+ */
+static void RBitOpBackground(void* arg) {
+  BackgroundJob* job = arg;
+  job->result = bitmap_alloc();
+  BitOpRun(job->result, job->n, (const Bitmap**) job->bitmaps, job->operation);
+  job->cardinality = bitmap_get_cardinality(job->result);
+
+  void* old = NULL;
+  RedisModuleCtx* ctx = RedisModule_GetThreadSafeContext(job->bc);
+  RedisModule_ThreadSafeContextLock(ctx);
+  if (RBitOpStore(ctx, job, &old)) {
+    // Owned by the keyspace now
+    job->result = NULL;
+  }
+  RedisModule_ThreadSafeContextUnlock(ctx);
+  RedisModule_FreeThreadSafeContext(ctx);
+
+  // The previous value may be as large as the result, free it here rather than on the main thread
+  if (old != NULL) {
+    BitmapFree(old);
+  }
+  RedisModule_UnblockClient(job->bc, job);
+}
+
+static int RBitOpReply(RedisModuleCtx* ctx, RedisModuleString** argv, int argc) {
+  BackgroundJob* job = RedisModule_GetBlockedClientPrivateData(ctx);
+  if (job->error != NULL) {
+    return RedisModule_ReplyWithError(ctx, job->error);
+  }
+  return ReplyWithUint64(ctx, job->cardinality);
+}
+
+/**
+ * R.BITOP <op> <key> <keys...>
+ * */
+int RBitOp(RedisModuleCtx* ctx, RedisModuleString** argv, int argc, void (*operation)(Bitmap*, uint32_t, const Bitmap**)) {
+  if (argc < 5) {
+    return RedisModule_WrongArity(ctx);
+  }
+
+  uint32_t num_sources = ((uint32_t) (argc - 2));
+
+  // Allocate arrays
   Bitmap** bitmaps = rm_malloc(num_sources * sizeof(*bitmaps));
   RedisModuleKey** srckeys = rm_malloc(num_sources * sizeof(RedisModuleKey*));
 
@@ -784,18 +1704,63 @@ int RBitOp(RedisModuleCtx* ctx, RedisModuleString** argv, int argc, void (*opera
     }
   }
 
+  uint64_t elements = 0;
+  for (uint32_t i = 1; i < num_sources; i++) {
+    // The destination is not cached while it is open for writing
+    elements += bitmaps[i] == dest_copy ? bitmap_get_cardinality(dest_copy) : BitmapCardinality(bitmaps[i]);
+  }
+
+  // Snapshotting copies every source on the main thread, which costs about as much as AND and ANDOR
+  // whose results are at most the size of a source
+  bool offload = operation != bitmap_and && operation != bitmap_andor;
+  if (offload && ShouldRunInBackground(ctx, elements)) {
+    BackgroundJob* job = BackgroundJobCreate(num_sources - 1);
+    for (uint32_t i = 1; i < num_sources; i++) {
+      job->bitmaps[i - 1] = roaring_bitmap_copy(bitmaps[i]);
+    }
+    job->operation = operation;
+    job->key = RedisModule_HoldString(NULL, argv[2]);
+
+    if (dest_allocated) {
+      bitmap_free(bitmaps[0]);
+    }
+    if (dest_copy != BITMAP_NILL) {
+      bitmap_free(dest_copy);
+    }
+    rm_free(bitmaps);
+    rm_free(srckeys);
+
+    return RunInBackground(ctx, job, RBitOpBackground, RBitOpReply);
+  }
+
+  // Replicas recompute small operations, large ones may be cheaper to replicate by result.
+  // Sizing the sources is only worth it when the command is propagated at all
+  size_t source_size = 0;
+  if (ReplicationStreamActive(ctx)) {
+    for (uint32_t i = 1; i < num_sources; i++) {
+      source_size += roaring_bitmap_portable_size_in_bytes(bitmaps[i]);
+    }
+  }
+
   // Perform the bitmap operation
-  operation(bitmaps[0], num_sources - 1, (const Bitmap**) (bitmaps + 1));
+  BitOpRun(bitmaps[0], num_sources - 1, (const Bitmap**) (bitmaps + 1), operation);
 
   // Update destination key
   if (dest_allocated) {
     RedisModule_ModuleTypeSetValue(srckeys[0], BitmapType, bitmaps[0]);
   }
 
-  RedisModule_ReplicateVerbatim(ctx);
+  // Sizing the result only walks its container headers
+  if (source_size >= BITMAP_BITOP_REPLICATE_RESULT_MIN_BYTES
+      && roaring_bitmap_portable_size_in_bytes(bitmaps[0]) < source_size) {
+    mstime_t expire = dest_allocated ? REDISMODULE_NO_EXPIRE : RedisModule_GetAbsExpire(srckeys[0]);
+    ReplicateBitOpResult(ctx, argv[2], bitmaps[0], expire);
+  } else {
+    RedisModule_ReplicateVerbatim(ctx);
+  }
 
   // Reply with cardinality
-  uint64_t cardinality = bitmap_get_cardinality(bitmaps[0]);
+  uint64_t cardinality = BitmapCardinality(bitmaps[0]);
   ReplyWithUint64(ctx, cardinality);
 
   // Cleanup
@@ -853,7 +1818,7 @@ int RBitFlip(RedisModuleCtx* ctx, RedisModuleString** argv, int argc) {
 
   // Integer reply: The size of the string stored in the destination key
   // (adapted to cardinality)
-  uint64_t cardinality = bitmap_get_cardinality(result);
+  uint64_t cardinality = BitmapCardinality(result);
   return ReplyWithUint64(ctx, cardinality);
 }
 
@@ -905,6 +1870,169 @@ int RBitOpCommand(RedisModuleCtx* ctx, RedisModuleString** argv, int argc) {
   return REDISMODULE_OK;
 }
 
+/**
+ * Maps a variadic BITOP operation name to its BITMAP_OPERATION_* value, NOT is not included
+ */
+static bool ParseBitOpOperation(const char* name, int* operation) {
+  if (strcmp(name, "AND") == 0) {
+    *operation = BITMAP_OPERATION_AND;
+  } else if (strcmp(name, "OR") == 0) {
+    *operation = BITMAP_OPERATION_OR;
+  } else if (strcmp(name, "XOR") == 0) {
+    *operation = BITMAP_OPERATION_XOR;
+  } else if (strcmp(name, "ANDOR") == 0) {
+    *operation = BITMAP_OPERATION_ANDOR;
+  } else if (strcmp(name, "ONE") == 0) {
+    *operation = BITMAP_OPERATION_ONE;
+  } else if (strcmp(name, "DIFF") == 0) {
+    *operation = BITMAP_OPERATION_ANDNOT;
+  } else if (strcmp(name, "DIFF1") == 0) {
+    *operation = BITMAP_OPERATION_ORNOT;
+  } else {
+    return false;
+  }
+
+  return true;
+}
+
+/**
+ * R.BITOPCARD <operation> <key> <key> [<key> ...]
+ * Cardinality of `R.BITOP <operation>` over the given keys, without storing the result
+ * */
+int RBitOpCardCommand(RedisModuleCtx* ctx, RedisModuleString** argv, int argc) {
+  if (argc < 4) {
+    return (RedisModule_IsKeysPositionRequest(ctx) > 0) ? REDISMODULE_OK : RedisModule_WrongArity(ctx);
+  }
+
+  RedisModule_AutoMemory(ctx);
+  size_t len;
+  const char* name = RedisModule_StringPtrLen(argv[1], &len);
+
+  if (RedisModule_IsKeysPositionRequest(ctx) > 0) {
+    BitOpReadForEachKeyPosition(name, argc, ctx, BitOpReportRedisKey);
+    return REDISMODULE_OK;
+  }
+
+  int operation;
+  if (!ParseBitOpOperation(name, &operation)) {
+    RedisModule_ReplyWithError(ctx, "ERR syntax error");
+    return REDISMODULE_ERR;
+  }
+
+  uint32_t n = (uint32_t) (argc - 2);
+  const Bitmap** bitmaps = rm_malloc(n * sizeof(*bitmaps));
+
+  for (uint32_t i = 0; i < n; i++) {
+    Bitmap* bitmap;
+    RedisModuleKey* key;
+    if (TryGetBitmapKey(ctx, argv[2 + i], &bitmap, &key, REDISMODULE_READ) == REDISMODULE_ERR) {
+      rm_free(bitmaps);
+      return REDISMODULE_ERR;
+    }
+    bitmaps[i] = bitmap;
+  }
+
+  uint64_t cardinality = bitmap_operation_cardinality(operation, n, bitmaps);
+  rm_free(bitmaps);
+
+  return ReplyWithUint64(ctx, cardinality);
+}
+
+static const BitOpOperation BITOP_OPERATIONS[] = {
+    [BITMAP_OPERATION_AND] = bitmap_and,
+    [BITMAP_OPERATION_OR] = bitmap_or,
+    [BITMAP_OPERATION_XOR] = bitmap_xor,
+    [BITMAP_OPERATION_ANDOR] = bitmap_andor,
+    [BITMAP_OPERATION_ONE] = bitmap_one,
+    [BITMAP_OPERATION_ANDNOT] = bitmap_andnot,
+    [BITMAP_OPERATION_ORNOT] = bitmap_ornot,
+};
+
+typedef struct {
+  RedisModuleCtx* ctx;
+  uint64_t remaining;
+} BitOpGetReplyState;
+
+static bool BitOpGetReplyValue(uint32_t value, void* param) {
+  BitOpGetReplyState* state = param;
+  RedisModule_ReplyWithLongLong(state->ctx, (long long) value);
+  return --state->remaining > 0;
+}
+
+/**
+ * R.BITOPGET <operation> <key> <key> [<key> ...] [LIMIT <count>]
+ * Replies with the members of `R.BITOP <operation>` over the given keys, the result is only
+ * built in scratch memory: no key is written and nothing is replicated
+ * */
+int RBitOpGetCommand(RedisModuleCtx* ctx, RedisModuleString** argv, int argc) {
+  if (argc < 4) {
+    return (RedisModule_IsKeysPositionRequest(ctx) > 0) ? REDISMODULE_OK : RedisModule_WrongArity(ctx);
+  }
+
+  RedisModule_AutoMemory(ctx);
+  size_t len;
+  const char* name = RedisModule_StringPtrLen(argv[1], &len);
+  int keys_end = BitOpGetKeysEnd(argc, RedisModule_StringPtrLen(argv[argc - 2], NULL));
+
+  if (RedisModule_IsKeysPositionRequest(ctx) > 0) {
+    BitOpReadForEachKeyPosition(name, keys_end, ctx, BitOpReportRedisKey);
+    return REDISMODULE_OK;
+  }
+
+  int operation;
+  if (!ParseBitOpOperation(name, &operation)) {
+    RedisModule_ReplyWithError(ctx, "ERR syntax error");
+    return REDISMODULE_ERR;
+  }
+
+  // `LIMIT <count>` after a single key
+  if (keys_end < 4) {
+    RedisModule_ReplyWithError(ctx, "ERR syntax error");
+    return REDISMODULE_ERR;
+  }
+
+  uint64_t limit = UINT64_MAX;
+  if (keys_end < argc) {
+    ParseUint64OrReturn(ctx, argv[argc - 1], "limit", limit);
+  }
+
+  uint32_t n = (uint32_t) (keys_end - 2);
+  const Bitmap** bitmaps = rm_malloc(n * sizeof(*bitmaps));
+
+  for (uint32_t i = 0; i < n; i++) {
+    Bitmap* bitmap;
+    RedisModuleKey* key;
+    if (TryGetBitmapKey(ctx, argv[2 + i], &bitmap, &key, REDISMODULE_READ) == REDISMODULE_ERR) {
+      rm_free(bitmaps);
+      return REDISMODULE_ERR;
+    }
+    bitmaps[i] = bitmap;
+  }
+
+  Bitmap* result = bitmap_alloc();
+  BitOpRun(result, n, bitmaps, BITOP_OPERATIONS[operation]);
+  rm_free(bitmaps);
+
+  uint64_t count = bitmap_get_cardinality(result);
+  if (count > limit) {
+    count = limit;
+  }
+
+  if (count > BITMAP_MAX_RANGE_SIZE) {
+    bitmap_free(result);
+    return ReplyWithErrorFmt(ctx, ERRORMSG_RANGE_LIMIT, BITMAP_MAX_RANGE_SIZE);
+  }
+
+  RedisModule_ReplyWithArray(ctx, (long) count);
+  if (count > 0) {
+    BitOpGetReplyState state = {.ctx = ctx, .remaining = count};
+    roaring_iterate(result, BitOpGetReplyValue, &state);
+  }
+
+  bitmap_free(result);
+  return REDISMODULE_OK;
+}
+
 /**
  * R.BITCOUNT <key>
  * */
@@ -921,13 +2049,7 @@ int RBitCountCommand(RedisModuleCtx* ctx, RedisModuleString** argv, int argc) {
     return REDISMODULE_ERR;
   }
 
-  if (bitmap == BITMAP_NILL) {
-    return ReplyWithUint64(ctx, 0);
-  }
-
-  uint64_t count = bitmap_get_cardinality(bitmap);
-
-  return ReplyWithUint64(ctx, count);
+  return ReplyWithUint64(ctx, BitmapCardinality(bitmap));
 }
 
 
@@ -1039,6 +2161,7 @@ int RClearCommand(RedisModuleCtx* ctx, RedisModuleString** argv, int argc) {
   if (count > 0) {
     roaring_bitmap_clear(bitmap);
   }
+  cardinality_cache_adjust(bitmap, -(int64_t) count);
 
   RedisModule_ReplicateVerbatim(ctx);
   return RedisModule_ReplyWithLongLong(ctx, (long long) count);
@@ -1107,9 +2230,349 @@ int RJaccardCommand(RedisModuleCtx* ctx, RedisModuleString** argv, int argc) {
     return REDISMODULE_ERR;
   }
 
+  uint64_t card1 = BitmapCardinality(b1);
+  uint64_t card2 = BitmapCardinality(b2);
   uint64_t intersection = roaring_bitmap_and_cardinality(b1, b2);
-  uint64_t union_count = roaring_bitmap_or_cardinality(b1, b2);
-  return ReplyWithJaccardRatio(ctx, intersection, union_count);
+  return ReplyWithJaccardRatio(ctx, intersection, card1 + card2 - intersection);
+}
+
+/**
+ * Replies with the similarity of two bitmaps from their intersection and cardinalities,
+ * -1 when the metric is undefined (empty bitmaps)
+ */
+static int ReplyWithSimilarity(RedisModuleCtx* ctx, SimilarityMetric metric, uint64_t intersection, uint64_t card1,
+                               uint64_t card2) {
+  switch (metric) {
+    case SIMILARITY_JACCARD:
+      return ReplyWithJaccardRatio(ctx, intersection, card1 + card2 - intersection);
+    case SIMILARITY_OVERLAP:
+      return ReplyWithJaccardRatio(ctx, intersection, card1 < card2 ? card1 : card2);
+    case SIMILARITY_COSINE:
+      if (card1 == 0 || card2 == 0) {
+        return RedisModule_ReplyWithStringBuffer(ctx, "-1", 2);
+      }
+      return RedisModule_ReplyWithDouble(ctx, similarity_score(metric, intersection, card1, card2));
+    case SIMILARITY_INTERSECTION:
+      return ReplyWithUint64(ctx, intersection);
+  }
+
+  return REDISMODULE_ERR;
+}
+
+typedef struct {
+  uint32_t n;
+  const Bitmap** bitmaps;
+  uint32_t first_row;
+  uint32_t row_step;
+  uint64_t* matrix;
+} SimilarityRows;
+
+static void SimilarityRowsRun(void* arg) {
+  SimilarityRows* rows = arg;
+  bitmap_intersection_matrix_rows(rows->n, rows->bitmaps, rows->first_row, rows->row_step, rows->matrix);
+}
+
+/**
+ * R.SIMILARITY <key> [<key> ...] [METRIC <JACCARD|OVERLAP|COSINE|INTERSECTION>]
+ * Replies with the n x n similarity matrix of the keys, JACCARD by default
+ * */
+int RSimilarityCommand(RedisModuleCtx* ctx, RedisModuleString** argv, int argc) {
+  if (argc < 2) {
+    return (RedisModule_IsKeysPositionRequest(ctx) > 0) ? REDISMODULE_OK : RedisModule_WrongArity(ctx);
+  }
+
+  RedisModule_AutoMemory(ctx);
+  int keys_end = SimilarityKeysEnd(argc, RedisModule_StringPtrLen(argv[argc - 2], NULL));
+
+  if (RedisModule_IsKeysPositionRequest(ctx) > 0) {
+    for (int pos = 1; pos < keys_end; pos++) {
+      BitOpReportRedisKey(ctx, pos, REDISMODULE_CMD_KEY_RO | REDISMODULE_CMD_KEY_ACCESS);
+    }
+    return REDISMODULE_OK;
+  }
+
+  SimilarityMetric metric = SIMILARITY_JACCARD;
+  if (keys_end < argc) {
+    const char* name = RedisModule_StringPtrLen(argv[argc - 1], NULL);
+    if (!similarity_parse_metric(name, &metric)) {
+      return ReplyWithErrorFmt(ctx, "ERR invalid metric argument: %s", name);
+    }
+  }
+
+  uint32_t n = (uint32_t) (keys_end - 1);
+  if (n > BITMAP_SIMILARITY_MAX_KEYS) {
+    return ReplyWithErrorFmt(ctx, "ERR too many keys: maximum %d", BITMAP_SIMILARITY_MAX_KEYS);
+  }
+
+  const Bitmap** bitmaps = rm_malloc(n * sizeof(*bitmaps));
+  for (uint32_t i = 0; i < n; i++) {
+    Bitmap* bitmap;
+    RedisModuleKey* key;
+    if (TryGetBitmapKey(ctx, argv[1 + i], &bitmap, &key, REDISMODULE_READ) == REDISMODULE_ERR) {
+      rm_free(bitmaps);
+      return REDISMODULE_ERR;
+    }
+    bitmaps[i] = bitmap;
+  }
+
+  // The diagonal comes from the cached cardinalities, which are only touched on the main thread
+  uint64_t* matrix = rm_malloc((uint64_t) n * n * sizeof(*matrix));
+  for (uint32_t i = 0; i < n; i++) {
+    matrix[(uint64_t) i * n + i] = BitmapCardinality(bitmaps[i]);
+  }
+
+  // Rows are interleaved over the tasks, row i only computes the n - i - 1 pairs right of the diagonal
+  uint32_t n_tasks = n >= BITMAP_SIMILARITY_PARALLEL_MIN_KEYS ? thread_pool_size() + 1 : 1;
+  SimilarityRows* tasks = rm_malloc(n_tasks * sizeof(*tasks));
+  void** args = rm_malloc(n_tasks * sizeof(*args));
+  for (uint32_t i = 0; i < n_tasks; i++) {
+    tasks[i] = (SimilarityRows) {
+        .n = n,
+        .bitmaps = bitmaps,
+        .first_row = i,
+        .row_step = n_tasks,
+        .matrix = matrix
+    };
+    args[i] = &tasks[i];
+  }
+  thread_pool_run(SimilarityRowsRun, args, n_tasks);
+  rm_free(args);
+  rm_free(tasks);
+  rm_free(bitmaps);
+
+  RedisModule_ReplyWithArray(ctx, n);
+  for (uint32_t i = 0; i < n; i++) {
+    RedisModule_ReplyWithArray(ctx, n);
+    for (uint32_t j = 0; j < n; j++) {
+      uint64_t card1 = matrix[(uint64_t) i * n + i];
+      uint64_t card2 = matrix[(uint64_t) j * n + j];
+      ReplyWithSimilarity(ctx, metric, matrix[(uint64_t) i * n + j], card1, card2);
+    }
+  }
+
+  rm_free(matrix);
+  return REDISMODULE_OK;
+}
+
+typedef struct {
+  RedisModuleCtx* ctx;
+  RedisModuleString* query_name;
+  const Bitmap* query;
+  uint64_t query_cardinality;
+  SimilarityMetric metric;
+  SimilarityTopK topk;
+  // Caller of the command, NULL when it isn't restricted
+  RedisModuleUser* user;
+} TopKSearch;
+
+/**
+ * Scores a candidate unless its cardinality already rules it out of the top K. Returns true if it was kept.
+ */
+static bool TopKConsider(TopKSearch* search, RedisModuleString* name, const Bitmap* candidate) {
+  uint64_t cardinality = BitmapCardinality(candidate);
+  double upper_bound = similarity_upper_bound(search->metric, search->query_cardinality, cardinality);
+  if (!similarity_topk_accepts(&search->topk, upper_bound)) {
+    return false;
+  }
+
+  uint64_t intersection = roaring_bitmap_and_cardinality(search->query, candidate);
+  double score = similarity_score(search->metric, intersection, search->query_cardinality, cardinality);
+  if (!similarity_topk_accepts(&search->topk, score)) {
+    return false;
+  }
+
+  similarity_topk_push(&search->topk, (SimilarityCandidate) {
+      .score = score,
+      .intersection = intersection,
+      .cardinality = cardinality,
+      .item = name
+  });
+  return true;
+}
+
+/**
+ * Considers a candidate found by MATCH or MEMBERS: missing keys, keys of another type, keys the
+ * caller may not read and the query itself are skipped. These candidates are not declared as command
+ * keys, so their ACL is checked here.
+ */
+static void TopKConsiderReply(TopKSearch* search, RedisModuleCallReply* element) {
+  RedisModuleString* name = RedisModule_CreateStringFromCallReply(element);
+  if (name == NULL) {
+    return;
+  }
+
+  bool kept = false;
+  bool allowed = search->user == NULL
+      || RedisModule_ACLCheckKeyPermissions(search->user, name, REDISMODULE_CMD_KEY_ACCESS) == REDISMODULE_OK;
+  if (allowed && RedisModule_StringCompare(name, search->query_name) != 0) {
+    RedisModuleKey* key = RedisModule_OpenKey(search->ctx, name, REDISMODULE_READ);
+    if (RedisModule_KeyType(key) == REDISMODULE_KEYTYPE_MODULE && RedisModule_ModuleTypeGetType(key) == BitmapType) {
+      kept = TopKConsider(search, name, RedisModule_ModuleTypeGetValue(key));
+    }
+    RedisModule_CloseKey(key);
+  }
+
+  if (!kept) {
+    RedisModule_FreeString(search->ctx, name);
+  }
+}
+
+/**
+ * Scans about `count` keys of the keyspace, as the sum of the SCAN COUNT hints, so a single call can't
+ * walk a large keyspace
+ */
+static int TopKScanMatch(TopKSearch* search, RedisModuleString* pattern, uint64_t count) {
+  RedisModuleString* cursor = RedisModule_CreateString(search->ctx, "0", 1);
+  uint64_t remaining = count;
+  while (remaining > 0) {
+    uint64_t step = remaining < BITMAP_TOPK_SCAN_STEP ? remaining : BITMAP_TOPK_SCAN_STEP;
+    remaining -= step;
+    RedisModuleCallReply* reply = RedisModule_Call(
+        search->ctx, "SCAN", "scsclcc", cursor, "MATCH", pattern, "COUNT", (long long) step, "TYPE", "reroaring");
+    if (reply == NULL || RedisModule_CallReplyType(reply) != REDISMODULE_REPLY_ARRAY) {
+      return REDISMODULE_ERR;
+    }
+
+    RedisModule_FreeString(search->ctx, cursor);
+    cursor = RedisModule_CreateStringFromCallReply(RedisModule_CallReplyArrayElement(reply, 0));
+    RedisModuleCallReply* keys = RedisModule_CallReplyArrayElement(reply, 1);
+    for (size_t i = 0; i < RedisModule_CallReplyLength(keys); i++) {
+      TopKConsiderReply(search, RedisModule_CallReplyArrayElement(keys, i));
+    }
+    RedisModule_FreeCallReply(reply);
+    if (strcmp(RedisModule_StringPtrLen(cursor, NULL), "0") == 0) {
+      break;
+    }
+  }
+
+  return REDISMODULE_OK;
+}
+
+static void TopKSearchFree(TopKSearch* search) {
+  similarity_topk_free(&search->topk);
+  if (search->user != NULL) {
+    RedisModule_FreeModuleUser(search->user);
+  }
+}
+
+static int TopKScanMembers(TopKSearch* search, RedisModuleString* set) {
+  RedisModuleCallReply* reply = RedisModule_Call(search->ctx, "SMEMBERS", "s", set);
+  if (reply == NULL || RedisModule_CallReplyType(reply) != REDISMODULE_REPLY_ARRAY) {
+    return REDISMODULE_ERR;
+  }
+
+  for (size_t i = 0; i < RedisModule_CallReplyLength(reply); i++) {
+    TopKConsiderReply(search, RedisModule_CallReplyArrayElement(reply, i));
+  }
+  RedisModule_FreeCallReply(reply);
+
+  return REDISMODULE_OK;
+}
+
+/**
+ * R.TOPK <query> <k> <candidate> [<candidate> ...] [METRIC <JACCARD|OVERLAP|COSINE|INTERSECTION>]
+ * R.TOPK <query> <k> MATCH <pattern> COUNT <count> [METRIC <...>]
+ * R.TOPK <query> <k> MEMBERS <setkey> [METRIC <...>]
+ * Replies with the k candidates most similar to the query as key, score pairs, best first
+ * */
+int RTopKCommand(RedisModuleCtx* ctx, RedisModuleString** argv, int argc) {
+  if (argc < 4) {
+    return (RedisModule_IsKeysPositionRequest(ctx) > 0) ? REDISMODULE_OK : RedisModule_WrongArity(ctx);
+  }
+
+  RedisModule_AutoMemory(ctx);
+  const char* source_name = RedisModule_StringPtrLen(argv[3], NULL);
+  const char* option = argc > 5 ? RedisModule_StringPtrLen(argv[5], NULL) : NULL;
+  const char* before_last = RedisModule_StringPtrLen(argv[argc - 2], NULL);
+
+  if (RedisModule_IsKeysPositionRequest(ctx) > 0) {
+    TopKForEachKeyPosition(argc, source_name, option, before_last, ctx, BitOpReportRedisKey);
+    return REDISMODULE_OK;
+  }
+
+  int keys_end = TopKKeysEnd(argc, before_last);
+  TopKSource source = TopKParseSource(keys_end, source_name, option);
+
+  uint32_t k;
+  ParseUint32OrReturn(ctx, argv[2], "k", k);
+
+  // MATCH has to bound its walk of the keyspace
+  uint64_t count = 0;
+  if (source == TOPK_SOURCE_MATCH) {
+    if (keys_end != 7) {
+      return RedisModule_ReplyWithError(ctx, "ERR syntax error: MATCH requires COUNT");
+    }
+    ParseUint64OrReturn(ctx, argv[6], "count", count);
+  }
+
+  SimilarityMetric metric = SIMILARITY_JACCARD;
+  if (keys_end < argc) {
+    const char* name = RedisModule_StringPtrLen(argv[argc - 1], NULL);
+    if (!similarity_parse_metric(name, &metric)) {
+      return ReplyWithErrorFmt(ctx, "ERR invalid metric argument: %s", name);
+    }
+  }
+
+  Bitmap* query;
+  RedisModuleKey* query_key;
+  if (TryGetBitmapKey(ctx, argv[1], &query, &query_key, REDISMODULE_READ) == REDISMODULE_ERR) {
+    return REDISMODULE_ERR;
+  }
+
+  TopKSearch search = {
+      .ctx = ctx,
+      .query_name = argv[1],
+      .query = query,
+      .query_cardinality = BitmapCardinality(query),
+      .metric = metric
+  };
+
+  if (source != TOPK_SOURCE_KEYS) {
+    RedisModuleString* user_name = RedisModule_GetCurrentUserName(ctx);
+    if (user_name != NULL) {
+      search.user = RedisModule_GetModuleUserFromUserName(user_name);
+      if (search.user == NULL) {
+        return RedisModule_ReplyWithError(ctx, "ERR could not check the permissions of the current user");
+      }
+    }
+  }
+  similarity_topk_init(&search.topk, k);
+
+  int status = REDISMODULE_OK;
+  if (source == TOPK_SOURCE_MATCH) {
+    status = TopKScanMatch(&search, argv[4], count);
+  } else if (source == TOPK_SOURCE_MEMBERS) {
+    status = TopKScanMembers(&search, argv[4]);
+  } else {
+    for (int i = 3; i < keys_end; i++) {
+      Bitmap* candidate;
+      RedisModuleKey* key;
+      if (TryGetBitmapKey(ctx, argv[i], &candidate, &key, REDISMODULE_READ) == REDISMODULE_ERR) {
+        TopKSearchFree(&search);
+        return REDISMODULE_ERR;
+      }
+      TopKConsider(&search, argv[i], candidate);
+    }
+  }
+
+  if (status == REDISMODULE_ERR) {
+    TopKSearchFree(&search);
+    return RedisModule_ReplyWithError(ctx, source == TOPK_SOURCE_MATCH
+        ? "ERR could not scan the keyspace"
+        : REDISMODULE_ERRORMSG_WRONGTYPE);
+  }
+
+  similarity_topk_sort(&search.topk);
+
+  RedisModule_ReplyWithArray(ctx, 2 * search.topk.size);
+  for (uint32_t i = 0; i < search.topk.size; i++) {
+    SimilarityCandidate* candidate = &search.topk.heap[i];
+    RedisModule_ReplyWithString(ctx, candidate->item);
+    ReplyWithSimilarity(ctx, metric, candidate->intersection, search.query_cardinality, candidate->cardinality);
+  }
+
+  TopKSearchFree(&search);
+  return REDISMODULE_OK;
 }
 
 void R32Module_onShutdown(RedisModuleCtx* ctx, RedisModuleEvent e, uint64_t sub, void* data) {
@@ -1118,6 +2581,7 @@ void R32Module_onShutdown(RedisModuleCtx* ctx, RedisModuleEvent e, uint64_t sub,
 
 int R32Module_onLoad(RedisModuleCtx* ctx, RedisModuleString** argv, int argc) {
   BITMAP_NILL = bitmap_alloc();
+  FrozenBitmaps = RedisModule_CreateDict(NULL);
 
   RedisModuleTypeMethods tm = {
       .version = REDISMODULE_TYPE_METHOD_VERSION,
@@ -1125,7 +2589,11 @@ int R32Module_onLoad(RedisModuleCtx* ctx, RedisModuleString** argv, int argc) {
       .rdb_save = BitmapRdbSave,
       .aof_rewrite = BitmapAofRewrite,
       .mem_usage = BitmapMemUsage,
-      .free = BitmapFree
+      .free = BitmapFree,
+      .free_effort = BitmapFreeEffort,
+      .unlink = BitmapUnlink,
+      .defrag = BitmapDefrag,
+      .mem_usage2 = BitmapMemUsage2
   };
 
   BitmapType = RedisModule_CreateDataType(ctx, "reroaring", BITMAP_ENCODING_VERSION, &tm);
@@ -1148,6 +2616,11 @@ int R32Module_onLoad(RedisModuleCtx* ctx, RedisModuleString** argv, int argc) {
   RegisterCommand(ctx, "R.SETINTARRAY", RSetIntArrayCommand, "write", "write");
   RegisterCommand(ctx, "R.GETINTARRAY", RGetIntArrayCommand, "readonly", "read");
   RegisterCommand(ctx, "R.RANGEINTARRAY", RRangeIntArrayCommand, "readonly", "read");
+  RegisterCommand(ctx, "R.SCAN", RScanCommand, "readonly", "read");
+  RegisterCommand(ctx, "R.RANGEBYVALUE", RRangeByValueCommand, "readonly", "read");
+  RegisterCommand(ctx, "R.COUNTRANGE", RCountRangeCommand, "readonly", "read");
+  RegisterCommand(ctx, "R.RANK", RRankCommand, "readonly", "read");
+  RegisterCommand(ctx, "R.SELECT", RSelectCommand, "readonly", "read");
   RegisterCommand(ctx, "R.APPENDINTARRAY", RAppendIntArrayCommand, "write", "write");
   RegisterCommand(ctx, "R.DELETEINTARRAY", RDeleteIntArrayCommand, "write", "write");
   RegisterCommand(ctx, "R.DIFF", RDiffCommand, "write", "write");
@@ -1156,7 +2629,11 @@ int R32Module_onLoad(RedisModuleCtx* ctx, RedisModuleString** argv, int argc) {
   RegisterCommand(ctx, "R.OPTIMIZE", ROptimizeBitCommand, "readonly", "read");
   RegisterCommand(ctx, "R.SETBITARRAY", RSetBitArrayCommand, "write", "write");
   RegisterCommand(ctx, "R.GETBITARRAY", RGetBitArrayCommand, "readonly", "read");
+  RegisterCommand(ctx, "R.GETSERIALIZED", RGetSerializedCommand, "readonly", "read");
+  RegisterCommand(ctx, "R.SETSERIALIZED", RSetSerializedCommand, "write", "write");
   RegisterCommand(ctx, "R.BITOP", RBitOpCommand, "write getkeys-api", "write");
+  RegisterCommand(ctx, "R.BITOPCARD", RBitOpCardCommand, "readonly getkeys-api", "read");
+  RegisterCommand(ctx, "R.BITOPGET", RBitOpGetCommand, "readonly getkeys-api", "read");
   RegisterCommand(ctx, "R.BITCOUNT", RBitCountCommand, "readonly", "read");
   RegisterCommand(ctx, "R.BITPOS", RBitPosCommand, "readonly", "read");
   RegisterCommand(ctx, "R.MIN", RMinCommand, "readonly", "read");
@@ -1164,6 +2641,8 @@ int R32Module_onLoad(RedisModuleCtx* ctx, RedisModuleString** argv, int argc) {
   RegisterCommand(ctx, "R.CLEAR", RClearCommand, "write", "write");
   RegisterCommand(ctx, "R.CONTAINS", RContainsCommand, "readonly", "read");
   RegisterCommand(ctx, "R.JACCARD", RJaccardCommand, "readonly", "read");
+  RegisterCommand(ctx, "R.SIMILARITY", RSimilarityCommand, "readonly getkeys-api", "read");
+  RegisterCommand(ctx, "R.TOPK", RTopKCommand, "readonly getkeys-api", "read");
 
   if (RegisterRCommandInfos(ctx) != REDISMODULE_OK) {
     RedisModule_Log(ctx, "warning", "Failed to register the R.* commands info");
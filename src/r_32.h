@@ -2,12 +2,43 @@
 
 #include "redismodule.h"
 #include "data-structure.h"
+#include "optimizer.h"
 
-#define BITMAP_ENCODING_VERSION 1
+// encver 1: roaring_bitmap_serialize, deserialized into freshly allocated containers
+// encver 2: portable format, loaded as a frozen view over the RDB buffer
+// encver 3: chunk count followed by portable chunks of up to BITMAP_RDB_CHUNK_CONTAINERS containers
+#define BITMAP_ENCODING_VERSION_NATIVE 1
+#define BITMAP_ENCODING_VERSION_PORTABLE 2
+#define BITMAP_ENCODING_VERSION 3
+#define BITMAP_RDB_CHUNK_CONTAINERS 256
 #define BITMAP_MAX_RANGE_SIZE 100000000
+#define BITMAP_SCAN_DEFAULT_COUNT 10
+// R.BITOP is split by container key over the worker pool when every partition gets at least
+// this many source containers; partitions per worker keep threads busy when ranges are uneven
+#define BITMAP_BITOP_PARALLEL_MIN_CONTAINERS 256
+#define BITMAP_BITOP_PARTITIONS_PER_THREAD 4
+// R.BITOP replicates its result instead of the command once the serialized sources reach this size,
+// provided the result serializes smaller and the command reaches an AOF or a replica
+#define BITMAP_BITOP_REPLICATE_RESULT_MIN_BYTES 65536
+// R.SIMILARITY: largest matrix, and smallest one whose rows are split over the worker pool
+#define BITMAP_SIMILARITY_MAX_KEYS 4096
+#define BITMAP_SIMILARITY_PARALLEL_MIN_KEYS 32
+// R.TOPK MATCH: COUNT hint of each SCAN call, the command COUNT bounds their sum
+#define BITMAP_TOPK_SCAN_STEP 1000
+// Background optimizer: bitmaps smaller than this are left alone
+#define BITMAP_COMPACT_MIN_BYTES 4096
+// AOF rewrite: values per R.APPENDINTARRAY, and shortest run emitted as R.SETRANGE
+#define BITMAP_AOF_BATCH_SIZE 1024
+#define BITMAP_AOF_MIN_RANGE 16
 
 extern RedisModuleType* BitmapType;
 extern Bitmap* BITMAP_NILL;
+extern uint64_t BitmapBackgroundThreshold;
 
 int R32Module_onLoad(RedisModuleCtx* ctx, RedisModuleString** argv, int argc);
+/**
+ * Background optimizer step: compacts a bitmap stored in the keyspace unless it is small, frozen, larger
+ * than `max_bytes` (when not 0) or was not opened for writing since it was last compacted.
+ */
+OptimizerCompactResult BitmapBackgroundCompact(Bitmap* bitmap, uint64_t max_bytes, size_t* reclaimed);
 void R32Module_onShutdown(RedisModuleCtx* ctx, RedisModuleEvent e, uint64_t sub, void* data);
@@ -6,6 +6,9 @@
 #include "common.h"
 #include "parse.h"
 #include "bitop_keys.h"
+#include "similarity.h"
+#include "thread-pool.h"
+#include "cardinality-cache.h"
 #include "cmd_info/command_info.h"
 
 RedisModuleType* Bitmap64Type = NULL;
@@ -79,6 +82,9 @@ static int GetBitmapKey(RedisModuleCtx* ctx, RedisModuleString* keyName, Bitmap6
     INNER_ERROR(REDISMODULE_ERRORMSG_WRONGTYPE);
   }
   *value_out = RedisModule_ModuleTypeGetValue(key);
+  if (mode & REDISMODULE_WRITE) {
+    cardinality_cache_begin_write(*value_out);
+  }
   RedisModule_CloseKey(key);
   return REDISMODULE_OK;
 }
@@ -94,60 +100,206 @@ static int TryGetBitmapKey(RedisModuleCtx* ctx, RedisModuleString* keyName, Bitm
   } else {
     *key_out = key;
     *value_out = RedisModule_ModuleTypeGetValue(key);
+    if (mode & REDISMODULE_WRITE) {
+      cardinality_cache_begin_write(*value_out);
+    }
   }
 
   return REDISMODULE_OK;
 }
 
+/**
+ * Cardinality of a bitmap stored in the keyspace, from the cardinality cache when it is up to date.
+ * Must not be called on temporary bitmaps, nor on a key opened for writing before a change to its cardinality.
+ */
+static uint64_t BitmapCardinality(const Bitmap64* bitmap) {
+  if (bitmap == BITMAP64_NILL) {
+    return 0;
+  }
+  uint64_t cardinality;
+  if (!cardinality_cache_get(bitmap, &cardinality)) {
+    cardinality = bitmap64_get_cardinality(bitmap);
+    cardinality_cache_set(bitmap, cardinality);
+  }
+  return cardinality;
+}
+
+static void Bitmap64RdbSaveChunk(RedisModuleIO* rdb, const Bitmap64* chunk) {
+  size_t serialized_size;
+  char* serialized_bitmap = bitmap64_serialize(chunk, &serialized_size);
+  RedisModule_SaveStringBuffer(rdb, serialized_bitmap, serialized_size);
+  rm_free(serialized_bitmap);
+}
+
 void Bitmap64RdbSave(RedisModuleIO* rdb, void* value) {
   Bitmap64* bitmap = value;
-  size_t serialized_max_size = roaring64_bitmap_portable_size_in_bytes(bitmap);
-  char* serialized_bitmap = rm_malloc(serialized_max_size);
-  size_t serialized_size = roaring64_bitmap_portable_serialize(bitmap, serialized_bitmap);
-  RedisModule_SaveStringBuffer(rdb, serialized_bitmap, serialized_size);
+  uint64_t chunk_count = bitmap64_chunk_count(bitmap, BITMAP64_RDB_CHUNK_CONTAINERS);
+  RedisModule_SaveUnsigned(rdb, chunk_count);
+
+  if (chunk_count == 1) {
+    Bitmap64RdbSaveChunk(rdb, bitmap);
+    return;
+  }
+
+  // Serialize one chunk at a time so the extra memory doesn't grow with the bitmap
+  roaring64_iterator_t* iterator = roaring64_iterator_create(bitmap);
+  for (uint64_t i = 0; i < chunk_count; i++) {
+    Bitmap64* chunk = bitmap64_next_chunk(bitmap, iterator, BITMAP64_RDB_CHUNK_CONTAINERS);
+    Bitmap64RdbSaveChunk(rdb, chunk);
+    bitmap64_free(chunk);
+  }
+  roaring64_iterator_free(iterator);
+}
+
+static Bitmap64* Bitmap64RdbLoadChunk(RedisModuleIO* rdb) {
+  size_t size;
+  char* serialized_bitmap = RedisModule_LoadStringBuffer(rdb, &size);
+  Bitmap64* bitmap = bitmap64_deserialize(serialized_bitmap, size);
+  if (bitmap == NULL) {
+    RedisModule_LogIOError(rdb, "warning", "Can't load corrupted bitmap of %zu bytes", size);
+  }
   rm_free(serialized_bitmap);
+  return bitmap;
 }
 
 void* Bitmap64RdbLoad(RedisModuleIO* rdb, int encver) {
-  if (encver != BITMAP64_ENCODING_VERSION) {
+  if (encver < BITMAP64_ENCODING_VERSION_PORTABLE || encver > BITMAP64_ENCODING_VERSION) {
     RedisModule_LogIOError(rdb, "warning", "Can't load data with version %d", encver);
     return NULL;
   }
-  size_t size;
-  char* serialized_bitmap = RedisModule_LoadStringBuffer(rdb, &size);
-  Bitmap64* bitmap = roaring64_bitmap_portable_deserialize_safe(serialized_bitmap, size);
-  rm_free(serialized_bitmap);
+
+  if (encver == BITMAP64_ENCODING_VERSION_PORTABLE) {
+    return Bitmap64RdbLoadChunk(rdb);
+  }
+
+  uint64_t chunk_count = RedisModule_LoadUnsigned(rdb);
+  if (chunk_count == 0) {
+    return bitmap64_alloc();
+  }
+
+  Bitmap64* bitmap = Bitmap64RdbLoadChunk(rdb);
+  for (uint64_t i = 1; i < chunk_count && bitmap != NULL; i++) {
+    Bitmap64* chunk = Bitmap64RdbLoadChunk(rdb);
+    if (chunk == NULL) {
+      bitmap64_free(bitmap);
+      return NULL;
+    }
+    roaring64_bitmap_or_inplace(bitmap, chunk);
+    bitmap64_free(chunk);
+  }
   return bitmap;
 }
 
+OptimizerCompactResult Bitmap64BackgroundCompact(Bitmap64* bitmap, uint64_t max_bytes, size_t* reclaimed) {
+  if (cardinality_cache_is_compacted(bitmap)) {
+    return OPTIMIZER_COMPACT_SKIPPED;
+  }
+  size_t size = roaring64_bitmap_portable_size_in_bytes(bitmap);
+  if (size < BITMAP64_COMPACT_MIN_BYTES) {
+    return OPTIMIZER_COMPACT_SKIPPED;
+  }
+  if (max_bytes != 0 && size > max_bytes) {
+    return OPTIMIZER_COMPACT_TOO_LARGE;
+  }
+  *reclaimed = bitmap64_compact(bitmap);
+  cardinality_cache_set_compacted(bitmap);
+  return OPTIMIZER_COMPACT_DONE;
+}
+
 size_t Bitmap64MemUsage(const void* value) {
-  const Bitmap64* bitmap = value;
-  return roaring64_bitmap_portable_size_in_bytes(bitmap);
+  return bitmap64_allocated_size(value);
+}
+
+/**
+ * Number of allocations released by Bitmap64Free, large bitmaps are then freed by the lazyfree thread
+ */
+size_t Bitmap64FreeEffort(RedisModuleString* key, const void* value) {
+  REDISMODULE_NOT_USED(key);
+  return bitmap64_container_count(value, BITMAP64_FREE_EFFORT_MAX_CONTAINERS) + 1;
+}
+
+/**
+ * The key is gone from the keyspace, its value may still wait for the lazyfree thread
+ */
+void Bitmap64Unlink(RedisModuleString* key, const void* value) {
+  REDISMODULE_NOT_USED(key);
+  cardinality_cache_remove(value);
 }
 
 void Bitmap64Free(void* value) {
+  cardinality_cache_remove(value);
   bitmap64_free(value);
 }
 
-void Bitmap64AofRewrite(RedisModuleIO* aof, RedisModuleString* key, void* value) {
-  Bitmap64* bitmap = value;
-
-  uint64_t cardinality = bitmap64_get_cardinality(bitmap);
-  if (cardinality == 0) {
+static void Bitmap64AofRewriteValues(RedisModuleIO* aof, RedisModuleString* key, const uint64_t* values, size_t n) {
+  if (n == 0) {
     return;
   }
 
-  uint64_t* values = rm_malloc(sizeof(uint64_t) * cardinality);
-  if (values == NULL) {
-    return;
+  RedisModuleString* args[BITMAP64_AOF_BATCH_SIZE];
+  for (size_t i = 0; i < n; i++) {
+    args[i] = RedisModule_CreateStringPrintf(NULL, "%llu", (unsigned long long) values[i]);
+  }
+  RedisModule_EmitAOF(aof, "R64.APPENDINTARRAY", "sv", key, args, n);
+  for (size_t i = 0; i < n; i++) {
+    RedisModule_FreeString(NULL, args[i]);
   }
+}
+
+/**
+ * Rewrites the bitmap as R64.SETRANGE commands for runs of at least BITMAP64_AOF_MIN_RANGE
+ * consecutive values and R64.APPENDINTARRAY batches of at most BITMAP64_AOF_BATCH_SIZE values
+ * for everything else. Memory used by the rewrite child and the size of every command are
+ * bounded by the batch size, whatever the cardinality of the bitmap.
+ */
+void Bitmap64AofRewrite(RedisModuleIO* aof, RedisModuleString* key, void* value) {
+  Bitmap64* bitmap = value;
+  uint64_t values[BITMAP64_AOF_BATCH_SIZE];
+  size_t n = 0;
+
+  roaring64_iterator_t* iterator = roaring64_iterator_create(bitmap);
+  while (roaring64_iterator_has_value(iterator)) {
+    uint64_t start = roaring64_iterator_value(iterator);
+    uint64_t last = bitmap64_run_last(bitmap, start);
+
+    if (last - start >= BITMAP64_AOF_MIN_RANGE - 1) {
+      // R64.SETRANGE end is exclusive, so UINT64_MAX itself has to be appended
+      uint64_t end = last;
+      if (last == UINT64_MAX) {
+        values[n++] = UINT64_MAX;
+      } else {
+        end = last + 1;
+      }
+      char start_str[32];
+      char end_str[32];
+      snprintf(start_str, sizeof(start_str), "%llu", (unsigned long long) start);
+      snprintf(end_str, sizeof(end_str), "%llu", (unsigned long long) end);
+      RedisModule_EmitAOF(aof, "R64.SETRANGE", "scc", key, start_str, end_str);
+    } else {
+      for (uint64_t v = start;; v++) {
+        values[n++] = v;
+        if (n == BITMAP64_AOF_BATCH_SIZE) {
+          Bitmap64AofRewriteValues(aof, key, values, n);
+          n = 0;
+        }
+        if (v == last) {
+          break;
+        }
+      }
+    }
 
-  roaring64_bitmap_to_uint64_array(bitmap, values);
+    if (n == BITMAP64_AOF_BATCH_SIZE) {
+      Bitmap64AofRewriteValues(aof, key, values, n);
+      n = 0;
+    }
 
-  /* Use R64.SETINTARRAY command to reconstruct the bitmap */
-  RedisModule_EmitAOF(aof, "R64.SETINTARRAY", "sl", key, values, cardinality);
+    if (last == UINT64_MAX || !roaring64_iterator_move_equalorlarger(iterator, last + 1)) {
+      break;
+    }
+  }
+  roaring64_iterator_free(iterator);
 
-  rm_free(values);
+  Bitmap64AofRewriteValues(aof, key, values, n);
 }
 
 /**
@@ -183,6 +335,7 @@ int R64SetBitCommand(RedisModuleCtx* ctx, RedisModuleString** argv, int argc) {
 
   /* Set bit with value */
   bool old_value = bitmap64_setbit(bitmap, offset, value);
+  cardinality_cache_adjust(bitmap, (int64_t) value - (int64_t) old_value);
   RedisModule_ReplicateVerbatim(ctx);
   return RedisModule_ReplyWithLongLong(ctx, old_value);
 }
@@ -215,8 +368,31 @@ int R64GetBitCommand(RedisModuleCtx* ctx, RedisModuleString** argv, int argc) {
   return RedisModule_ReplyWithLongLong(ctx, value);
 }
 
+/**
+ * Replies to the PACKED form of R64.GETBITS: `packed` holds little-endian uint64 offsets and the reply is
+ * a bit-vector string with one bit per offset, most significant bit first. A missing key answers all zeros.
+ * */
+static int GetBitsPackedReply(RedisModuleCtx* ctx, const Bitmap64* bitmap, RedisModuleString* packed) {
+  size_t len;
+  const char* buffer = RedisModule_StringPtrLen(packed, &len);
+  if (len % sizeof(uint64_t) != 0) {
+    INNER_ERROR(ERRORMSG_WRONGARG("offsets", "length must be a multiple of 8 bytes"));
+  }
+
+  size_t n_offsets = len / sizeof(uint64_t);
+  size_t n_bytes = (n_offsets + 7) / 8;
+  unsigned char* bits = rm_malloc(n_bytes + 1);
+  bitmap64_getbits_packed(bitmap, n_offsets, (const unsigned char*) buffer, bits);
+
+  RedisModule_ReplyWithStringBuffer(ctx, (const char*) bits, n_bytes);
+  rm_free(bits);
+
+  return REDISMODULE_OK;
+}
+
 /**
  * R64.GETBITS <key> offset [offset1 offset2 ... offsetN]
+ * R64.GETBITS <key> PACKED <offsets>
  * */
 int R64GetBitManyCommand(RedisModuleCtx* ctx, RedisModuleString** argv, int argc) {
   if (argc < 3) {
@@ -231,6 +407,10 @@ int R64GetBitManyCommand(RedisModuleCtx* ctx, RedisModuleString** argv, int argc
     return REDISMODULE_ERR;
   }
 
+  if (argc == 4 && strcmp(RedisModule_StringPtrLen(argv[2], NULL), "PACKED") == 0) {
+    return GetBitsPackedReply(ctx, bitmap, argv[3]);
+  }
+
   if (bitmap == BITMAP64_NILL) {
     return RedisModule_ReplyWithEmptyArray(ctx);
   }
@@ -300,19 +480,63 @@ int R64ClearBitsCommand(RedisModuleCtx* ctx, RedisModuleString** argv, int argc)
 
   RedisModule_ReplicateVerbatim(ctx);
 
+  // Counting the removed bits costs the same as removing them and keeps the cardinality cache up to date
+  size_t count = bitmap64_clearbits_count(bitmap, n_offsets, offsets);
+  cardinality_cache_adjust(bitmap, -(int64_t) count);
+  rm_free(offsets);
+
   if (count_mode) {
-    size_t count = bitmap64_clearbits_count(bitmap, n_offsets, offsets);
-    rm_free(offsets);
     return RedisModule_ReplyWithLongLong(ctx, (long long) count);
   }
 
-  bitmap64_clearbits(bitmap, n_offsets, offsets);
-  rm_free(offsets);
   return RedisModule_ReplyWithSimpleString(ctx, "OK");
 }
 
+/**
+ * Parses the values of SETINTARRAY and APPENDINTARRAY starting at argv[2], either decimal arguments
+ * or the packed form `PACKED [DELTA] [VARINT] <values>`. The packed buffer is decoded without going
+ * through per-value string parsing. Returns false after replying with an error.
+ * */
+static bool ParseIntArray(RedisModuleCtx* ctx, RedisModuleString** argv, int argc, uint64_t** values, size_t* n) {
+  if (argc < 4 || argc > 6 || strcmp(RedisModule_StringPtrLen(argv[2], NULL), "PACKED") != 0) {
+    *n = (size_t) (argc - 2);
+    *values = rm_malloc(sizeof(**values) * (*n));
+    for (size_t i = 0; i < *n; i++) {
+      if (!StrToUInt64(argv[2 + i], &(*values)[i])) {
+        rm_free(*values);
+        RedisModule_ReplyWithError(ctx, ERRORMSG_WRONGARG_UINT64("value"));
+        return false;
+      }
+    }
+    return true;
+  }
+
+  int encoding = BITMAP_INT_ENCODING_FIXED;
+  for (int i = 3; i < argc - 1; i++) {
+    const char* option = RedisModule_StringPtrLen(argv[i], NULL);
+    if (strcmp(option, "DELTA") == 0) {
+      encoding |= BITMAP_INT_ENCODING_DELTA;
+    } else if (strcmp(option, "VARINT") == 0) {
+      encoding |= BITMAP_INT_ENCODING_VARINT;
+    } else {
+      RedisModule_ReplyWithError(ctx, "ERR syntax error");
+      return false;
+    }
+  }
+
+  size_t len;
+  const char* buffer = RedisModule_StringPtrLen(argv[argc - 1], &len);
+  if (!bitmap64_decode_int_array(len, (const unsigned char*) buffer, encoding, values, n)) {
+    RedisModule_ReplyWithError(ctx, ERRORMSG_WRONGARG("values", "malformed packed integer array"));
+    return false;
+  }
+
+  return true;
+}
+
 /**
  * R64.SETINTARRAY <key> <value1> [<value2> <value3> ... <valueN>]
+ * R64.SETINTARRAY <key> PACKED [DELTA] [VARINT] <values>
  * */
 int R64SetIntArrayCommand(RedisModuleCtx* ctx, RedisModuleString** argv, int argc) {
   if (argc < 3) {
@@ -327,13 +551,10 @@ int R64SetIntArrayCommand(RedisModuleCtx* ctx, RedisModuleString** argv, int arg
     return REDISMODULE_ERR;
   }
 
-  size_t length = (size_t) (argc - 2);
-  uint64_t* values = rm_malloc(sizeof(*values) * length);
-  for (int i = 0; i < length; i++) {
-    if (!StrToUInt64(argv[2 + i], &values[i])) {
-      rm_free(values);
-      INNER_ERROR(ERRORMSG_WRONGARG_UINT64("value"));
-    }
+  size_t length;
+  uint64_t* values;
+  if (!ParseIntArray(ctx, argv, argc, &values, &length)) {
+    return REDISMODULE_ERR;
   }
 
   bitmap = bitmap64_from_int_array(length, values);
@@ -442,9 +663,156 @@ int R64RangeIntArrayCommand(RedisModuleCtx* ctx, RedisModuleString** argv, int a
 }
 
 /**
- * R64.APPENDINTARRAY <key> <value1> [<value2> <value3> ... <valueN>]
+ * R64.SCAN <key> <cursor> [COUNT count]
  * */
-int R64AppendIntArrayCommand(RedisModuleCtx* ctx, RedisModuleString** argv, int argc) {
+int R64ScanCommand(RedisModuleCtx* ctx, RedisModuleString** argv, int argc) {
+  if (argc != 3 && argc != 5) {
+    return RedisModule_WrongArity(ctx);
+  }
+
+  RedisModule_AutoMemory(ctx);
+  RedisModuleKey* key;
+  Bitmap64* bitmap;
+
+  if (TryGetBitmapKey(ctx, argv[1], &bitmap, &key, REDISMODULE_READ) == REDISMODULE_ERR) {
+    return REDISMODULE_ERR;
+  }
+
+  uint64_t cursor;
+  ParseUint64OrReturn(ctx, argv[2], "cursor", cursor);
+
+  uint64_t count = BITMAP64_SCAN_DEFAULT_COUNT;
+  if (argc == 5) {
+    const char* option = RedisModule_StringPtrLen(argv[3], NULL);
+    if (strcmp(option, "COUNT") != 0) {
+      return ReplyWithErrorFmt(ctx, "ERR invalid option argument: %s", option);
+    }
+
+    ParseUint64OrReturn(ctx, argv[4], "count", count);
+
+    if (count == 0) {
+      INNER_ERROR(ERRORMSG_WRONGARG("count", "must be greater than 0"));
+    }
+
+    if (count > BITMAP64_MAX_RANGE_SIZE) {
+      return ReplyWithErrorFmt(ctx, ERRORMSG_RANGE_LIMIT, BITMAP64_MAX_RANGE_SIZE);
+    }
+  }
+
+  RedisModule_ReplyWithArray(ctx, 2);
+
+  if (bitmap == BITMAP64_NILL) {
+    RedisModule_ReplyWithLongLong(ctx, 0);
+    return RedisModule_ReplyWithEmptyArray(ctx);
+  }
+
+  uint64_t n;
+  bool has_more;
+  uint64_t* values = bitmap64_scan(bitmap, cursor, count, &n, &has_more);
+
+  // The next cursor is the value after the last one returned, 0 once the scan is complete
+  ReplyWithUint64(ctx, has_more ? values[n - 1] + 1 : 0);
+
+  RedisModule_ReplyWithArray(ctx, (long) n);
+  for (uint64_t i = 0; i < n; i++) {
+    ReplyWithUint64(ctx, values[i]);
+  }
+
+  rm_free(values);
+  return REDISMODULE_OK;
+}
+
+/**
+ * R64.RANGEBYVALUE <key> <min> <max> [LIMIT offset count]
+ * */
+int R64RangeByValueCommand(RedisModuleCtx* ctx, RedisModuleString** argv, int argc) {
+  if (argc != 4 && argc != 7) {
+    return RedisModule_WrongArity(ctx);
+  }
+
+  RedisModule_AutoMemory(ctx);
+  RedisModuleKey* key;
+  Bitmap64* bitmap;
+
+  if (TryGetBitmapKey(ctx, argv[1], &bitmap, &key, REDISMODULE_READ) == REDISMODULE_ERR) {
+    return REDISMODULE_ERR;
+  }
+
+  uint64_t min;
+  ParseUint64OrReturn(ctx, argv[2], "min", min);
+
+  uint64_t max;
+  ParseUint64OrReturn(ctx, argv[3], "max", max);
+
+  uint64_t offset = 0;
+  uint64_t count = UINT64_MAX;
+  if (argc == 7) {
+    const char* option = RedisModule_StringPtrLen(argv[4], NULL);
+    if (strcmp(option, "LIMIT") != 0) {
+      return ReplyWithErrorFmt(ctx, "ERR invalid option argument: %s", option);
+    }
+
+    ParseUint64OrReturn(ctx, argv[5], "offset", offset);
+    ParseUint64OrReturn(ctx, argv[6], "count", count);
+  }
+
+  if (bitmap == BITMAP64_NILL || min > max || count == 0) {
+    return RedisModule_ReplyWithEmptyArray(ctx);
+  }
+
+  // Without a small enough LIMIT the whole window is returned, refuse windows too large to reply
+  if (count > BITMAP64_MAX_RANGE_SIZE) {
+    uint64_t available = bitmap64_range_cardinality(bitmap, min, max);
+    if (available > offset && available - offset > BITMAP64_MAX_RANGE_SIZE) {
+      return ReplyWithErrorFmt(ctx, ERRORMSG_RANGE_LIMIT, BITMAP64_MAX_RANGE_SIZE);
+    }
+  }
+
+  uint64_t n;
+  uint64_t* values = bitmap64_range_by_value(bitmap, min, max, offset, count, &n);
+
+  RedisModule_ReplyWithArray(ctx, (long) n);
+  for (uint64_t i = 0; i < n; i++) {
+    ReplyWithUint64(ctx, values[i]);
+  }
+
+  rm_free(values);
+  return REDISMODULE_OK;
+}
+
+/**
+ * R64.COUNTRANGE <key> <min> <max>
+ * */
+int R64CountRangeCommand(RedisModuleCtx* ctx, RedisModuleString** argv, int argc) {
+  if (argc != 4) {
+    return RedisModule_WrongArity(ctx);
+  }
+
+  RedisModule_AutoMemory(ctx);
+  RedisModuleKey* key;
+  Bitmap64* bitmap;
+
+  if (TryGetBitmapKey(ctx, argv[1], &bitmap, &key, REDISMODULE_READ) == REDISMODULE_ERR) {
+    return REDISMODULE_ERR;
+  }
+
+  uint64_t min;
+  ParseUint64OrReturn(ctx, argv[2], "min", min);
+
+  uint64_t max;
+  ParseUint64OrReturn(ctx, argv[3], "max", max);
+
+  if (bitmap == BITMAP64_NILL || min > max) {
+    return RedisModule_ReplyWithLongLong(ctx, 0);
+  }
+
+  return ReplyWithUint64(ctx, bitmap64_range_cardinality(bitmap, min, max));
+}
+
+/**
+ * R64.RANK <key> <value> [value ...]
+ * */
+int R64RankCommand(RedisModuleCtx* ctx, RedisModuleString** argv, int argc) {
   if (argc < 3) {
     return RedisModule_WrongArity(ctx);
   }
@@ -453,19 +821,98 @@ int R64AppendIntArrayCommand(RedisModuleCtx* ctx, RedisModuleString** argv, int
   RedisModuleKey* key;
   Bitmap64* bitmap;
 
-  if (TryGetBitmapKey(ctx, argv[1], &bitmap, &key, REDISMODULE_READ | REDISMODULE_WRITE) == REDISMODULE_ERR) {
+  if (TryGetBitmapKey(ctx, argv[1], &bitmap, &key, REDISMODULE_READ) == REDISMODULE_ERR) {
     return REDISMODULE_ERR;
   }
 
-  size_t length = (size_t) (argc - 2);
-  uint64_t* values = rm_malloc(sizeof(*values) * length);
-  for (int i = 0; i < length; i++) {
+  size_t n_values = (size_t) (argc - 2);
+  uint64_t* values = rm_malloc(sizeof(*values) * n_values);
+
+  for (size_t i = 0; i < n_values; i++) {
     if (!StrToUInt64(argv[2 + i], &values[i])) {
       rm_free(values);
       INNER_ERROR(ERRORMSG_WRONGARG_UINT64("value"));
     }
   }
 
+  // Always an array, even for a single value, so the reply shape doesn't depend on the arguments
+  RedisModule_ReplyWithArray(ctx, (long) n_values);
+
+  for (size_t i = 0; i < n_values; i++) {
+    uint64_t rank = bitmap == BITMAP64_NILL ? 0 : bitmap64_rank(bitmap, values[i]);
+    ReplyWithUint64(ctx, rank);
+  }
+
+  rm_free(values);
+  return REDISMODULE_OK;
+}
+
+/**
+ * R64.SELECT <key> <n> [n ...]
+ * */
+int R64SelectCommand(RedisModuleCtx* ctx, RedisModuleString** argv, int argc) {
+  if (argc < 3) {
+    return RedisModule_WrongArity(ctx);
+  }
+
+  RedisModule_AutoMemory(ctx);
+  RedisModuleKey* key;
+  Bitmap64* bitmap;
+
+  if (TryGetBitmapKey(ctx, argv[1], &bitmap, &key, REDISMODULE_READ) == REDISMODULE_ERR) {
+    return REDISMODULE_ERR;
+  }
+
+  size_t n_ranks = (size_t) (argc - 2);
+  uint64_t* ranks = rm_malloc(sizeof(*ranks) * n_ranks);
+
+  for (size_t i = 0; i < n_ranks; i++) {
+    if (!StrToUInt64(argv[2 + i], &ranks[i])) {
+      rm_free(ranks);
+      INNER_ERROR(ERRORMSG_WRONGARG_UINT64("n"));
+    }
+  }
+
+  RedisModule_ReplyWithArray(ctx, (long) n_ranks);
+
+  for (size_t i = 0; i < n_ranks; i++) {
+    // n is 1-based, -1 when the bitmap has fewer than n elements
+    bool found = false;
+    uint64_t element = bitmap == BITMAP64_NILL ? 0 : bitmap64_get_nth_element_present(bitmap, ranks[i], &found);
+    if (found) {
+      ReplyWithUint64(ctx, element);
+    } else {
+      RedisModule_ReplyWithLongLong(ctx, -1);
+    }
+  }
+
+  rm_free(ranks);
+  return REDISMODULE_OK;
+}
+
+/**
+ * R64.APPENDINTARRAY <key> <value1> [<value2> <value3> ... <valueN>]
+ * R64.APPENDINTARRAY <key> PACKED [DELTA] [VARINT] <values>
+ * */
+int R64AppendIntArrayCommand(RedisModuleCtx* ctx, RedisModuleString** argv, int argc) {
+  if (argc < 3) {
+    return RedisModule_WrongArity(ctx);
+  }
+
+  RedisModule_AutoMemory(ctx);
+  RedisModuleKey* key;
+  Bitmap64* bitmap;
+
+  if (TryGetBitmapKey(ctx, argv[1], &bitmap, &key, REDISMODULE_READ | REDISMODULE_WRITE) == REDISMODULE_ERR) {
+    return REDISMODULE_ERR;
+  }
+
+  size_t length;
+  uint64_t* values;
+  if (!ParseIntArray(ctx, argv, argc, &values, &length)) {
+    return REDISMODULE_ERR;
+  }
+
   if (bitmap == BITMAP64_NILL) {
     bitmap = bitmap64_from_int_array(length, values);
     rm_free(values);
@@ -522,9 +969,8 @@ int R64DeleteIntArrayCommand(RedisModuleCtx* ctx, RedisModuleString** argv, int
    * when duplicate values remove the final element from a container. Remove
    * values one by one so repeated DELETEINTARRAY arguments stay safe.
    */
-  for (size_t i = 0; i < length; i++) {
-    roaring64_bitmap_remove(bitmap, values[i]);
-  }
+  size_t removed = bitmap64_clearbits_count(bitmap, length, values);
+  cardinality_cache_adjust(bitmap, -(int64_t) removed);
   rm_free(values);
 
   RedisModule_ReplicateVerbatim(ctx);
@@ -729,7 +1175,68 @@ int R64GetBitArrayCommand(RedisModuleCtx* ctx, RedisModuleString** argv, int arg
   return REDISMODULE_OK;
 }
 
-int R64BitFlip(RedisModuleCtx* ctx, RedisModuleString** argv, int argc) {
+/**
+ * R64.GETSERIALIZED <key>
+ * */
+int R64GetSerializedCommand(RedisModuleCtx* ctx, RedisModuleString** argv, int argc) {
+  if (argc != 2) {
+    return RedisModule_WrongArity(ctx);
+  }
+
+  RedisModule_AutoMemory(ctx);
+  RedisModuleKey* key;
+  Bitmap64* bitmap;
+
+  if (TryGetBitmapKey(ctx, argv[1], &bitmap, &key, REDISMODULE_READ) == REDISMODULE_ERR) {
+    return REDISMODULE_ERR;
+  }
+
+  if (bitmap == BITMAP64_NILL) {
+    return RedisModule_ReplyWithNull(ctx);
+  }
+
+  size_t size;
+  char* serialized = bitmap64_serialize(bitmap, &size);
+  RedisModule_ReplyWithStringBuffer(ctx, serialized, size);
+  rm_free(serialized);
+
+  return REDISMODULE_OK;
+}
+
+/**
+ * R64.SETSERIALIZED <key> <serialized>
+ * */
+int R64SetSerializedCommand(RedisModuleCtx* ctx, RedisModuleString** argv, int argc) {
+  if (argc != 3) {
+    return RedisModule_WrongArity(ctx);
+  }
+
+  RedisModule_AutoMemory(ctx);
+  RedisModuleKey* key;
+  Bitmap64* bitmap;
+
+  if (TryGetBitmapKey(ctx, argv[1], &bitmap, &key, REDISMODULE_READ | REDISMODULE_WRITE) == REDISMODULE_ERR) {
+    return REDISMODULE_ERR;
+  }
+
+  // Deserialize before touching the key, so an invalid blob leaves it unchanged
+  size_t len;
+  const char* serialized = RedisModule_StringPtrLen(argv[2], &len);
+  bitmap = bitmap64_deserialize(serialized, len);
+  if (bitmap == NULL) {
+    INNER_ERROR(ERRORMSG_WRONGARG("serialized", "must be a valid portable roaring bitmap"));
+  }
+
+  if (RedisModule_ModuleTypeSetValue(key, Bitmap64Type, bitmap) != REDISMODULE_OK) {
+    bitmap64_free(bitmap);
+    INNER_ERROR(ERRORMSG_SET_VALUE);
+  }
+
+  RedisModule_ReplicateVerbatim(ctx);
+  return RedisModule_ReplyWithSimpleString(ctx, "OK");
+}
+
+int R64BitFlip(RedisModuleCtx* ctx, RedisModuleString** argv, int argc) {
   bool has_last_arg = false;
   uint64_t last = 0;
 
@@ -782,10 +1289,24 @@ int R64BitFlip(RedisModuleCtx* ctx, RedisModuleString** argv, int argc) {
 
   // Integer reply: The size of the string stored in the destination key
   // (adapted to cardinality)
-  uint64_t cardinality = bitmap64_get_cardinality(result);
+  uint64_t cardinality = BitmapCardinality(result);
   return ReplyWithUint64(ctx, cardinality);
 }
 
+/**
+ * Replicates `result` as R64.SETSERIALIZED, followed by the TTL of `key` which R64.SETSERIALIZED
+ * clears on replicas.
+ */
+static void ReplicateBitOpResult(RedisModuleCtx* ctx, RedisModuleString* key, const Bitmap64* result, mstime_t expire) {
+  size_t size;
+  char* serialized = bitmap64_serialize(result, &size);
+  RedisModule_Replicate(ctx, "R64.SETSERIALIZED", "sb", key, serialized, size);
+  rm_free(serialized);
+  if (expire != REDISMODULE_NO_EXPIRE) {
+    RedisModule_Replicate(ctx, "PEXPIREAT", "sl", key, (long long) expire);
+  }
+}
+
 int R64BitOp(RedisModuleCtx* ctx, RedisModuleString** argv, int argc, void (*operation)(Bitmap64*, uint32_t, const Bitmap64**)) {
   // Validate argument count (need at least: cmd, op, destkey, srckey1, srckey2)
   if (argc < 5) {
@@ -841,6 +1362,15 @@ int R64BitOp(RedisModuleCtx* ctx, RedisModuleString** argv, int argc, void (*ope
     }
   }
 
+  // Replicas recompute small operations, large ones may be cheaper to replicate by result.
+  // Sizing the sources is only worth it when the command is propagated at all
+  size_t source_size = 0;
+  if (ReplicationStreamActive(ctx)) {
+    for (uint32_t i = 1; i < num_sources; i++) {
+      source_size += roaring64_bitmap_portable_size_in_bytes(bitmaps[i]);
+    }
+  }
+
   // Perform the bitmap operation
   operation(bitmaps[0], num_sources - 1, (const Bitmap64**) (bitmaps + 1));
 
@@ -849,10 +1379,17 @@ int R64BitOp(RedisModuleCtx* ctx, RedisModuleString** argv, int argc, void (*ope
     RedisModule_ModuleTypeSetValue(srckeys[0], Bitmap64Type, bitmaps[0]);
   }
 
-  RedisModule_ReplicateVerbatim(ctx);
+  // Sizing the result only walks its container headers
+  if (source_size >= BITMAP64_BITOP_REPLICATE_RESULT_MIN_BYTES
+      && roaring64_bitmap_portable_size_in_bytes(bitmaps[0]) < source_size) {
+    mstime_t expire = dest_allocated ? REDISMODULE_NO_EXPIRE : RedisModule_GetAbsExpire(srckeys[0]);
+    ReplicateBitOpResult(ctx, argv[2], bitmaps[0], expire);
+  } else {
+    RedisModule_ReplicateVerbatim(ctx);
+  }
 
   // Reply with cardinality
-  uint64_t cardinality = bitmap64_get_cardinality(bitmaps[0]);
+  uint64_t cardinality = BitmapCardinality(bitmaps[0]);
   ReplyWithUint64(ctx, cardinality);
 
   // Cleanup
@@ -916,6 +1453,169 @@ int R64BitOpCommand(RedisModuleCtx* ctx, RedisModuleString** argv, int argc) {
 }
 
 
+/**
+ * Maps a variadic BITOP operation name to its BITMAP_OPERATION_* value, NOT is not included
+ */
+static bool ParseBitOpOperation(const char* name, int* operation) {
+  if (strcmp(name, "AND") == 0) {
+    *operation = BITMAP_OPERATION_AND;
+  } else if (strcmp(name, "OR") == 0) {
+    *operation = BITMAP_OPERATION_OR;
+  } else if (strcmp(name, "XOR") == 0) {
+    *operation = BITMAP_OPERATION_XOR;
+  } else if (strcmp(name, "ANDOR") == 0) {
+    *operation = BITMAP_OPERATION_ANDOR;
+  } else if (strcmp(name, "ONE") == 0) {
+    *operation = BITMAP_OPERATION_ONE;
+  } else if (strcmp(name, "DIFF") == 0) {
+    *operation = BITMAP_OPERATION_ANDNOT;
+  } else if (strcmp(name, "DIFF1") == 0) {
+    *operation = BITMAP_OPERATION_ORNOT;
+  } else {
+    return false;
+  }
+
+  return true;
+}
+
+/**
+ * R64.BITOPCARD <operation> <key> <key> [<key> ...]
+ * Cardinality of `R64.BITOP <operation>` over the given keys, without storing the result
+ * */
+int R64BitOpCardCommand(RedisModuleCtx* ctx, RedisModuleString** argv, int argc) {
+  if (argc < 4) {
+    return (RedisModule_IsKeysPositionRequest(ctx) > 0) ? REDISMODULE_OK : RedisModule_WrongArity(ctx);
+  }
+
+  RedisModule_AutoMemory(ctx);
+  size_t len;
+  const char* name = RedisModule_StringPtrLen(argv[1], &len);
+
+  if (RedisModule_IsKeysPositionRequest(ctx) > 0) {
+    BitOpReadForEachKeyPosition(name, argc, ctx, BitOpReportRedisKey);
+    return REDISMODULE_OK;
+  }
+
+  int operation;
+  if (!ParseBitOpOperation(name, &operation)) {
+    RedisModule_ReplyWithError(ctx, "ERR syntax error");
+    return REDISMODULE_ERR;
+  }
+
+  uint32_t n = (uint32_t) (argc - 2);
+  const Bitmap64** bitmaps = rm_malloc(n * sizeof(*bitmaps));
+
+  for (uint32_t i = 0; i < n; i++) {
+    Bitmap64* bitmap;
+    RedisModuleKey* key;
+    if (TryGetBitmapKey(ctx, argv[2 + i], &bitmap, &key, REDISMODULE_READ) == REDISMODULE_ERR) {
+      rm_free(bitmaps);
+      return REDISMODULE_ERR;
+    }
+    bitmaps[i] = bitmap;
+  }
+
+  uint64_t cardinality = bitmap64_operation_cardinality(operation, n, bitmaps);
+  rm_free(bitmaps);
+
+  return ReplyWithUint64(ctx, cardinality);
+}
+
+static void (*const BITOP_OPERATIONS[])(Bitmap64*, uint32_t, const Bitmap64**) = {
+    [BITMAP_OPERATION_AND] = bitmap64_and,
+    [BITMAP_OPERATION_OR] = bitmap64_or,
+    [BITMAP_OPERATION_XOR] = bitmap64_xor,
+    [BITMAP_OPERATION_ANDOR] = bitmap64_andor,
+    [BITMAP_OPERATION_ONE] = bitmap64_one,
+    [BITMAP_OPERATION_ANDNOT] = bitmap64_andnot,
+    [BITMAP_OPERATION_ORNOT] = bitmap64_ornot,
+};
+
+typedef struct {
+  RedisModuleCtx* ctx;
+  uint64_t remaining;
+} BitOpGetReplyState;
+
+static bool BitOpGetReplyValue(uint64_t value, void* param) {
+  BitOpGetReplyState* state = param;
+  ReplyWithUint64(state->ctx, value);
+  return --state->remaining > 0;
+}
+
+/**
+ * R64.BITOPGET <operation> <key> <key> [<key> ...] [LIMIT <count>]
+ * Replies with the members of `R64.BITOP <operation>` over the given keys, the result is only
+ * built in scratch memory: no key is written and nothing is replicated
+ * */
+int R64BitOpGetCommand(RedisModuleCtx* ctx, RedisModuleString** argv, int argc) {
+  if (argc < 4) {
+    return (RedisModule_IsKeysPositionRequest(ctx) > 0) ? REDISMODULE_OK : RedisModule_WrongArity(ctx);
+  }
+
+  RedisModule_AutoMemory(ctx);
+  size_t len;
+  const char* name = RedisModule_StringPtrLen(argv[1], &len);
+  int keys_end = BitOpGetKeysEnd(argc, RedisModule_StringPtrLen(argv[argc - 2], NULL));
+
+  if (RedisModule_IsKeysPositionRequest(ctx) > 0) {
+    BitOpReadForEachKeyPosition(name, keys_end, ctx, BitOpReportRedisKey);
+    return REDISMODULE_OK;
+  }
+
+  int operation;
+  if (!ParseBitOpOperation(name, &operation)) {
+    RedisModule_ReplyWithError(ctx, "ERR syntax error");
+    return REDISMODULE_ERR;
+  }
+
+  // `LIMIT <count>` after a single key
+  if (keys_end < 4) {
+    RedisModule_ReplyWithError(ctx, "ERR syntax error");
+    return REDISMODULE_ERR;
+  }
+
+  uint64_t limit = UINT64_MAX;
+  if (keys_end < argc) {
+    ParseUint64OrReturn(ctx, argv[argc - 1], "limit", limit);
+  }
+
+  uint32_t n = (uint32_t) (keys_end - 2);
+  const Bitmap64** bitmaps = rm_malloc(n * sizeof(*bitmaps));
+
+  for (uint32_t i = 0; i < n; i++) {
+    Bitmap64* bitmap;
+    RedisModuleKey* key;
+    if (TryGetBitmapKey(ctx, argv[2 + i], &bitmap, &key, REDISMODULE_READ) == REDISMODULE_ERR) {
+      rm_free(bitmaps);
+      return REDISMODULE_ERR;
+    }
+    bitmaps[i] = bitmap;
+  }
+
+  Bitmap64* result = bitmap64_alloc();
+  BITOP_OPERATIONS[operation](result, n, bitmaps);
+  rm_free(bitmaps);
+
+  uint64_t count = bitmap64_get_cardinality(result);
+  if (count > limit) {
+    count = limit;
+  }
+
+  if (count > BITMAP64_MAX_RANGE_SIZE) {
+    bitmap64_free(result);
+    return ReplyWithErrorFmt(ctx, ERRORMSG_RANGE_LIMIT, BITMAP64_MAX_RANGE_SIZE);
+  }
+
+  RedisModule_ReplyWithArray(ctx, (long) count);
+  if (count > 0) {
+    BitOpGetReplyState state = {.ctx = ctx, .remaining = count};
+    roaring64_bitmap_iterate(result, BitOpGetReplyValue, &state);
+  }
+
+  bitmap64_free(result);
+  return REDISMODULE_OK;
+}
+
 /**
  * R64.BITCOUNT <key>
  * */
@@ -932,13 +1632,7 @@ int R64BitCountCommand(RedisModuleCtx* ctx, RedisModuleString** argv, int argc)
     return REDISMODULE_ERR;
   }
 
-  if (bitmap == BITMAP64_NILL) {
-    return ReplyWithUint64(ctx, 0);
-  }
-
-  uint64_t count = bitmap64_get_cardinality(bitmap);
-
-  return ReplyWithUint64(ctx, count);
+  return ReplyWithUint64(ctx, BitmapCardinality(bitmap));
 }
 
 /**
@@ -1051,6 +1745,7 @@ int R64ClearCommand(RedisModuleCtx* ctx, RedisModuleString** argv, int argc) {
   if (count > 0) {
     roaring64_bitmap_clear(bitmap);
   }
+  cardinality_cache_adjust(bitmap, -(int64_t) count);
 
   RedisModule_ReplicateVerbatim(ctx);
   return RedisModule_ReplyWithLongLong(ctx, (long long) count);
@@ -1122,8 +1817,346 @@ int R64JaccardCommand(RedisModuleCtx* ctx, RedisModuleString** argv, int argc) {
   }
 
   uint64_t intersection = roaring64_bitmap_and_cardinality(b1, b2);
-  uint64_t union_count = roaring64_bitmap_or_cardinality(b1, b2);
-  return ReplyWithJaccardRatio(ctx, intersection, union_count);
+  return ReplyWithJaccardRatio(ctx, intersection, BitmapCardinality(b1) + BitmapCardinality(b2) - intersection);
+}
+
+/**
+ * Replies with the similarity of two bitmaps from their intersection and cardinalities,
+ * -1 when the metric is undefined (empty bitmaps)
+ */
+static int ReplyWithSimilarity(RedisModuleCtx* ctx, SimilarityMetric metric, uint64_t intersection, uint64_t card1,
+                               uint64_t card2) {
+  switch (metric) {
+    case SIMILARITY_JACCARD:
+      return ReplyWithJaccardRatio(ctx, intersection, card1 + card2 - intersection);
+    case SIMILARITY_OVERLAP:
+      return ReplyWithJaccardRatio(ctx, intersection, card1 < card2 ? card1 : card2);
+    case SIMILARITY_COSINE:
+      if (card1 == 0 || card2 == 0) {
+        return RedisModule_ReplyWithStringBuffer(ctx, "-1", 2);
+      }
+      return RedisModule_ReplyWithDouble(ctx, similarity_score(metric, intersection, card1, card2));
+    case SIMILARITY_INTERSECTION:
+      return ReplyWithUint64(ctx, intersection);
+  }
+
+  return REDISMODULE_ERR;
+}
+
+typedef struct {
+  uint32_t n;
+  const Bitmap64** bitmaps;
+  uint32_t first_row;
+  uint32_t row_step;
+  uint64_t* matrix;
+} SimilarityRows;
+
+static void SimilarityRowsRun(void* arg) {
+  SimilarityRows* rows = arg;
+  bitmap64_intersection_matrix_rows(rows->n, rows->bitmaps, rows->first_row, rows->row_step, rows->matrix);
+}
+
+/**
+ * R64.SIMILARITY <key> [<key> ...] [METRIC <JACCARD|OVERLAP|COSINE|INTERSECTION>]
+ * Replies with the n x n similarity matrix of the keys, JACCARD by default
+ * */
+int R64SimilarityCommand(RedisModuleCtx* ctx, RedisModuleString** argv, int argc) {
+  if (argc < 2) {
+    return (RedisModule_IsKeysPositionRequest(ctx) > 0) ? REDISMODULE_OK : RedisModule_WrongArity(ctx);
+  }
+
+  RedisModule_AutoMemory(ctx);
+  int keys_end = SimilarityKeysEnd(argc, RedisModule_StringPtrLen(argv[argc - 2], NULL));
+
+  if (RedisModule_IsKeysPositionRequest(ctx) > 0) {
+    for (int pos = 1; pos < keys_end; pos++) {
+      BitOpReportRedisKey(ctx, pos, REDISMODULE_CMD_KEY_RO | REDISMODULE_CMD_KEY_ACCESS);
+    }
+    return REDISMODULE_OK;
+  }
+
+  SimilarityMetric metric = SIMILARITY_JACCARD;
+  if (keys_end < argc) {
+    const char* name = RedisModule_StringPtrLen(argv[argc - 1], NULL);
+    if (!similarity_parse_metric(name, &metric)) {
+      return ReplyWithErrorFmt(ctx, "ERR invalid metric argument: %s", name);
+    }
+  }
+
+  uint32_t n = (uint32_t) (keys_end - 1);
+  if (n > BITMAP64_SIMILARITY_MAX_KEYS) {
+    return ReplyWithErrorFmt(ctx, "ERR too many keys: maximum %d", BITMAP64_SIMILARITY_MAX_KEYS);
+  }
+
+  const Bitmap64** bitmaps = rm_malloc(n * sizeof(*bitmaps));
+  for (uint32_t i = 0; i < n; i++) {
+    Bitmap64* bitmap;
+    RedisModuleKey* key;
+    if (TryGetBitmapKey(ctx, argv[1 + i], &bitmap, &key, REDISMODULE_READ) == REDISMODULE_ERR) {
+      rm_free(bitmaps);
+      return REDISMODULE_ERR;
+    }
+    bitmaps[i] = bitmap;
+  }
+
+  // The diagonal comes from the cached cardinalities, which are only touched on the main thread
+  uint64_t* matrix = rm_malloc((uint64_t) n * n * sizeof(*matrix));
+  for (uint32_t i = 0; i < n; i++) {
+    matrix[(uint64_t) i * n + i] = BitmapCardinality(bitmaps[i]);
+  }
+
+  // Rows are interleaved over the tasks, row i only computes the n - i - 1 pairs right of the diagonal
+  uint32_t n_tasks = n >= BITMAP64_SIMILARITY_PARALLEL_MIN_KEYS ? thread_pool_size() + 1 : 1;
+  SimilarityRows* tasks = rm_malloc(n_tasks * sizeof(*tasks));
+  void** args = rm_malloc(n_tasks * sizeof(*args));
+  for (uint32_t i = 0; i < n_tasks; i++) {
+    tasks[i] = (SimilarityRows) {
+        .n = n,
+        .bitmaps = bitmaps,
+        .first_row = i,
+        .row_step = n_tasks,
+        .matrix = matrix
+    };
+    args[i] = &tasks[i];
+  }
+  thread_pool_run(SimilarityRowsRun, args, n_tasks);
+  rm_free(args);
+  rm_free(tasks);
+  rm_free(bitmaps);
+
+  RedisModule_ReplyWithArray(ctx, n);
+  for (uint32_t i = 0; i < n; i++) {
+    RedisModule_ReplyWithArray(ctx, n);
+    for (uint32_t j = 0; j < n; j++) {
+      uint64_t card1 = matrix[(uint64_t) i * n + i];
+      uint64_t card2 = matrix[(uint64_t) j * n + j];
+      ReplyWithSimilarity(ctx, metric, matrix[(uint64_t) i * n + j], card1, card2);
+    }
+  }
+
+  rm_free(matrix);
+  return REDISMODULE_OK;
+}
+
+typedef struct {
+  RedisModuleCtx* ctx;
+  RedisModuleString* query_name;
+  const Bitmap64* query;
+  uint64_t query_cardinality;
+  SimilarityMetric metric;
+  SimilarityTopK topk;
+  // Caller of the command, NULL when it isn't restricted
+  RedisModuleUser* user;
+} TopKSearch;
+
+/**
+ * Scores a candidate unless its cardinality already rules it out of the top K. Returns true if it was kept.
+ */
+static bool TopKConsider(TopKSearch* search, RedisModuleString* name, const Bitmap64* candidate) {
+  uint64_t cardinality = BitmapCardinality(candidate);
+  double upper_bound = similarity_upper_bound(search->metric, search->query_cardinality, cardinality);
+  if (!similarity_topk_accepts(&search->topk, upper_bound)) {
+    return false;
+  }
+
+  uint64_t intersection = roaring64_bitmap_and_cardinality(search->query, candidate);
+  double score = similarity_score(search->metric, intersection, search->query_cardinality, cardinality);
+  if (!similarity_topk_accepts(&search->topk, score)) {
+    return false;
+  }
+
+  similarity_topk_push(&search->topk, (SimilarityCandidate) {
+      .score = score,
+      .intersection = intersection,
+      .cardinality = cardinality,
+      .item = name
+  });
+  return true;
+}
+
+/**
+ * Considers a candidate found by MATCH or MEMBERS: missing keys, keys of another type, keys the
+ * caller may not read and the query itself are skipped. These candidates are not declared as command
+ * keys, so their ACL is checked here.
+ */
+static void TopKConsiderReply(TopKSearch* search, RedisModuleCallReply* element) {
+  RedisModuleString* name = RedisModule_CreateStringFromCallReply(element);
+  if (name == NULL) {
+    return;
+  }
+
+  bool kept = false;
+  bool allowed = search->user == NULL
+      || RedisModule_ACLCheckKeyPermissions(search->user, name, REDISMODULE_CMD_KEY_ACCESS) == REDISMODULE_OK;
+  if (allowed && RedisModule_StringCompare(name, search->query_name) != 0) {
+    RedisModuleKey* key = RedisModule_OpenKey(search->ctx, name, REDISMODULE_READ);
+    if (RedisModule_KeyType(key) == REDISMODULE_KEYTYPE_MODULE && RedisModule_ModuleTypeGetType(key) == Bitmap64Type) {
+      kept = TopKConsider(search, name, RedisModule_ModuleTypeGetValue(key));
+    }
+    RedisModule_CloseKey(key);
+  }
+
+  if (!kept) {
+    RedisModule_FreeString(search->ctx, name);
+  }
+}
+
+/**
+ * Scans about `count` keys of the keyspace, as the sum of the SCAN COUNT hints, so a single call can't
+ * walk a large keyspace
+ */
+static int TopKScanMatch(TopKSearch* search, RedisModuleString* pattern, uint64_t count) {
+  RedisModuleString* cursor = RedisModule_CreateString(search->ctx, "0", 1);
+  uint64_t remaining = count;
+  while (remaining > 0) {
+    uint64_t step = remaining < BITMAP64_TOPK_SCAN_STEP ? remaining : BITMAP64_TOPK_SCAN_STEP;
+    remaining -= step;
+    RedisModuleCallReply* reply = RedisModule_Call(
+        search->ctx, "SCAN", "scsclcc", cursor, "MATCH", pattern, "COUNT", (long long) step, "TYPE", "roaring64");
+    if (reply == NULL || RedisModule_CallReplyType(reply) != REDISMODULE_REPLY_ARRAY) {
+      return REDISMODULE_ERR;
+    }
+
+    RedisModule_FreeString(search->ctx, cursor);
+    cursor = RedisModule_CreateStringFromCallReply(RedisModule_CallReplyArrayElement(reply, 0));
+    RedisModuleCallReply* keys = RedisModule_CallReplyArrayElement(reply, 1);
+    for (size_t i = 0; i < RedisModule_CallReplyLength(keys); i++) {
+      TopKConsiderReply(search, RedisModule_CallReplyArrayElement(keys, i));
+    }
+    RedisModule_FreeCallReply(reply);
+    if (strcmp(RedisModule_StringPtrLen(cursor, NULL), "0") == 0) {
+      break;
+    }
+  }
+
+  return REDISMODULE_OK;
+}
+
+static void TopKSearchFree(TopKSearch* search) {
+  similarity_topk_free(&search->topk);
+  if (search->user != NULL) {
+    RedisModule_FreeModuleUser(search->user);
+  }
+}
+
+static int TopKScanMembers(TopKSearch* search, RedisModuleString* set) {
+  RedisModuleCallReply* reply = RedisModule_Call(search->ctx, "SMEMBERS", "s", set);
+  if (reply == NULL || RedisModule_CallReplyType(reply) != REDISMODULE_REPLY_ARRAY) {
+    return REDISMODULE_ERR;
+  }
+
+  for (size_t i = 0; i < RedisModule_CallReplyLength(reply); i++) {
+    TopKConsiderReply(search, RedisModule_CallReplyArrayElement(reply, i));
+  }
+  RedisModule_FreeCallReply(reply);
+
+  return REDISMODULE_OK;
+}
+
+/**
+ * R64.TOPK <query> <k> <candidate> [<candidate> ...] [METRIC <JACCARD|OVERLAP|COSINE|INTERSECTION>]
+ * R64.TOPK <query> <k> MATCH <pattern> COUNT <count> [METRIC <...>]
+ * R64.TOPK <query> <k> MEMBERS <setkey> [METRIC <...>]
+ * Replies with the k candidates most similar to the query as key, score pairs, best first
+ * */
+int R64TopKCommand(RedisModuleCtx* ctx, RedisModuleString** argv, int argc) {
+  if (argc < 4) {
+    return (RedisModule_IsKeysPositionRequest(ctx) > 0) ? REDISMODULE_OK : RedisModule_WrongArity(ctx);
+  }
+
+  RedisModule_AutoMemory(ctx);
+  const char* source_name = RedisModule_StringPtrLen(argv[3], NULL);
+  const char* option = argc > 5 ? RedisModule_StringPtrLen(argv[5], NULL) : NULL;
+  const char* before_last = RedisModule_StringPtrLen(argv[argc - 2], NULL);
+
+  if (RedisModule_IsKeysPositionRequest(ctx) > 0) {
+    TopKForEachKeyPosition(argc, source_name, option, before_last, ctx, BitOpReportRedisKey);
+    return REDISMODULE_OK;
+  }
+
+  int keys_end = TopKKeysEnd(argc, before_last);
+  TopKSource source = TopKParseSource(keys_end, source_name, option);
+
+  uint32_t k;
+  ParseUint32OrReturn(ctx, argv[2], "k", k);
+
+  // MATCH has to bound its walk of the keyspace
+  uint64_t count = 0;
+  if (source == TOPK_SOURCE_MATCH) {
+    if (keys_end != 7) {
+      return RedisModule_ReplyWithError(ctx, "ERR syntax error: MATCH requires COUNT");
+    }
+    ParseUint64OrReturn(ctx, argv[6], "count", count);
+  }
+
+  SimilarityMetric metric = SIMILARITY_JACCARD;
+  if (keys_end < argc) {
+    const char* name = RedisModule_StringPtrLen(argv[argc - 1], NULL);
+    if (!similarity_parse_metric(name, &metric)) {
+      return ReplyWithErrorFmt(ctx, "ERR invalid metric argument: %s", name);
+    }
+  }
+
+  Bitmap64* query;
+  RedisModuleKey* query_key;
+  if (TryGetBitmapKey(ctx, argv[1], &query, &query_key, REDISMODULE_READ) == REDISMODULE_ERR) {
+    return REDISMODULE_ERR;
+  }
+
+  TopKSearch search = {
+      .ctx = ctx,
+      .query_name = argv[1],
+      .query = query,
+      .query_cardinality = BitmapCardinality(query),
+      .metric = metric
+  };
+
+  if (source != TOPK_SOURCE_KEYS) {
+    RedisModuleString* user_name = RedisModule_GetCurrentUserName(ctx);
+    if (user_name != NULL) {
+      search.user = RedisModule_GetModuleUserFromUserName(user_name);
+      if (search.user == NULL) {
+        return RedisModule_ReplyWithError(ctx, "ERR could not check the permissions of the current user");
+      }
+    }
+  }
+  similarity_topk_init(&search.topk, k);
+
+  int status = REDISMODULE_OK;
+  if (source == TOPK_SOURCE_MATCH) {
+    status = TopKScanMatch(&search, argv[4], count);
+  } else if (source == TOPK_SOURCE_MEMBERS) {
+    status = TopKScanMembers(&search, argv[4]);
+  } else {
+    for (int i = 3; i < keys_end; i++) {
+      Bitmap64* candidate;
+      RedisModuleKey* key;
+      if (TryGetBitmapKey(ctx, argv[i], &candidate, &key, REDISMODULE_READ) == REDISMODULE_ERR) {
+        TopKSearchFree(&search);
+        return REDISMODULE_ERR;
+      }
+      TopKConsider(&search, argv[i], candidate);
+    }
+  }
+
+  if (status == REDISMODULE_ERR) {
+    TopKSearchFree(&search);
+    return RedisModule_ReplyWithError(ctx, source == TOPK_SOURCE_MATCH
+        ? "ERR could not scan the keyspace"
+        : REDISMODULE_ERRORMSG_WRONGTYPE);
+  }
+
+  similarity_topk_sort(&search.topk);
+
+  RedisModule_ReplyWithArray(ctx, 2 * search.topk.size);
+  for (uint32_t i = 0; i < search.topk.size; i++) {
+    SimilarityCandidate* candidate = &search.topk.heap[i];
+    RedisModule_ReplyWithString(ctx, candidate->item);
+    ReplyWithSimilarity(ctx, metric, candidate->intersection, search.query_cardinality, candidate->cardinality);
+  }
+
+  TopKSearchFree(&search);
+  return REDISMODULE_OK;
 }
 
 void R64Module_onShutdown(RedisModuleCtx* ctx, RedisModuleEvent e, uint64_t sub, void* data) {
@@ -1139,7 +2172,9 @@ int R64Module_onLoad(RedisModuleCtx* ctx, RedisModuleString** argv, int argc) {
       .rdb_save = Bitmap64RdbSave,
       .aof_rewrite = Bitmap64AofRewrite,
       .mem_usage = Bitmap64MemUsage,
-      .free = Bitmap64Free
+      .free = Bitmap64Free,
+      .free_effort = Bitmap64FreeEffort,
+      .unlink = Bitmap64Unlink
   };
 
   Bitmap64Type = RedisModule_CreateDataType(ctx, "roaring64", BITMAP64_ENCODING_VERSION, &tm);
@@ -1160,6 +2195,11 @@ int R64Module_onLoad(RedisModuleCtx* ctx, RedisModuleString** argv, int argc) {
   RegisterCommand(ctx, "R64.SETINTARRAY", R64SetIntArrayCommand, "write", "write");
   RegisterCommand(ctx, "R64.GETINTARRAY", R64GetIntArrayCommand, "readonly", "read");
   RegisterCommand(ctx, "R64.RANGEINTARRAY", R64RangeIntArrayCommand, "readonly", "read");
+  RegisterCommand(ctx, "R64.SCAN", R64ScanCommand, "readonly", "read");
+  RegisterCommand(ctx, "R64.RANGEBYVALUE", R64RangeByValueCommand, "readonly", "read");
+  RegisterCommand(ctx, "R64.COUNTRANGE", R64CountRangeCommand, "readonly", "read");
+  RegisterCommand(ctx, "R64.RANK", R64RankCommand, "readonly", "read");
+  RegisterCommand(ctx, "R64.SELECT", R64SelectCommand, "readonly", "read");
   RegisterCommand(ctx, "R64.APPENDINTARRAY", R64AppendIntArrayCommand, "write", "write");
   RegisterCommand(ctx, "R64.DELETEINTARRAY", R64DeleteIntArrayCommand, "write", "write");
   RegisterCommand(ctx, "R64.DIFF", R64DiffCommand, "write", "write");
@@ -1168,7 +2208,11 @@ int R64Module_onLoad(RedisModuleCtx* ctx, RedisModuleString** argv, int argc) {
   RegisterCommand(ctx, "R64.OPTIMIZE", R64OptimizeBitCommand, "readonly", "read");
   RegisterCommand(ctx, "R64.SETBITARRAY", R64SetBitArrayCommand, "write", "write");
   RegisterCommand(ctx, "R64.GETBITARRAY", R64GetBitArrayCommand, "readonly", "read");
+  RegisterCommand(ctx, "R64.GETSERIALIZED", R64GetSerializedCommand, "readonly", "read");
+  RegisterCommand(ctx, "R64.SETSERIALIZED", R64SetSerializedCommand, "write", "write");
   RegisterCommand(ctx, "R64.BITOP", R64BitOpCommand, "write getkeys-api", "write");
+  RegisterCommand(ctx, "R64.BITOPCARD", R64BitOpCardCommand, "readonly getkeys-api", "read");
+  RegisterCommand(ctx, "R64.BITOPGET", R64BitOpGetCommand, "readonly getkeys-api", "read");
   RegisterCommand(ctx, "R64.BITCOUNT", R64BitCountCommand, "readonly", "read");
   RegisterCommand(ctx, "R64.BITPOS", R64BitPosCommand, "readonly", "read");
   RegisterCommand(ctx, "R64.MIN", R64MinCommand, "readonly", "read");
@@ -1176,6 +2220,8 @@ int R64Module_onLoad(RedisModuleCtx* ctx, RedisModuleString** argv, int argc) {
   RegisterCommand(ctx, "R64.CLEAR", R64ClearCommand, "write", "write");
   RegisterCommand(ctx, "R64.CONTAINS", R64ContainsCommand, "readonly", "read");
   RegisterCommand(ctx, "R64.JACCARD", R64JaccardCommand, "readonly", "read");
+  RegisterCommand(ctx, "R64.SIMILARITY", R64SimilarityCommand, "readonly getkeys-api", "read");
+  RegisterCommand(ctx, "R64.TOPK", R64TopKCommand, "readonly getkeys-api", "read");
   RegisterCommand(ctx, "R64.CLEARBITS", R64ClearBitsCommand, "write", "write");
 
   if (RegisterR64CommandInfos(ctx) != REDISMODULE_OK) {
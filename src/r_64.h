@@ -2,12 +2,38 @@
 
 #include "redismodule.h"
 #include "data-structure.h"
+#include "optimizer.h"
 
-#define BITMAP64_ENCODING_VERSION 1
+// encver 1: a single portable buffer
+// encver 2: chunk count followed by portable chunks of up to BITMAP64_RDB_CHUNK_CONTAINERS containers
+#define BITMAP64_ENCODING_VERSION_PORTABLE 1
+#define BITMAP64_ENCODING_VERSION 2
+#define BITMAP64_RDB_CHUNK_CONTAINERS 256
 #define BITMAP64_MAX_RANGE_SIZE 100000000
+#define BITMAP64_SCAN_DEFAULT_COUNT 10
+// R64.BITOP replicates its result instead of the command once the serialized sources reach this size,
+// provided the result serializes smaller and the command reaches an AOF or a replica
+#define BITMAP64_BITOP_REPLICATE_RESULT_MIN_BYTES 65536
+// R64.SIMILARITY: largest matrix, and smallest one whose rows are split over the worker pool
+#define BITMAP64_SIMILARITY_MAX_KEYS 4096
+#define BITMAP64_SIMILARITY_PARALLEL_MIN_KEYS 32
+// R64.TOPK MATCH: COUNT hint of each SCAN call, the command COUNT bounds their sum
+#define BITMAP64_TOPK_SCAN_STEP 1000
+// Background optimizer: bitmaps smaller than this are left alone
+#define BITMAP64_COMPACT_MIN_BYTES 4096
+// Free effort: containers counted at most, lazyfree only compares the effort with a small threshold
+#define BITMAP64_FREE_EFFORT_MAX_CONTAINERS 1024
+// AOF rewrite: values per R64.APPENDINTARRAY, and shortest run emitted as R64.SETRANGE
+#define BITMAP64_AOF_BATCH_SIZE 1024
+#define BITMAP64_AOF_MIN_RANGE 16
 
 extern RedisModuleType* Bitmap64Type;
 extern Bitmap64* BITMAP64_NILL;
 
 int R64Module_onLoad(RedisModuleCtx* ctx, RedisModuleString** argv, int argc);
+/**
+ * Background optimizer step: compacts a bitmap stored in the keyspace unless it is small, larger than
+ * `max_bytes` (when not 0) or was not opened for writing since it was last compacted.
+ */
+OptimizerCompactResult Bitmap64BackgroundCompact(Bitmap64* bitmap, uint64_t max_bytes, size_t* reclaimed);
 void R64Module_onShutdown(RedisModuleCtx* ctx, RedisModuleEvent e, uint64_t sub, void* data);
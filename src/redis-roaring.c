@@ -6,6 +6,9 @@
 #include "cmd_info/command_info.h"
 #include "parse.h"
 #include "version.h"
+#include "thread-pool.h"
+#include "cardinality-cache.h"
+#include "optimizer.h"
 
 int RStatBitCommand(RedisModuleCtx* ctx, RedisModuleString** argv, int argc) {
   int output_format = BITMAP_STATISTICS_FORMAT_PLAIN_TEXT;
@@ -59,10 +62,94 @@ void RedisModule_OnShutdown(RedisModuleCtx* ctx, RedisModuleEvent e, uint64_t su
   REDISMODULE_NOT_USED(data);
   REDISMODULE_NOT_USED(sub);
 
+  thread_pool_stop();
   R32Module_onShutdown(ctx, e, sub, data);
   R64Module_onShutdown(ctx, e, sub, data);
 }
 
+static uint32_t OnlineReplicas = 0;
+
+static void OnReplicaChange(RedisModuleCtx* ctx, RedisModuleEvent e, uint64_t sub, void* data) {
+  REDISMODULE_NOT_USED(ctx);
+  REDISMODULE_NOT_USED(e);
+  REDISMODULE_NOT_USED(data);
+
+  if (sub == REDISMODULE_SUBEVENT_REPLICA_CHANGE_ONLINE) {
+    OnlineReplicas++;
+  } else if (sub == REDISMODULE_SUBEVENT_REPLICA_CHANGE_OFFLINE && OnlineReplicas > 0) {
+    OnlineReplicas--;
+  }
+}
+
+bool ReplicationStreamActive(RedisModuleCtx* ctx) {
+  return OnlineReplicas > 0 || (RedisModule_GetContextFlags(ctx) & REDISMODULE_CTX_FLAGS_AOF) != 0;
+}
+
+static void RoaringDefrag(RedisModuleDefragCtx* ctx) {
+  cardinality_cache_defrag(ctx);
+}
+
+static void RoaringInfo(RedisModuleInfoCtx* ctx, int for_crash_report) {
+  REDISMODULE_NOT_USED(for_crash_report);
+  optimizer_info(ctx);
+}
+
+typedef struct {
+  uint32_t threads;
+  uint32_t optimize_interval;
+  uint32_t optimize_budget;
+  uint64_t optimize_max_bytes;
+} ModuleArgs;
+
+/**
+ * Module arguments, an unknown argument or an invalid value is logged and ignored so that older
+ * configurations keep loading:
+ * - `THREADS <n>` sets the number of worker threads used by heavy commands, 0 runs everything on
+ *   the main thread. Defaults to 0.
+ * - `BACKGROUND_THRESHOLD <n>` runs heavy commands over at least n elements on the worker threads,
+ *   blocking only the calling client. Defaults to 0 (disabled).
+ * - `OPTIMIZE_INTERVAL <ms>` runs the background optimizer every ms milliseconds: it walks the
+ *   keyspace a step at a time and compacts the bitmaps written since its last visit. Defaults to 0
+ *   (disabled).
+ * - `OPTIMIZE_BUDGET <ms>` bounds the time spent by each step of the background optimizer, a single
+ *   bitmap is always compacted at once so the cap below bounds the overrun. Defaults to 2.
+ * - `OPTIMIZE_MAX_BYTES <n>` leaves the bitmaps larger than n bytes to R.OPTIMIZE, since compacting
+ *   one of them would overrun the budget of a step; 0 lifts the cap. Defaults to 1 MiB.
+ */
+static void ParseModuleArgs(RedisModuleCtx* ctx, RedisModuleString** argv, int argc, ModuleArgs* args) {
+  args->threads = 0;
+  args->optimize_interval = 0;
+  args->optimize_budget = 2;
+  args->optimize_max_bytes = OPTIMIZER_DEFAULT_MAX_BYTES;
+
+  for (int i = 0; i < argc; i++) {
+    const char* arg = RedisModule_StringPtrLen(argv[i], NULL);
+    if (strcmp(arg, "THREADS") == 0 && i + 1 < argc) {
+      if (!StrToUInt32(argv[++i], &args->threads)) {
+        RedisModule_Log(ctx, "warning", "Ignoring invalid THREADS argument: must be an unsigned 32 bit integer");
+      }
+    } else if (strcmp(arg, "BACKGROUND_THRESHOLD") == 0 && i + 1 < argc) {
+      if (!StrToUInt64(argv[++i], &BitmapBackgroundThreshold)) {
+        RedisModule_Log(ctx, "warning", "Ignoring invalid BACKGROUND_THRESHOLD argument: must be an unsigned 64 bit integer");
+      }
+    } else if (strcmp(arg, "OPTIMIZE_INTERVAL") == 0 && i + 1 < argc) {
+      if (!StrToUInt32(argv[++i], &args->optimize_interval)) {
+        RedisModule_Log(ctx, "warning", "Ignoring invalid OPTIMIZE_INTERVAL argument: must be an unsigned 32 bit integer");
+      }
+    } else if (strcmp(arg, "OPTIMIZE_BUDGET") == 0 && i + 1 < argc) {
+      if (!StrToUInt32(argv[++i], &args->optimize_budget)) {
+        RedisModule_Log(ctx, "warning", "Ignoring invalid OPTIMIZE_BUDGET argument: must be an unsigned 32 bit integer");
+      }
+    } else if (strcmp(arg, "OPTIMIZE_MAX_BYTES") == 0 && i + 1 < argc) {
+      if (!StrToUInt64(argv[++i], &args->optimize_max_bytes)) {
+        RedisModule_Log(ctx, "warning", "Ignoring invalid OPTIMIZE_MAX_BYTES argument: must be an unsigned 64 bit integer");
+      }
+    } else {
+      RedisModule_Log(ctx, "warning", "Ignoring unknown module argument: %s", arg);
+    }
+  }
+}
+
 int RedisModule_OnLoad(RedisModuleCtx* ctx, RedisModuleString** argv, int argc) {
   // Register the module itself
   if (RedisModule_Init(ctx, REDISROARING_MODULE_NAME, REDISROARING_MODULE_VERSION, REDISMODULE_APIVER_1) == REDISMODULE_ERR) {
@@ -74,7 +161,11 @@ int RedisModule_OnLoad(RedisModuleCtx* ctx, RedisModuleString** argv, int argc)
     "RedisRoaring version %d",
     REDISROARING_MODULE_VERSION);
 
+  ModuleArgs args;
+  ParseModuleArgs(ctx, argv, argc, &args);
+
   RedisModule_SubscribeToServerEvent(ctx, RedisModuleEvent_Shutdown, RedisModule_OnShutdown);
+  RedisModule_SubscribeToServerEvent(ctx, RedisModuleEvent_ReplicaChange, OnReplicaChange);
 
   // Setup roaring with Redis trackable memory allocation wrapper
   roaring_memory_t roaring_memory_hook = {
@@ -88,6 +179,13 @@ int RedisModule_OnLoad(RedisModuleCtx* ctx, RedisModuleString** argv, int argc)
 
   roaring_init_memory_hook(roaring_memory_hook);
 
+  if (!thread_pool_start(args.threads)) {
+    RedisModule_Log(ctx, "warning", "Failed to start the worker threads");
+    return REDISMODULE_ERR;
+  }
+
+  cardinality_cache_init();
+
   if (R32Module_onLoad(ctx, argv, argc) == REDISMODULE_ERR) {
     return REDISMODULE_ERR;
   }
@@ -108,5 +206,15 @@ int RedisModule_OnLoad(RedisModuleCtx* ctx, RedisModuleString** argv, int argc)
   }
 #undef RegisterCommand
 
+  if (RedisModule_RegisterInfoFunc(ctx, RoaringInfo) == REDISMODULE_ERR) {
+    return REDISMODULE_ERR;
+  }
+
+  if (RedisModule_RegisterDefragFunc(ctx, RoaringDefrag) == REDISMODULE_ERR) {
+    return REDISMODULE_ERR;
+  }
+
+  optimizer_start(ctx, args.optimize_interval, args.optimize_budget, args.optimize_max_bytes);
+
   return REDISMODULE_OK;
 }
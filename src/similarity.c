@@ -0,0 +1,137 @@
+#include "similarity.h"
+#include <math.h>
+#include <string.h>
+#include "rmalloc.h"
+
+bool similarity_parse_metric(const char* name, SimilarityMetric* metric) {
+  if (strcmp(name, "JACCARD") == 0) {
+    *metric = SIMILARITY_JACCARD;
+  } else if (strcmp(name, "OVERLAP") == 0) {
+    *metric = SIMILARITY_OVERLAP;
+  } else if (strcmp(name, "COSINE") == 0) {
+    *metric = SIMILARITY_COSINE;
+  } else if (strcmp(name, "INTERSECTION") == 0) {
+    *metric = SIMILARITY_INTERSECTION;
+  } else {
+    return false;
+  }
+
+  return true;
+}
+
+double similarity_score(SimilarityMetric metric, uint64_t intersection, uint64_t card1, uint64_t card2) {
+  switch (metric) {
+    case SIMILARITY_JACCARD: {
+      uint64_t union_count = card1 + card2 - intersection;
+      return union_count == 0 ? -1 : (double) intersection / (double) union_count;
+    }
+    case SIMILARITY_OVERLAP: {
+      uint64_t smallest = card1 < card2 ? card1 : card2;
+      return smallest == 0 ? -1 : (double) intersection / (double) smallest;
+    }
+    case SIMILARITY_COSINE:
+      if (card1 == 0 || card2 == 0) {
+        return -1;
+      }
+      return (double) intersection / sqrt((double) card1 * (double) card2);
+    case SIMILARITY_INTERSECTION:
+      return (double) intersection;
+  }
+
+  return -1;
+}
+
+double similarity_upper_bound(SimilarityMetric metric, uint64_t card1, uint64_t card2) {
+  uint64_t smallest = card1 < card2 ? card1 : card2;
+  return similarity_score(metric, smallest, card1, card2);
+}
+
+void similarity_topk_init(SimilarityTopK* topk, uint32_t k) {
+  topk->k = k;
+  topk->size = 0;
+  topk->capacity = 0;
+  topk->heap = NULL;
+}
+
+void similarity_topk_free(SimilarityTopK* topk) {
+  rm_free(topk->heap);
+  topk->heap = NULL;
+  topk->size = 0;
+  topk->capacity = 0;
+}
+
+bool similarity_topk_accepts(const SimilarityTopK* topk, double score) {
+  if (topk->k == 0) {
+    return false;
+  }
+
+  return topk->size < topk->k || score > topk->heap[0].score;
+}
+
+static void SiftDown(SimilarityCandidate* heap, uint32_t size, uint32_t i) {
+  while (true) {
+    uint32_t smallest = i;
+    uint32_t left = 2 * i + 1;
+    uint32_t right = left + 1;
+    if (left < size && heap[left].score < heap[smallest].score) {
+      smallest = left;
+    }
+    if (right < size && heap[right].score < heap[smallest].score) {
+      smallest = right;
+    }
+    if (smallest == i) {
+      return;
+    }
+
+    SimilarityCandidate tmp = heap[i];
+    heap[i] = heap[smallest];
+    heap[smallest] = tmp;
+    i = smallest;
+  }
+}
+
+void similarity_topk_push(SimilarityTopK* topk, SimilarityCandidate candidate) {
+  if (!similarity_topk_accepts(topk, candidate.score)) {
+    return;
+  }
+
+  if (topk->size == topk->k) {
+    // Replace the lowest score
+    topk->heap[0] = candidate;
+    SiftDown(topk->heap, topk->size, 0);
+    return;
+  }
+
+  // The heap only grows with the candidates actually seen, K may be far above their count
+  if (topk->size == topk->capacity) {
+    uint32_t capacity = topk->capacity == 0 ? 16 : topk->capacity * 2;
+    if (capacity > topk->k) {
+      capacity = topk->k;
+    }
+    topk->heap = rm_realloc(topk->heap, capacity * sizeof(*topk->heap));
+    topk->capacity = capacity;
+  }
+
+  uint32_t i = topk->size++;
+  topk->heap[i] = candidate;
+  while (i > 0) {
+    uint32_t parent = (i - 1) / 2;
+    if (topk->heap[parent].score <= topk->heap[i].score) {
+      break;
+    }
+    SimilarityCandidate tmp = topk->heap[i];
+    topk->heap[i] = topk->heap[parent];
+    topk->heap[parent] = tmp;
+    i = parent;
+  }
+}
+
+void similarity_topk_sort(SimilarityTopK* topk) {
+  // Repeatedly move the minimum to the end, leaving the array in decreasing order
+  for (uint32_t end = topk->size; end > 1; end--) {
+    SimilarityCandidate tmp = topk->heap[0];
+    topk->heap[0] = topk->heap[end - 1];
+    topk->heap[end - 1] = tmp;
+    SiftDown(topk->heap, end - 1, 0);
+  }
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef enum {
+  SIMILARITY_JACCARD,
+  SIMILARITY_OVERLAP,
+  SIMILARITY_COSINE,
+  SIMILARITY_INTERSECTION
+} SimilarityMetric;
+
+typedef struct {
+  double score;
+  uint64_t intersection;
+  uint64_t cardinality;
+  void* item;
+} SimilarityCandidate;
+
+/**
+ * Bounded min-heap keeping the `k` candidates with the highest score
+ */
+typedef struct {
+  uint32_t k;
+  uint32_t size;
+  uint32_t capacity;
+  SimilarityCandidate* heap;
+} SimilarityTopK;
+
+/**
+ * Parses JACCARD, OVERLAP, COSINE or INTERSECTION
+ */
+bool similarity_parse_metric(const char* name, SimilarityMetric* metric);
+/**
+ * Similarity of two sets from their intersection and cardinalities, -1 when the metric is undefined
+ * (empty sets)
+ */
+double similarity_score(SimilarityMetric metric, uint64_t intersection, uint64_t card1, uint64_t card2);
+/**
+ * Highest score two sets with these cardinalities can reach, when one contains the other
+ */
+double similarity_upper_bound(SimilarityMetric metric, uint64_t card1, uint64_t card2);
+
+void similarity_topk_init(SimilarityTopK* topk, uint32_t k);
+void similarity_topk_free(SimilarityTopK* topk);
+/**
+ * Whether a candidate with `score` would enter the heap, used to skip candidates by their upper bound
+ */
+bool similarity_topk_accepts(const SimilarityTopK* topk, double score);
+void similarity_topk_push(SimilarityTopK* topk, SimilarityCandidate candidate);
+/**
+ * Sorts the kept candidates by decreasing score, the heap can only be freed afterwards
+ */
+void similarity_topk_sort(SimilarityTopK* topk);
@@ -0,0 +1,222 @@
+#include "thread-pool.h"
+#include <pthread.h>
+#include "rmalloc.h"
+
+/**
+ * A batch of tasks submitted by `thread_pool_run`. Workers and the submitting thread claim tasks
+ * by index; the submitter waits until `pending` drops to zero. Batches are queued so that
+ * several threads may submit work at the same time.
+ * Detached batches come from `thread_pool_submit`: nobody waits for them, they are freed by the
+ * worker that completes them.
+ */
+typedef struct ThreadPoolBatch {
+  ThreadPoolTask task;
+  void** args;
+  uint32_t n;
+  uint32_t next;
+  uint32_t pending;
+  bool detached;
+  void* arg;
+  pthread_cond_t done;
+  struct ThreadPoolBatch* queue_next;
+} ThreadPoolBatch;
+
+static pthread_mutex_t PoolLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t PoolWork = PTHREAD_COND_INITIALIZER;
+static pthread_t* PoolThreads = NULL;
+static uint32_t PoolSize = 0;
+static bool PoolStopping = false;
+static ThreadPoolBatch* QueueHead = NULL;
+static ThreadPoolBatch* QueueTail = NULL;
+
+/**
+ * Claims the next task of the batch at the head of the queue, dequeuing the batch once all of its
+ * tasks are claimed. Must be called with PoolLock held.
+ */
+static ThreadPoolBatch* ClaimTask(uint32_t* index) {
+  ThreadPoolBatch* batch = QueueHead;
+  if (batch == NULL) {
+    return NULL;
+  }
+
+  *index = batch->next++;
+  if (batch->next == batch->n) {
+    QueueHead = batch->queue_next;
+    if (QueueHead == NULL) {
+      QueueTail = NULL;
+    }
+  }
+
+  return batch;
+}
+
+/**
+ * Runs a claimed task outside of the lock, then reacquires it. Must be called with PoolLock held.
+ */
+static void RunTask(ThreadPoolBatch* batch, uint32_t index) {
+  pthread_mutex_unlock(&PoolLock);
+  batch->task(batch->args[index]);
+  pthread_mutex_lock(&PoolLock);
+
+  if (--batch->pending == 0) {
+    if (batch->detached) {
+      rm_free(batch);
+    } else {
+      pthread_cond_signal(&batch->done);
+    }
+  }
+}
+
+/**
+ * Appends a batch to the queue and wakes up the workers. Must be called with PoolLock held.
+ */
+static void EnqueueBatch(ThreadPoolBatch* batch) {
+  if (QueueTail == NULL) {
+    QueueHead = batch;
+  } else {
+    QueueTail->queue_next = batch;
+  }
+  QueueTail = batch;
+  pthread_cond_broadcast(&PoolWork);
+}
+
+static void* WorkerMain(void* arg) {
+  (void) arg;
+
+  pthread_mutex_lock(&PoolLock);
+  while (true) {
+    uint32_t index;
+    ThreadPoolBatch* batch = ClaimTask(&index);
+    if (batch != NULL) {
+      RunTask(batch, index);
+      continue;
+    }
+
+    if (PoolStopping) {
+      break;
+    }
+
+    pthread_cond_wait(&PoolWork, &PoolLock);
+  }
+  pthread_mutex_unlock(&PoolLock);
+
+  return NULL;
+}
+
+bool thread_pool_start(uint32_t n_threads) {
+  if (n_threads > THREAD_POOL_MAX_THREADS) {
+    n_threads = THREAD_POOL_MAX_THREADS;
+  }
+  if (n_threads == 0 || PoolSize > 0) {
+    return true;
+  }
+
+  PoolThreads = rm_malloc(n_threads * sizeof(*PoolThreads));
+  PoolStopping = false;
+
+  for (uint32_t i = 0; i < n_threads; i++) {
+    if (pthread_create(&PoolThreads[i], NULL, WorkerMain, NULL) != 0) {
+      thread_pool_stop();
+      return false;
+    }
+    PoolSize++;
+  }
+
+  return true;
+}
+
+void thread_pool_stop(void) {
+  pthread_mutex_lock(&PoolLock);
+  PoolStopping = true;
+  pthread_cond_broadcast(&PoolWork);
+  pthread_mutex_unlock(&PoolLock);
+
+  for (uint32_t i = 0; i < PoolSize; i++) {
+    pthread_join(PoolThreads[i], NULL);
+  }
+
+  rm_free(PoolThreads);
+  PoolThreads = NULL;
+  PoolSize = 0;
+}
+
+uint32_t thread_pool_size(void) {
+  return PoolSize;
+}
+
+void thread_pool_run(ThreadPoolTask task, void** args, uint32_t n) {
+  if (n == 0) {
+    return;
+  }
+
+  if (PoolSize == 0 || n == 1) {
+    for (uint32_t i = 0; i < n; i++) {
+      task(args[i]);
+    }
+    return;
+  }
+
+  ThreadPoolBatch batch = {
+      .task = task,
+      .args = args,
+      .n = n,
+      .next = 0,
+      .pending = n,
+      .detached = false,
+      .queue_next = NULL
+  };
+  pthread_cond_init(&batch.done, NULL);
+
+  pthread_mutex_lock(&PoolLock);
+  EnqueueBatch(&batch);
+
+  // Help with our own batch instead of sleeping while the workers run it
+  while (batch.next < batch.n) {
+    uint32_t index = batch.next++;
+    if (batch.next == batch.n) {
+      // Unlink the batch, it is not necessarily at the head when several threads submit work
+      ThreadPoolBatch** link = &QueueHead;
+      ThreadPoolBatch* prev = NULL;
+      while (*link != &batch) {
+        prev = *link;
+        link = &(*link)->queue_next;
+      }
+      *link = batch.queue_next;
+      if (QueueTail == &batch) {
+        QueueTail = prev;
+      }
+    }
+    RunTask(&batch, index);
+  }
+
+  while (batch.pending > 0) {
+    pthread_cond_wait(&batch.done, &PoolLock);
+  }
+  pthread_mutex_unlock(&PoolLock);
+
+  pthread_cond_destroy(&batch.done);
+}
+
+bool thread_pool_submit(ThreadPoolTask task, void* arg) {
+  if (PoolSize == 0) {
+    return false;
+  }
+
+  ThreadPoolBatch* batch = rm_malloc(sizeof(*batch));
+  *batch = (ThreadPoolBatch) {
+      .task = task,
+      .args = &batch->arg,
+      .n = 1,
+      .next = 0,
+      .pending = 1,
+      .detached = true,
+      .arg = arg,
+      .queue_next = NULL
+  };
+
+  pthread_mutex_lock(&PoolLock);
+  EnqueueBatch(batch);
+  pthread_mutex_unlock(&PoolLock);
+
+  return true;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define THREAD_POOL_MAX_THREADS 64
+
+typedef void (*ThreadPoolTask)(void* arg);
+
+/**
+ * Starts the module worker pool with `n_threads` threads, 0 leaves the pool disabled.
+ * Returns false if the threads could not be created.
+ */
+bool thread_pool_start(uint32_t n_threads);
+/**
+ * Stops and joins the worker threads. Must not be called while `thread_pool_run` is in progress.
+ */
+void thread_pool_stop(void);
+/**
+ * Number of worker threads, 0 when the pool is disabled.
+ */
+uint32_t thread_pool_size(void);
+/**
+ * Runs `task(args[i])` for every i in [0, n) and returns once all of them are done.
+ * The calling thread executes tasks as well, so this works (serially) when the pool is disabled.
+ */
+void thread_pool_run(ThreadPoolTask task, void** args, uint32_t n);
+/**
+ * Queues `task(arg)` to run on a worker thread and returns immediately.
+ * Returns false when the pool is disabled, in which case the task is not run.
+ */
+bool thread_pool_submit(ThreadPoolTask task, void* arg);
@@ -24,6 +24,16 @@ function integration_1() {
   fi
   ./tests/integration_1.sh
   stop_redis
+
+  # Heavy commands on the worker threads, background optimizer running
+  rm dump.rdb 2>/dev/null || true
+  if [[ "${USE_VALGRIND:-1}" == "1" ]]; then
+    start_redis --valgrind --background
+  else
+    start_redis --background
+  fi
+  ./tests/integration_1.sh
+  stop_redis
   echo "All integration (1) tests passed"
 }
 
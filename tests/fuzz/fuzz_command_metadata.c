@@ -18,6 +18,9 @@ typedef enum {
   FUZZ_META_DEST_AND_SOURCES,
   FUZZ_META_BITOP_VARIADIC,
   FUZZ_META_BITOP_NOT,
+  FUZZ_META_BITOP_READ,
+  FUZZ_META_KEYS_VARIADIC_OPTION,
+  FUZZ_META_TOPK,
 } FuzzMetadataKind;
 
 typedef enum {
@@ -65,6 +68,11 @@ static const FuzzMetadataSpec FUZZ_METADATA_SPECS[] = {
     {"R.SETINTARRAY", FUZZ_META_SINGLE_KEY_VARIADIC, NULL, FUZZ_FLAGS_OW_INSERT, 0},
     {"R.GETINTARRAY", FUZZ_META_SINGLE_KEY_ONE, NULL, FUZZ_FLAGS_RO_ACCESS, 0},
     {"R.RANGEINTARRAY", FUZZ_META_SINGLE_KEY_THREE, NULL, FUZZ_FLAGS_RO_ACCESS, 0},
+    {"R.SCAN", FUZZ_META_SINGLE_KEY_TWO, NULL, FUZZ_FLAGS_RO_ACCESS, 0},
+    {"R.RANGEBYVALUE", FUZZ_META_SINGLE_KEY_THREE, NULL, FUZZ_FLAGS_RO_ACCESS, 0},
+    {"R.COUNTRANGE", FUZZ_META_SINGLE_KEY_THREE, NULL, FUZZ_FLAGS_RO_ACCESS, 0},
+    {"R.RANK", FUZZ_META_SINGLE_KEY_VARIADIC, NULL, FUZZ_FLAGS_RO_ACCESS, 0},
+    {"R.SELECT", FUZZ_META_SINGLE_KEY_VARIADIC, NULL, FUZZ_FLAGS_RO_ACCESS, 0},
     {"R.APPENDINTARRAY", FUZZ_META_SINGLE_KEY_VARIADIC, NULL, FUZZ_FLAGS_RW_INSERT, 0},
     {"R.DELETEINTARRAY", FUZZ_META_SINGLE_KEY_VARIADIC, NULL, FUZZ_FLAGS_RW_DELETE, 0},
     {"R.DIFF", FUZZ_META_DEST_AND_SOURCES, NULL, FUZZ_FLAGS_OW_INSERT, FUZZ_FLAGS_RO_ACCESS},
@@ -73,8 +81,12 @@ static const FuzzMetadataSpec FUZZ_METADATA_SPECS[] = {
     {"R.OPTIMIZE", FUZZ_META_SINGLE_KEY_OPTIONAL, "MEM", FUZZ_FLAGS_RW_UPDATE, 0},
     {"R.SETBITARRAY", FUZZ_META_SINGLE_KEY_TWO, NULL, FUZZ_FLAGS_OW_INSERT, 0},
     {"R.GETBITARRAY", FUZZ_META_SINGLE_KEY_ONE, NULL, FUZZ_FLAGS_RO_ACCESS, 0},
+    {"R.GETSERIALIZED", FUZZ_META_SINGLE_KEY_ONE, NULL, FUZZ_FLAGS_RO_ACCESS, 0},
+    {"R.SETSERIALIZED", FUZZ_META_SINGLE_KEY_TWO, NULL, FUZZ_FLAGS_OW_INSERT, 0},
     {"R.BITOP", FUZZ_META_BITOP_VARIADIC, NULL, FUZZ_FLAGS_RW_INSERT, FUZZ_FLAGS_RO_ACCESS},
     {"R.BITOP", FUZZ_META_BITOP_NOT, NULL, FUZZ_FLAGS_RW_INSERT, FUZZ_FLAGS_RO_ACCESS},
+    {"R.BITOPCARD", FUZZ_META_BITOP_READ, NULL, FUZZ_FLAGS_RO_ACCESS, FUZZ_FLAGS_RO_ACCESS},
+    {"R.BITOPGET", FUZZ_META_BITOP_READ, "LIMIT", FUZZ_FLAGS_RO_ACCESS, FUZZ_FLAGS_RO_ACCESS},
     {"R.BITCOUNT", FUZZ_META_SINGLE_KEY_ONE, NULL, FUZZ_FLAGS_RO_ACCESS, 0},
     {"R.BITPOS", FUZZ_META_SINGLE_KEY_TWO, NULL, FUZZ_FLAGS_RO_ACCESS, 0},
     {"R.MIN", FUZZ_META_SINGLE_KEY_ONE, NULL, FUZZ_FLAGS_RO_ACCESS, 0},
@@ -82,6 +94,8 @@ static const FuzzMetadataSpec FUZZ_METADATA_SPECS[] = {
     {"R.CLEAR", FUZZ_META_SINGLE_KEY_ONE, NULL, FUZZ_FLAGS_OW_DELETE, 0},
     {"R.CONTAINS", FUZZ_META_PAIR_KEYS_OPTIONAL, "EQ", FUZZ_FLAGS_RO_ACCESS, FUZZ_FLAGS_RO_ACCESS},
     {"R.JACCARD", FUZZ_META_PAIR_KEYS, NULL, FUZZ_FLAGS_RO_ACCESS, FUZZ_FLAGS_RO_ACCESS},
+    {"R.SIMILARITY", FUZZ_META_KEYS_VARIADIC_OPTION, "METRIC", FUZZ_FLAGS_RO_ACCESS, FUZZ_FLAGS_RO_ACCESS},
+    {"R.TOPK", FUZZ_META_TOPK, "METRIC", FUZZ_FLAGS_RO_ACCESS, FUZZ_FLAGS_RO_ACCESS},
     {"R64.SETBIT", FUZZ_META_SINGLE_KEY_THREE, NULL, FUZZ_FLAGS_RW_UPDATE, 0},
     {"R64.GETBIT", FUZZ_META_SINGLE_KEY_TWO, NULL, FUZZ_FLAGS_RO_ACCESS, 0},
     {"R64.GETBITS", FUZZ_META_SINGLE_KEY_VARIADIC, NULL, FUZZ_FLAGS_RO_ACCESS, 0},
@@ -89,6 +103,11 @@ static const FuzzMetadataSpec FUZZ_METADATA_SPECS[] = {
     {"R64.SETINTARRAY", FUZZ_META_SINGLE_KEY_VARIADIC, NULL, FUZZ_FLAGS_OW_INSERT, 0},
     {"R64.GETINTARRAY", FUZZ_META_SINGLE_KEY_ONE, NULL, FUZZ_FLAGS_RO_ACCESS, 0},
     {"R64.RANGEINTARRAY", FUZZ_META_SINGLE_KEY_THREE, NULL, FUZZ_FLAGS_RO_ACCESS, 0},
+    {"R64.SCAN", FUZZ_META_SINGLE_KEY_TWO, NULL, FUZZ_FLAGS_RO_ACCESS, 0},
+    {"R64.RANGEBYVALUE", FUZZ_META_SINGLE_KEY_THREE, NULL, FUZZ_FLAGS_RO_ACCESS, 0},
+    {"R64.COUNTRANGE", FUZZ_META_SINGLE_KEY_THREE, NULL, FUZZ_FLAGS_RO_ACCESS, 0},
+    {"R64.RANK", FUZZ_META_SINGLE_KEY_VARIADIC, NULL, FUZZ_FLAGS_RO_ACCESS, 0},
+    {"R64.SELECT", FUZZ_META_SINGLE_KEY_VARIADIC, NULL, FUZZ_FLAGS_RO_ACCESS, 0},
     {"R64.APPENDINTARRAY", FUZZ_META_SINGLE_KEY_VARIADIC, NULL, FUZZ_FLAGS_RW_INSERT, 0},
     {"R64.DELETEINTARRAY", FUZZ_META_SINGLE_KEY_VARIADIC, NULL, FUZZ_FLAGS_RW_DELETE, 0},
     {"R64.DIFF", FUZZ_META_DEST_AND_SOURCES, NULL, FUZZ_FLAGS_OW_INSERT, FUZZ_FLAGS_RO_ACCESS},
@@ -97,8 +116,12 @@ static const FuzzMetadataSpec FUZZ_METADATA_SPECS[] = {
     {"R64.OPTIMIZE", FUZZ_META_SINGLE_KEY_OPTIONAL, "MEM", FUZZ_FLAGS_RW_UPDATE, 0},
     {"R64.SETBITARRAY", FUZZ_META_SINGLE_KEY_TWO, NULL, FUZZ_FLAGS_OW_INSERT, 0},
     {"R64.GETBITARRAY", FUZZ_META_SINGLE_KEY_ONE, NULL, FUZZ_FLAGS_RO_ACCESS, 0},
+    {"R64.GETSERIALIZED", FUZZ_META_SINGLE_KEY_ONE, NULL, FUZZ_FLAGS_RO_ACCESS, 0},
+    {"R64.SETSERIALIZED", FUZZ_META_SINGLE_KEY_TWO, NULL, FUZZ_FLAGS_OW_INSERT, 0},
     {"R64.BITOP", FUZZ_META_BITOP_VARIADIC, NULL, FUZZ_FLAGS_RW_INSERT, FUZZ_FLAGS_RO_ACCESS},
     {"R64.BITOP", FUZZ_META_BITOP_NOT, NULL, FUZZ_FLAGS_RW_INSERT, FUZZ_FLAGS_RO_ACCESS},
+    {"R64.BITOPCARD", FUZZ_META_BITOP_READ, NULL, FUZZ_FLAGS_RO_ACCESS, FUZZ_FLAGS_RO_ACCESS},
+    {"R64.BITOPGET", FUZZ_META_BITOP_READ, "LIMIT", FUZZ_FLAGS_RO_ACCESS, FUZZ_FLAGS_RO_ACCESS},
     {"R64.BITCOUNT", FUZZ_META_SINGLE_KEY_ONE, NULL, FUZZ_FLAGS_RO_ACCESS, 0},
     {"R64.BITPOS", FUZZ_META_SINGLE_KEY_TWO, NULL, FUZZ_FLAGS_RO_ACCESS, 0},
     {"R64.MIN", FUZZ_META_SINGLE_KEY_ONE, NULL, FUZZ_FLAGS_RO_ACCESS, 0},
@@ -106,6 +129,8 @@ static const FuzzMetadataSpec FUZZ_METADATA_SPECS[] = {
     {"R64.CLEAR", FUZZ_META_SINGLE_KEY_ONE, NULL, FUZZ_FLAGS_OW_DELETE, 0},
     {"R64.CONTAINS", FUZZ_META_PAIR_KEYS_OPTIONAL, "EQ", FUZZ_FLAGS_RO_ACCESS, FUZZ_FLAGS_RO_ACCESS},
     {"R64.JACCARD", FUZZ_META_PAIR_KEYS, NULL, FUZZ_FLAGS_RO_ACCESS, FUZZ_FLAGS_RO_ACCESS},
+    {"R64.SIMILARITY", FUZZ_META_KEYS_VARIADIC_OPTION, "METRIC", FUZZ_FLAGS_RO_ACCESS, FUZZ_FLAGS_RO_ACCESS},
+    {"R64.TOPK", FUZZ_META_TOPK, "METRIC", FUZZ_FLAGS_RO_ACCESS, FUZZ_FLAGS_RO_ACCESS},
     {"R.STAT", FUZZ_META_SINGLE_KEY_OPTIONAL, "JSON", FUZZ_FLAGS_RO_ACCESS, 0},
 };
 
@@ -117,6 +142,10 @@ static const char* FUZZ_CONTAINS_MODES[] = {
     "ALL", "ALL_STRICT", "EQ"
 };
 
+static const char* FUZZ_SIMILARITY_METRICS[] = {
+    "JACCARD", "OVERLAP", "COSINE", "INTERSECTION"
+};
+
 static FuzzRedisServer FUZZ_METADATA_SERVER;
 static bool FUZZ_METADATA_SERVER_READY = false;
 
@@ -153,14 +182,24 @@ static bool fuzz_metadata_command_is_readonly(const FuzzMetadataSpec* spec) {
       || strcmp(suffix, "GETBITS") == 0
       || strcmp(suffix, "GETINTARRAY") == 0
       || strcmp(suffix, "RANGEINTARRAY") == 0
+      || strcmp(suffix, "SCAN") == 0
+      || strcmp(suffix, "RANGEBYVALUE") == 0
+      || strcmp(suffix, "COUNTRANGE") == 0
+      || strcmp(suffix, "RANK") == 0
+      || strcmp(suffix, "SELECT") == 0
       || strcmp(suffix, "OPTIMIZE") == 0
       || strcmp(suffix, "GETBITARRAY") == 0
+      || strcmp(suffix, "GETSERIALIZED") == 0
+      || strcmp(suffix, "BITOPCARD") == 0
+      || strcmp(suffix, "BITOPGET") == 0
       || strcmp(suffix, "BITCOUNT") == 0
       || strcmp(suffix, "BITPOS") == 0
       || strcmp(suffix, "MIN") == 0
       || strcmp(suffix, "MAX") == 0
       || strcmp(suffix, "CONTAINS") == 0
       || strcmp(suffix, "JACCARD") == 0
+      || strcmp(suffix, "SIMILARITY") == 0
+      || strcmp(suffix, "TOPK") == 0
       || strcmp(suffix, "STAT") == 0;
 }
 
@@ -243,6 +282,19 @@ static void fuzz_metadata_add_unique_key(const char* key, const char** keys, siz
   keys[(*key_count)++] = key;
 }
 
+// Variadic key lists end with an optional `<optional_token> <value>` pair after the keys
+static int fuzz_metadata_keys_end(const FuzzMetadataSpec* spec, const char** argv, int argc, int min_argc) {
+  if (spec->optional_token != NULL && argc >= min_argc && strcmp(argv[argc - 2], spec->optional_token) == 0) {
+    return argc - 2;
+  }
+
+  return argc;
+}
+
+static int fuzz_metadata_bitop_read_keys_end(const FuzzMetadataSpec* spec, const char** argv, int argc) {
+  return fuzz_metadata_keys_end(spec, argv, argc, 5);
+}
+
 static size_t fuzz_metadata_collect_runtime_keys(const FuzzMetadataSpec* spec, const char** argv, int argc,
                                                  const char** keys) {
   size_t key_count = 0;
@@ -276,6 +328,24 @@ static size_t fuzz_metadata_collect_runtime_keys(const FuzzMetadataSpec* spec, c
         fuzz_metadata_add_unique_key(argv[i], keys, &key_count);
       }
       break;
+    case FUZZ_META_BITOP_READ:
+      for (int i = 2; i < fuzz_metadata_bitop_read_keys_end(spec, argv, argc); i++) {
+        fuzz_metadata_add_unique_key(argv[i], keys, &key_count);
+      }
+      break;
+    case FUZZ_META_KEYS_VARIADIC_OPTION:
+      for (int i = 1; i < fuzz_metadata_keys_end(spec, argv, argc, 4); i++) {
+        fuzz_metadata_add_unique_key(argv[i], keys, &key_count);
+      }
+      break;
+    case FUZZ_META_TOPK:
+      if (argc >= 2) {
+        fuzz_metadata_add_unique_key(argv[1], keys, &key_count);
+      }
+      for (int i = 3; i < fuzz_metadata_keys_end(spec, argv, argc, 6); i++) {
+        fuzz_metadata_add_unique_key(argv[i], keys, &key_count);
+      }
+      break;
     case FUZZ_META_BITOP_NOT:
       if (argc >= 3) {
         fuzz_metadata_add_unique_key(argv[2], keys, &key_count);
@@ -326,6 +396,10 @@ static int fuzz_metadata_build_valid_argv(const FuzzMetadataSpec* spec, FuzzInpu
     case FUZZ_META_SINGLE_KEY_TWO:
       argv[argc++] = "key1";
       argv[argc++] = strcmp(suffix, "SETBITARRAY") == 0 ? "10101" : "1";
+      // "1" is not a serialized bitmap, so the key must be left untouched
+      if (strcmp(suffix, "SETSERIALIZED") == 0) {
+        *expect_runtime_error = true;
+      }
       break;
     case FUZZ_META_SINGLE_KEY_THREE:
       argv[argc++] = "key1";
@@ -369,7 +443,32 @@ static int fuzz_metadata_build_valid_argv(const FuzzMetadataSpec* spec, FuzzInpu
       argv[argc++] = "src1";
       argv[argc++] = "src2";
       break;
-    case FUZZ_META_BITOP_VARIADIC: {
+    case FUZZ_META_TOPK:
+      argv[argc++] = "query";
+      argv[argc++] = "2";
+      argv[argc++] = "src1";
+      if (fuzz_consume_bool(input)) {
+        argv[argc++] = "src2";
+        argv[argc++] = "src3";
+      }
+      if (fuzz_consume_bool(input)) {
+        argv[argc++] = spec->optional_token;
+        argv[argc++] = FUZZ_SIMILARITY_METRICS[fuzz_consume_size_in_range(input, 0, 3)];
+      }
+      break;
+    case FUZZ_META_KEYS_VARIADIC_OPTION:
+      argv[argc++] = "src1";
+      if (fuzz_consume_bool(input)) {
+        argv[argc++] = "src2";
+        argv[argc++] = "src3";
+      }
+      if (fuzz_consume_bool(input)) {
+        argv[argc++] = spec->optional_token;
+        argv[argc++] = FUZZ_SIMILARITY_METRICS[fuzz_consume_size_in_range(input, 0, 3)];
+      }
+      break;
+    case FUZZ_META_BITOP_VARIADIC:
+    case FUZZ_META_BITOP_READ: {
       bool invalid_operation = fuzz_consume_bool(input);
       if (invalid_operation) {
         argv[argc++] = "NOOP";
@@ -379,12 +478,18 @@ static int fuzz_metadata_build_valid_argv(const FuzzMetadataSpec* spec, FuzzInpu
             input, 0, (sizeof(FUZZ_BITOP_VARIADIC_OPS) / sizeof(FUZZ_BITOP_VARIADIC_OPS[0])) - 1);
         argv[argc++] = FUZZ_BITOP_VARIADIC_OPS[op_index];
       }
-      argv[argc++] = "dest";
+      if (spec->kind == FUZZ_META_BITOP_VARIADIC) {
+        argv[argc++] = "dest";
+      }
       argv[argc++] = "src1";
       argv[argc++] = "src2";
       if (fuzz_consume_bool(input)) {
         argv[argc++] = "src3";
       }
+      if (spec->kind == FUZZ_META_BITOP_READ && spec->optional_token != NULL && fuzz_consume_bool(input)) {
+        argv[argc++] = spec->optional_token;
+        argv[argc++] = "2";
+      }
       break;
     }
     case FUZZ_META_BITOP_NOT:
@@ -430,6 +535,31 @@ static size_t fuzz_metadata_expected_keys(const FuzzMetadataSpec* spec, const ch
         expected[i - 2] = argv[i];
       }
       return (size_t)(argc - 2);
+    case FUZZ_META_BITOP_READ: {
+      if (strcmp(argv[1], "NOOP") == 0) {
+        return 0;
+      }
+      int keys_end = fuzz_metadata_bitop_read_keys_end(spec, argv, argc);
+      for (int i = 2; i < keys_end; i++) {
+        expected[i - 2] = argv[i];
+      }
+      return (size_t)(keys_end - 2);
+    }
+    case FUZZ_META_KEYS_VARIADIC_OPTION: {
+      int keys_end = fuzz_metadata_keys_end(spec, argv, argc, 4);
+      for (int i = 1; i < keys_end; i++) {
+        expected[i - 1] = argv[i];
+      }
+      return (size_t)(keys_end - 1);
+    }
+    case FUZZ_META_TOPK: {
+      int keys_end = fuzz_metadata_keys_end(spec, argv, argc, 6);
+      expected[0] = argv[1];
+      for (int i = 3; i < keys_end; i++) {
+        expected[i - 2] = argv[i];
+      }
+      return (size_t)(keys_end - 2);
+    }
     case FUZZ_META_BITOP_NOT:
       if (strcmp(argv[1], "NOT") != 0) {
         return 0;
@@ -471,6 +601,31 @@ static size_t fuzz_metadata_expected_key_flags(const FuzzMetadataSpec* spec, con
         expected[i - 2] = spec->secondary_flags;
       }
       return (size_t)(argc - 2);
+    case FUZZ_META_BITOP_READ: {
+      if (strcmp(argv[1], "NOOP") == 0) {
+        return 0;
+      }
+      int keys_end = fuzz_metadata_bitop_read_keys_end(spec, argv, argc);
+      for (int i = 2; i < keys_end; i++) {
+        expected[i - 2] = spec->primary_flags;
+      }
+      return (size_t)(keys_end - 2);
+    }
+    case FUZZ_META_KEYS_VARIADIC_OPTION: {
+      int keys_end = fuzz_metadata_keys_end(spec, argv, argc, 4);
+      for (int i = 1; i < keys_end; i++) {
+        expected[i - 1] = spec->primary_flags;
+      }
+      return (size_t)(keys_end - 1);
+    }
+    case FUZZ_META_TOPK: {
+      int keys_end = fuzz_metadata_keys_end(spec, argv, argc, 6);
+      expected[0] = spec->primary_flags;
+      for (int i = 3; i < keys_end; i++) {
+        expected[i - 2] = spec->secondary_flags;
+      }
+      return (size_t)(keys_end - 2);
+    }
     case FUZZ_META_BITOP_NOT:
       if (strcmp(argv[1], "NOT") != 0) {
         return 0;
@@ -578,6 +733,7 @@ static int fuzz_metadata_invalid_argc(const FuzzMetadataSpec* spec) {
   switch (spec->kind) {
     case FUZZ_META_SINGLE_KEY_ONE:
     case FUZZ_META_SINGLE_KEY_OPTIONAL:
+    case FUZZ_META_KEYS_VARIADIC_OPTION:
       return 1;
     case FUZZ_META_SINGLE_KEY_TWO:
     case FUZZ_META_SINGLE_KEY_VARIADIC:
@@ -590,6 +746,8 @@ static int fuzz_metadata_invalid_argc(const FuzzMetadataSpec* spec) {
     case FUZZ_META_BITOP_VARIADIC:
       return 4;
     case FUZZ_META_BITOP_NOT:
+    case FUZZ_META_BITOP_READ:
+    case FUZZ_META_TOPK:
       return 3;
   }
 
@@ -21,6 +21,7 @@ function start_redis() {
   local USE_VALGRIND="no"
   local USE_AOF="no"
   local USE_CLUSTER="no"
+  local MODULE_ARGS="THREADS 2"
   while [[ $# -gt 0 ]]; do
     local PARAM="$1"
     case $PARAM in
@@ -34,6 +35,9 @@ function start_redis() {
       --cluster)
         USE_CLUSTER="yes"
         ;;
+      --background)
+        MODULE_ARGS="THREADS 2 BACKGROUND_THRESHOLD 1 OPTIMIZE_INTERVAL 1"
+        ;;
     esac
     shift
   done
@@ -64,7 +68,7 @@ function start_redis() {
   fi
   export REDIS_PORT
 
-  local REDIS_COMMAND="./deps/redis/src/redis-server --loglevel warning --loadmodule $LIB_PATH --port $REDIS_PORT"
+  local REDIS_COMMAND="./deps/redis/src/redis-server --loglevel warning --loadmodule $LIB_PATH $MODULE_ARGS --port $REDIS_PORT"
   local VALGRIND_COMMAND="valgrind --leak-check=yes --show-leak-kinds=definite,indirect --suppressions=./deps/redis/src/valgrind.sup --error-exitcode=1 --log-file=$LOG_FILE"
   local AOF_OPTION="--appendonly $USE_AOF"
   local CLUSTER_OPTION=""
@@ -12,4 +12,14 @@ FOUND=$(echo "KEYS *" | ./deps/redis/src/redis-cli -p "$REDIS_PORT")
   [[ "$FOUND" =~ .*"$EXPECTED".* ]]
 }
 
+function test_write_after_load() {
+  print_test_header "test_write_after_load"
+
+  rcall_assert "R.BITCOUNT test_bitcount" "6" "Loaded bitmap should keep its cardinality"
+  rcall_assert "R.SETBIT test_bitcount 21 1" "0" "Loaded bitmap should accept writes"
+  rcall_assert "R.GETBIT test_bitcount 13" "1" "Write should keep the loaded bits"
+  rcall_assert "R.BITCOUNT test_bitcount" "7" "Write should be applied to the loaded bitmap"
+}
+
 test_load
+test_write_after_load
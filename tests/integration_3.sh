@@ -24,6 +24,8 @@ function test_getbits() {
 
   rcall_assert "R64.SETINTARRAY test_getbits 1 2 4 5" "OK" "Set bits 1-5"
   rcall_assert "R64.GETBITS test_getbits 1 2 3 4 5" "1\n1\n0\n1\n1" "Get bit at position 1-5"
+  rcall_assert "R64.GETBITS test_getbits PACKED \"\x03\x00\x00\x00\x00\x00\x00\x00\x01\x00\x00\x00\x00\x00\x00\x00\x03\x00\x00\x00\x00\x00\x00\x00\x03\x00\x00\x00\x00\x00\x00\x00\x03\x00\x00\x00\x00\x00\x00\x00\x03\x00\x00\x00\x00\x00\x00\x00\x03\x00\x00\x00\x00\x00\x00\x00\x02\x00\x00\x00\x00\x00\x00\x00\"" "A" "Get packed bits 3 1 3 3 3 3 3 2"
+  rcall_assert "R64.GETBITS test_getbits PACKED \"\x01\x02\x03\"" "ERR invalid offsets: length must be a multiple of 8 bytes" "Reject truncated packed offsets"
 }
 
 function test_clearbits() {
@@ -103,6 +105,17 @@ function test_bitcount() {
   rcall "R64.SETBIT test_bitcount 13 1"
 
   rcall_assert "R64.BITCOUNT test_bitcount" "6" "Count all set bits"
+
+  # The cached count follows the writes that adjust it and the ones that invalidate it
+  rcall_assert "R64.SETBIT test_bitcount 1 0" "1" "Unset bit 1"
+  rcall_assert "R64.SETBIT test_bitcount 1 0" "0" "Unset bit 1 again"
+  rcall_assert "R64.BITCOUNT test_bitcount" "5" "Count after unsetting a bit"
+  rcall_assert "R64.CLEARBITS test_bitcount 2 3 4" "OK" "Clear bits"
+  rcall_assert "R64.BITCOUNT test_bitcount" "3" "Count after clearing bits"
+  rcall_assert "R64.APPENDINTARRAY test_bitcount 20 21 5" "OK" "Append values"
+  rcall_assert "R64.BITCOUNT test_bitcount" "5" "Count after appending values"
+  rcall_assert "R64.DELETEINTARRAY test_bitcount 20 20 99" "OK" "Delete values"
+  rcall_assert "R64.BITCOUNT test_bitcount" "4" "Count after deleting values"
 }
 
 function test_bitpos() {
@@ -153,6 +166,7 @@ function test_command_getkeysandflags() {
 
   rcall_assert "COMMAND GETKEYSANDFLAGS R64.SETINTARRAY test_command_flags 1" $'test_command_flags\nOW\ninsert' "R64.SETINTARRAY reports overwrite/insert key flags"
   rcall_assert "COMMAND GETKEYSANDFLAGS R64.SETBITARRAY test_command_flags 0101" $'test_command_flags\nOW\ninsert' "R64.SETBITARRAY reports overwrite/insert key flags"
+  rcall_assert "COMMAND GETKEYSANDFLAGS R64.BITOPCARD AND test_command_flags_1 test_command_flags_2" $'test_command_flags_1\nRO\naccess\ntest_command_flags_2\nRO\naccess' "R64.BITOPCARD reports read-only source keys"
 }
 
 function test_getbitarray_setbitarray() {
@@ -184,6 +198,17 @@ function test_appendintarray_deleteintarray() {
   rcall_assert "R64.GETINTARRAY test_appendintarray_deleteintarray_dupes" "" "Bitmap should be empty after deleting duplicate zero values"
 }
 
+function test_packed_intarray() {
+  print_test_header "test_packed_intarray (64)"
+
+  rcall_assert "R64.SETINTARRAY test_packed_intarray PACKED \"\x05\x00\x00\x00\x00\x00\x00\x00\x01\x00\x00\x00\x00\x00\x00\x00\x70\x11\x01\x00\x00\x00\x00\x00\"" "OK" "Set packed fixed width values"
+  rcall_assert "R64.GETINTARRAY test_packed_intarray" "1\n5\n70000" "Get array after packed set"
+  rcall_assert "R64.APPENDINTARRAY test_packed_intarray PACKED DELTA VARINT \"\xac\x02\x01\x80\x01\"" "OK" "Append delta varint values"
+  rcall_assert "R64.GETINTARRAY test_packed_intarray" "1\n5\n300\n301\n429\n70000" "Get array after packed append"
+  rcall_assert "R64.SETINTARRAY test_packed_intarray PACKED \"\x01\x02\"" "ERR invalid values: malformed packed integer array" "Reject truncated packed values"
+  rcall_assert "R64.SETINTARRAY test_packed_intarray PACKED ZIGZAG \"\x01\"" "ERR syntax error" "Reject unknown packed encoding"
+}
+
 function test_min_max() {
   print_test_header "test_min_max (64)"
 
@@ -467,6 +492,86 @@ function test_bitop_diff1() {
   rcall_assert "R64.GETINTARRAY diff1_res_23" "$(echo -e "1\n11\n16\n21")" "Result should be {1, 11, 16, 21}"
 }
 
+function test_bitopcard() {
+  print_test_header "test_bitopcard (64)"
+
+  rcall_assert "R64.BITOPCARD AND test_bitopcard_1" "ERR wrong number of arguments for 'R64.BITOPCARD' command" "BITOPCARD with wrong number of arguments"
+  rcall_assert "R64.BITOPCARD NOOP test_bitopcard_1 test_bitopcard_2" "ERR syntax error" "BITOPCARD with invalid operation"
+  rcall_assert "R64.BITOPCARD NOT test_bitopcard_1 test_bitopcard_2" "ERR syntax error" "BITOPCARD does not support NOT"
+
+  rcall_assert "R64.SETINTARRAY test_bitopcard_1 1 2 3 4" "OK" "Set first bitmap"
+  rcall_assert "R64.SETINTARRAY test_bitopcard_2 3 4 5 6" "OK" "Set second bitmap"
+  rcall_assert "R64.SETINTARRAY test_bitopcard_3 4 6 7" "OK" "Set third bitmap"
+
+  rcall_assert "R64.BITOPCARD AND test_bitopcard_1 test_bitopcard_2 test_bitopcard_3" "1" "BITOPCARD AND"
+  rcall_assert "R64.BITOPCARD OR test_bitopcard_1 test_bitopcard_2 test_bitopcard_3" "7" "BITOPCARD OR"
+  rcall_assert "R64.BITOPCARD XOR test_bitopcard_1 test_bitopcard_2 test_bitopcard_3" "5" "BITOPCARD XOR"
+  rcall_assert "R64.BITOPCARD ANDOR test_bitopcard_1 test_bitopcard_2 test_bitopcard_3" "2" "BITOPCARD ANDOR"
+  rcall_assert "R64.BITOPCARD ONE test_bitopcard_1 test_bitopcard_2 test_bitopcard_3" "4" "BITOPCARD ONE"
+  rcall_assert "R64.BITOPCARD DIFF test_bitopcard_1 test_bitopcard_2 test_bitopcard_3" "2" "BITOPCARD DIFF"
+  rcall_assert "R64.BITOPCARD DIFF1 test_bitopcard_1 test_bitopcard_2 test_bitopcard_3" "3" "BITOPCARD DIFF1"
+  rcall_assert "R64.BITOPCARD OR test_bitopcard_1 test_bitopcard_missing" "4" "BITOPCARD treats missing keys as empty"
+  rcall_assert "EXISTS test_bitopcard_missing" "0" "BITOPCARD does not create keys"
+
+  rcall_assert "R64.BITOP ONE test_bitopcard_dest test_bitopcard_1 test_bitopcard_2 test_bitopcard_3" "4" "BITOPCARD matches BITOP"
+}
+
+function test_bitopget() {
+  print_test_header "test_bitopget (64)"
+
+  rcall_assert "R64.BITOPGET AND test_bitopget_1" "ERR wrong number of arguments for 'R64.BITOPGET' command" "BITOPGET with wrong number of arguments"
+  rcall_assert "R64.BITOPGET NOOP test_bitopget_1 test_bitopget_2" "ERR syntax error" "BITOPGET with invalid operation"
+
+  rcall_assert "R64.SETINTARRAY test_bitopget_1 1 2 3 4" "OK" "Set first bitmap"
+  rcall_assert "R64.SETINTARRAY test_bitopget_2 3 4 5 6" "OK" "Set second bitmap"
+
+  rcall_assert "R64.BITOPGET AND test_bitopget_1 test_bitopget_2" "$(echo -e "3\n4")" "BITOPGET AND"
+  rcall_assert "R64.BITOPGET XOR test_bitopget_1 test_bitopget_2" "$(echo -e "1\n2\n5\n6")" "BITOPGET XOR"
+  rcall_assert "R64.BITOPGET DIFF1 test_bitopget_1 test_bitopget_2" "$(echo -e "5\n6")" "BITOPGET DIFF1"
+  rcall_assert "R64.BITOPGET OR test_bitopget_1 test_bitopget_2 LIMIT 3" "$(echo -e "1\n2\n3")" "BITOPGET with LIMIT"
+  rcall_assert "R64.BITOPGET OR test_bitopget_1 test_bitopget_2 LIMIT 0" "" "BITOPGET with LIMIT 0"
+  rcall_assert "R64.BITOPGET OR test_bitopget_1 test_bitopget_2 LIMIT x" "ERR invalid limit: must be an unsigned 64 bit integer" "BITOPGET with invalid LIMIT"
+  rcall_assert "R64.BITOPGET AND test_bitopget_1 LIMIT 5" "ERR syntax error" "BITOPGET with LIMIT after a single key"
+  rcall_assert "R64.BITOPGET AND test_bitopget_1 test_bitopget_missing" "" "BITOPGET treats missing keys as empty"
+  rcall_assert "EXISTS test_bitopget_missing" "0" "BITOPGET does not create keys"
+}
+
+function test_similarity() {
+  print_test_header "test_similarity (64)"
+
+  rcall_assert "R64.SIMILARITY" "ERR wrong number of arguments for 'R64.SIMILARITY' command" "SIMILARITY with wrong number of arguments"
+
+  rcall_assert "R64.SETINTARRAY test_similarity_1 1 2 3" "OK" "Set first bitmap"
+  rcall_assert "R64.SETINTARRAY test_similarity_2 1 2 4" "OK" "Set second bitmap"
+
+  rcall_assert "R64.SIMILARITY test_similarity_1 test_similarity_2" "$(echo -e "1\n0.5\n0.5\n1")" "SIMILARITY defaults to JACCARD"
+  rcall_assert "R64.SIMILARITY test_similarity_1 test_similarity_2 METRIC INTERSECTION" "$(echo -e "3\n2\n2\n3")" "SIMILARITY INTERSECTION"
+  rcall_assert "R64.SIMILARITY test_similarity_1 test_similarity_2 METRIC OVERLAP" "$(echo -e "1\n0.66666666666666663\n0.66666666666666663\n1")" "SIMILARITY OVERLAP"
+  rcall_assert "R64.SIMILARITY test_similarity_1 test_similarity_missing" "$(echo -e "1\n0\n0\n-1")" "SIMILARITY treats missing keys as empty"
+  rcall_assert "R64.SIMILARITY test_similarity_1 METRIC NOOP" "ERR invalid metric argument: NOOP" "SIMILARITY with invalid metric"
+}
+
+function test_topk() {
+  print_test_header "test_topk (64)"
+
+  rcall_assert "R64.TOPK test_topk_query 1" "ERR wrong number of arguments for 'R64.TOPK' command" "TOPK with wrong number of arguments"
+
+  rcall_assert "R64.SETINTARRAY test_topk_query 1 2 3 4" "OK" "Set query bitmap"
+  rcall_assert "R64.SETINTARRAY test_topk_cand1 1 2" "OK" "Set first candidate"
+  rcall_assert "R64.SETINTARRAY test_topk_cand2 1 2 3 5" "OK" "Set second candidate"
+  rcall_assert "R64.SETINTARRAY test_topk_cand3 7 8" "OK" "Set third candidate"
+
+  rcall_assert "R64.TOPK test_topk_query 1 test_topk_cand1 test_topk_cand2 test_topk_cand3 METRIC INTERSECTION" "$(echo -e "test_topk_cand2\n3")" "TOPK INTERSECTION"
+  rcall_assert "R64.TOPK test_topk_query 2 test_topk_cand1 test_topk_cand2 test_topk_cand3" "$(echo -e "test_topk_cand2\n0.6\ntest_topk_cand1\n0.5")" "TOPK defaults to JACCARD"
+  rcall_assert "R64.TOPK test_topk_query 2 MATCH test_topk_cand* COUNT 100" "$(echo -e "test_topk_cand2\n0.6\ntest_topk_cand1\n0.5")" "TOPK over a key pattern"
+  rcall_assert "R64.TOPK test_topk_query 2 MATCH test_topk_cand*" "ERR syntax error: MATCH requires COUNT" "TOPK MATCH without COUNT"
+  rcall "SADD test_topk_set test_topk_cand1 test_topk_cand3 test_topk_query test_topk_missing"
+  rcall_assert "R64.TOPK test_topk_query 5 MEMBERS test_topk_set" "$(echo -e "test_topk_cand1\n0.5\ntest_topk_cand3\n0")" "TOPK over the members of a set"
+  rcall_assert "R64.TOPK test_topk_query 0 test_topk_cand1" "" "TOPK with k 0"
+  rcall_assert "R64.TOPK test_topk_query 1 test_topk_cand1 METRIC NOOP" "ERR invalid metric argument: NOOP" "TOPK with invalid metric"
+  rcall_assert "R64.TOPK test_topk_query x test_topk_cand1" "ERR invalid k: must be an unsigned 32 bit integer" "TOPK with invalid k"
+}
+
 function test_bitop_one() {
   print_test_header "test_bitop_one (64)"
 
@@ -715,6 +820,61 @@ function test_jaccard() {
   rcall_assert "R64.JACCARD jaccard1 nonexistent" "${ERRORMSG_KEY_MISSED}" "Jaccard index with one non-existent key"
 }
 
+function test_rangebyvalue_countrange() {
+  print_test_header "test_rangebyvalue_countrange"
+
+  rcall_assert "R64.SETINTARRAY test_rangebyvalue 1 5 7 9 12" "OK" "Set int array for value ranges"
+  rcall_assert "R64.RANGEBYVALUE test_rangebyvalue 2 10" "5\n7\n9" "Get values between min and max"
+  rcall_assert "R64.RANGEBYVALUE test_rangebyvalue 2 10 LIMIT 1 1" "7" "Get values with limit"
+  rcall_assert "R64.RANGEBYVALUE test_rangebyvalue 2 10 LIMIT 5 1" "" "Get values with offset past the window"
+  rcall_assert "R64.RANGEBYVALUE test_rangebyvalue 10 2" "" "Get values with min greater than max"
+  rcall_assert "R64.RANGEBYVALUE test_rangebyvalue_empty_key 0 10" "" "Get values from empty key"
+  rcall_assert "R64.COUNTRANGE test_rangebyvalue 2 10" "3" "Count values between min and max"
+  rcall_assert "R64.COUNTRANGE test_rangebyvalue 1 12" "5" "Count values with inclusive bounds"
+  rcall_assert "R64.COUNTRANGE test_rangebyvalue_empty_key 0 10" "0" "Count values from empty key"
+}
+
+function test_rank_select() {
+  print_test_header "test_rank_select"
+
+  rcall_assert "R64.SETINTARRAY test_rank_select 1 10 100 1000" "OK" "Set int array for rank and select"
+  rcall_assert "R64.RANK test_rank_select 100" "3" "Rank of a present value"
+  rcall_assert "R64.RANK test_rank_select 0 50 5000" "0\n2\n4" "Rank of several values"
+  rcall_assert "EVAL \"return type(redis.call('R64.RANK', KEYS[1], ARGV[1]))\" 1 test_rank_select 100" "table" "Rank of a single value is an array"
+  rcall_assert "R64.RANK test_rank_select_empty_key 100" "0" "Rank in empty key"
+  rcall_assert "R64.SELECT test_rank_select 3" "100" "Select the third value"
+  rcall_assert "R64.SELECT test_rank_select 1 2 0 5" "1\n10\n-1\n-1" "Select several values"
+  rcall_assert "EVAL \"return type(redis.call('R64.SELECT', KEYS[1], ARGV[1]))\" 1 test_rank_select 3" "table" "Select of a single position is an array"
+  rcall_assert "R64.SELECT test_rank_select_empty_key 1" "-1" "Select in empty key"
+  rcall_assert "R64.RANK test_rank_select abc" "ERR invalid value: must be an unsigned 64 bit integer" "Rank with invalid value"
+}
+
+function test_scan() {
+  print_test_header "test_scan"
+
+  rcall_assert "R64.SETINTARRAY test_scan 1 5 7 9 100" "OK" "Set int array to scan"
+  rcall_assert "R64.SCAN test_scan 0 COUNT 3" "8\n1\n5\n7" "Scan first page"
+  rcall_assert "R64.SCAN test_scan 8 COUNT 3" "0\n9\n100" "Scan last page"
+  rcall_assert "R64.SCAN test_scan 0" "0\n1\n5\n7\n9\n100" "Scan with default count"
+  rcall_assert "R64.SCAN test_scan 101" "0" "Scan past the maximum"
+  rcall_assert "R64.SCAN test_scan_empty_key 0" "0" "Scan empty key"
+  rcall_assert "R64.SCAN test_scan 0 COUNT 0" "ERR invalid count: must be greater than 0" "Scan with zero count"
+  rcall_assert "R64.SCAN test_scan 0 LIMIT 3" "ERR invalid option argument: LIMIT" "Scan with unknown option"
+}
+
+function test_getserialized_setserialized() {
+  print_test_header "test_getserialized_setserialized"
+
+  rcall_assert "R64.SETINTARRAY test_getserialized 1 2 3 100000 4294967295" "OK" "Set int array to serialize"
+  ./deps/redis/src/redis-cli -p "$REDIS_PORT" --raw R64.GETSERIALIZED test_getserialized | perl -pe 'chomp if eof' \
+    | ./deps/redis/src/redis-cli -p "$REDIS_PORT" -x R64.SETSERIALIZED test_setserialized >/dev/null
+  rcall_assert "R64.GETINTARRAY test_setserialized" "1\n2\n3\n100000\n4294967295" "Round trip through the serialized format"
+
+  rcall_assert "R64.GETSERIALIZED test_getserialized_empty_key" "" "Get serialized from empty key"
+  rcall_assert "R64.SETSERIALIZED test_setserialized garbage" "ERR invalid serialized: must be a valid portable roaring bitmap" "Reject invalid serialized bitmap"
+  rcall_assert "R64.BITCOUNT test_setserialized" "5" "Invalid serialized bitmap leaves key unchanged"
+}
+
 function test_stat() {
   print_test_header "test_stat (64)"
 
@@ -747,11 +907,16 @@ test_getintarray_setintarray
 test_command_getkeysandflags
 test_getbitarray_setbitarray
 test_appendintarray_deleteintarray
+test_packed_intarray
 test_setrage
 test_clear
 test_min_max
 test_bitop_diff
 test_bitop_diff1
+test_bitopcard
+test_bitopget
+test_similarity
+test_topk
 test_bitop_one
 test_diff
 test_optimize_nokey
@@ -759,5 +924,9 @@ test_optimize_nokey
 test_del
 test_contains
 test_jaccard
+test_scan
+test_rangebyvalue_countrange
+test_rank_select
+test_getserialized_setserialized
 test_stat
 test_save
@@ -21,6 +21,8 @@
 #include "unit/test_bitmap64_get_nth_element.c"
 #include "unit/test_bitmap64_from_bit_array.c"
 #include "unit/test_bitmap64_from_int_array.c"
+#include "unit/test_bitmap_decode_int_array.c"
+#include "unit/test_bitmap64_decode_int_array.c"
 #include "unit/test_bitmap64_getbit.c"
 #include "unit/test_bitmap64_setbit.c"
 #include "unit/test_bitmap64_xor.c"
@@ -43,6 +45,29 @@
 #include "unit/test_bitmap64_intersect.c"
 #include "unit/test_bitmap64_jaccard.c"
 #include "unit/test_bitmap_jaccard.c"
+#include "unit/test_bitmap_next_chunk.c"
+#include "unit/test_bitmap64_next_chunk.c"
+#include "unit/test_bitmap_run_last.c"
+#include "unit/test_bitmap64_run_last.c"
+#include "unit/test_bitmap_serialize.c"
+#include "unit/test_bitmap64_serialize.c"
+#include "unit/test_bitmap_scan.c"
+#include "unit/test_bitmap64_scan.c"
+#include "unit/test_bitmap_range_by_value.c"
+#include "unit/test_bitmap64_range_by_value.c"
+#include "unit/test_bitmap_rank.c"
+#include "unit/test_bitmap64_rank.c"
+#include "unit/test_bitmap_partition.c"
+#include "unit/test_bitmap_operation_cardinality.c"
+#include "unit/test_bitmap64_operation_cardinality.c"
+#include "unit/test_bitmap_intersection_matrix.c"
+#include "unit/test_bitmap64_intersection_matrix.c"
+#include "unit/test_bitmap_compact.c"
+#include "unit/test_bitmap64_compact.c"
+#include "unit/test_bitmap_allocated_size.c"
+#include "unit/test_bitmap64_allocated_size.c"
+#include "unit/test_bitmap_relocate.c"
+#include "unit/test_similarity.c"
 #include "unit/test_bitop_keys.c"
 
 int main(int argc, char* argv[]) {
@@ -53,6 +78,8 @@ int main(int argc, char* argv[]) {
   test_bitmap_getbits();
   test_bitmap_from_bit_array();
   test_bitmap_from_int_array();
+  test_bitmap_decode_int_array();
+  test_bitmap64_decode_int_array();
   test_bitmap64_free();
   test_bitmap64_or();
   test_bitmap64_and();
@@ -88,6 +115,29 @@ int main(int argc, char* argv[]) {
   test_bitmap_clearbits_count();
   test_bitmap_intersect();
   test_bitmap_jaccard();
+  test_bitmap_next_chunk();
+  test_bitmap64_next_chunk();
+  test_bitmap_run_last();
+  test_bitmap64_run_last();
+  test_bitmap_serialize();
+  test_bitmap64_serialize();
+  test_bitmap_scan();
+  test_bitmap64_scan();
+  test_bitmap_range_by_value();
+  test_bitmap64_range_by_value();
+  test_bitmap_rank();
+  test_bitmap64_rank();
+  test_bitmap_partition();
+  test_bitmap_operation_cardinality();
+  test_bitmap64_operation_cardinality();
+  test_bitmap_intersection_matrix();
+  test_bitmap64_intersection_matrix();
+  test_bitmap_compact();
+  test_bitmap64_compact();
+  test_bitmap_allocated_size();
+  test_bitmap64_allocated_size();
+  test_bitmap_relocate();
+  test_similarity();
   test_bitop_keys();
 
   test_end();
@@ -0,0 +1,39 @@
+#include "data-structure.h"
+#include "../test-utils.h"
+
+void test_bitmap64_allocated_size() {
+  DESCRIBE("bitmap64_allocated_size")
+  {
+    IT("Should count at least the values of the containers")
+    {
+      Bitmap64* bitmap = roaring64_bitmap_create();
+      for (uint64_t key = 0; key < 8; key++) {
+        for (uint64_t i = 0; i < 65536; i += 2) {
+          roaring64_bitmap_add(bitmap, (key << 32) | i);
+        }
+      }
+
+      ASSERT_TRUE(bitmap64_allocated_size(bitmap) >= 8 * 8192);
+
+      roaring64_bitmap_free(bitmap);
+    }
+  }
+
+  DESCRIBE("bitmap64_container_count")
+  {
+    IT("Should return 0 for an empty bitmap")
+    {
+      Bitmap64* bitmap = roaring64_bitmap_create();
+      ASSERT_EQ(0, bitmap64_container_count(bitmap, 10));
+      roaring64_bitmap_free(bitmap);
+    }
+
+    IT("Should count the containers up to the limit")
+    {
+      Bitmap64* bitmap = roaring64_bitmap_from(1, 2, 65535, 65536, UINT64_C(1) << 40, UINT64_MAX);
+      ASSERT_EQ(4, bitmap64_container_count(bitmap, 10));
+      ASSERT_EQ(2, bitmap64_container_count(bitmap, 2));
+      roaring64_bitmap_free(bitmap);
+    }
+  }
+}
@@ -0,0 +1,37 @@
+#include "data-structure.h"
+#include "../test-utils.h"
+
+void test_bitmap64_compact() {
+  DESCRIBE("bitmap64_compact")
+  {
+    IT("Should reclaim memory from a bitmap built value by value")
+    {
+      Bitmap64* bitmap = roaring64_bitmap_create();
+      for (uint64_t i = 0; i < 10000; i++) {
+        roaring64_bitmap_add(bitmap, i);
+      }
+      roaring64_bitmap_add(bitmap, 100000);
+
+      ASSERT_TRUE(bitmap64_compact(bitmap) > 0);
+      ASSERT_EQ(10001, roaring64_bitmap_get_cardinality(bitmap));
+      ASSERT_TRUE(roaring64_bitmap_contains(bitmap, 9999));
+      ASSERT_TRUE(roaring64_bitmap_contains(bitmap, 100000));
+      ASSERT_FALSE(roaring64_bitmap_contains(bitmap, 10000));
+
+      roaring64_bitmap_free(bitmap);
+    }
+
+    IT("Should not reclaim anything twice")
+    {
+      Bitmap64* bitmap = roaring64_bitmap_create();
+      for (uint64_t i = 0; i < 10000; i += 3) {
+        roaring64_bitmap_add(bitmap, i);
+      }
+
+      bitmap64_compact(bitmap);
+      ASSERT_EQ(0, bitmap64_compact(bitmap));
+
+      roaring64_bitmap_free(bitmap);
+    }
+  }
+}
@@ -0,0 +1,70 @@
+#include "data-structure.h"
+#include "../test-utils.h"
+
+void test_bitmap64_decode_int_array() {
+  DESCRIBE("bitmap64_decode_int_array")
+  {
+    IT("Should decode little-endian fixed width values")
+    {
+      unsigned char buffer[] = {
+        1, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 1, 0, 0, 0,
+        0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF
+      };
+      uint64_t* values;
+      size_t n;
+
+      ASSERT_TRUE(bitmap64_decode_int_array(sizeof(buffer), buffer, BITMAP_INT_ENCODING_FIXED, &values, &n));
+      uint64_t expected[] = { 1, 1ULL << 32, UINT64_MAX };
+      ASSERT_ARRAY_EQ(expected, values, ARRAY_LENGTH(expected), n);
+
+      SAFE_FREE(values);
+    }
+
+    IT("Should reject a truncated fixed width buffer")
+    {
+      unsigned char buffer[] = { 1, 0, 0, 0 };
+      uint64_t* values;
+      size_t n;
+
+      ASSERT_FALSE(bitmap64_decode_int_array(sizeof(buffer), buffer, BITMAP_INT_ENCODING_FIXED, &values, &n));
+    }
+
+    IT("Should decode varints")
+    {
+      unsigned char buffer[] = { 0x01, 0xAC, 0x02, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x01 };
+      uint64_t* values;
+      size_t n;
+
+      ASSERT_TRUE(bitmap64_decode_int_array(sizeof(buffer), buffer, BITMAP_INT_ENCODING_VARINT, &values, &n));
+      uint64_t expected[] = { 1, 300, UINT64_MAX };
+      ASSERT_ARRAY_EQ(expected, values, ARRAY_LENGTH(expected), n);
+
+      SAFE_FREE(values);
+    }
+
+    IT("Should reject truncated and out of range varints")
+    {
+      unsigned char truncated[] = { 0x01, 0x80 };
+      unsigned char overflow[] = { 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x02 };
+      uint64_t* values;
+      size_t n;
+
+      ASSERT_FALSE(bitmap64_decode_int_array(sizeof(truncated), truncated, BITMAP_INT_ENCODING_VARINT, &values, &n));
+      ASSERT_FALSE(bitmap64_decode_int_array(sizeof(overflow), overflow, BITMAP_INT_ENCODING_VARINT, &values, &n));
+    }
+
+    IT("Should accumulate deltas")
+    {
+      unsigned char buffer[] = { 0x80, 0x80, 0x80, 0x80, 0x10, 0x01, 0x02 };
+      uint64_t* values;
+      size_t n;
+
+      ASSERT_TRUE(bitmap64_decode_int_array(sizeof(buffer), buffer, BITMAP_INT_ENCODING_DELTA | BITMAP_INT_ENCODING_VARINT, &values, &n));
+      uint64_t expected[] = { 1ULL << 32, (1ULL << 32) + 1, (1ULL << 32) + 3 };
+      ASSERT_ARRAY_EQ(expected, values, ARRAY_LENGTH(expected), n);
+
+      SAFE_FREE(values);
+    }
+  }
+}
@@ -178,4 +178,40 @@ void test_bitmap64_getbits() {
       ASSERT_NULL(results);
     }
   }
+
+  DESCRIBE("bitmap64_getbits_packed")
+  {
+    IT("Should set one bit per offset in request order")
+    {
+      Bitmap64* bitmap = roaring64_bitmap_from(1, 5, 100, 1ULL << 40);
+      uint64_t values[] = { 100, 2, 5, 1ULL << 40, 1, 3, 100, 9 };
+      unsigned char packed[sizeof(values)];
+      for (size_t i = 0; i < ARRAY_LENGTH(values); i++) {
+        for (size_t b = 0; b < 8; b++) {
+          packed[i * 8 + b] = (unsigned char) (values[i] >> (8 * b));
+        }
+      }
+      unsigned char bits[1] = { 0xFF };
+
+      bitmap64_getbits_packed(bitmap, ARRAY_LENGTH(values), packed, bits);
+
+      ASSERT_EQ(0xBA, bits[0]);
+
+      roaring64_bitmap_free(bitmap);
+    }
+
+    IT("Should pad the last byte with zeros")
+    {
+      Bitmap64* bitmap = roaring64_bitmap_from(7);
+      unsigned char packed[3 * 8] = { 0 };
+      packed[8] = 7;
+      unsigned char bits[1] = { 0xFF };
+
+      bitmap64_getbits_packed(bitmap, 3, packed, bits);
+
+      ASSERT_EQ(0x40, bits[0]);
+
+      roaring64_bitmap_free(bitmap);
+    }
+  }
 }
@@ -0,0 +1,98 @@
+#include "data-structure.h"
+#include "../test-utils.h"
+
+void test_bitmap64_next_chunk() {
+  DESCRIBE("bitmap64_next_chunk")
+  {
+    IT("Should return no chunk for an empty bitmap")
+    {
+      Bitmap64* bitmap = roaring64_bitmap_create();
+      roaring64_iterator_t* iterator = roaring64_iterator_create(bitmap);
+
+      ASSERT_EQ(0, bitmap64_chunk_count(bitmap, 2));
+      ASSERT_NULL(bitmap64_next_chunk(bitmap, iterator, 2));
+
+      roaring64_iterator_free(iterator);
+      roaring64_bitmap_free(bitmap);
+    }
+
+    IT("Should split the bitmap by containers")
+    {
+      Bitmap64* bitmap = roaring64_bitmap_from(1, 2, 65536, 1ULL << 40, (1ULL << 40) + 1, 1ULL << 60);
+      roaring64_iterator_t* iterator = roaring64_iterator_create(bitmap);
+
+      ASSERT_EQ(2, bitmap64_chunk_count(bitmap, 2));
+
+      Bitmap64* chunk = bitmap64_next_chunk(bitmap, iterator, 2);
+      uint64_t expected1[] = { 1, 2, 65536 };
+      ASSERT_BITMAP64_EQ_ARRAY(expected1, ARRAY_LENGTH(expected1), chunk);
+      roaring64_bitmap_free(chunk);
+
+      chunk = bitmap64_next_chunk(bitmap, iterator, 2);
+      uint64_t expected2[] = { 1ULL << 40, (1ULL << 40) + 1, 1ULL << 60 };
+      ASSERT_BITMAP64_EQ_ARRAY(expected2, ARRAY_LENGTH(expected2), chunk);
+      roaring64_bitmap_free(chunk);
+
+      ASSERT_NULL(bitmap64_next_chunk(bitmap, iterator, 2));
+
+      roaring64_iterator_free(iterator);
+      roaring64_bitmap_free(bitmap);
+    }
+
+    IT("Should handle the last container")
+    {
+      Bitmap64* bitmap = roaring64_bitmap_from(5, UINT64_MAX - 1, UINT64_MAX);
+      roaring64_iterator_t* iterator = roaring64_iterator_create(bitmap);
+
+      ASSERT_EQ(2, bitmap64_chunk_count(bitmap, 1));
+
+      Bitmap64* chunk = bitmap64_next_chunk(bitmap, iterator, 1);
+      uint64_t expected1[] = { 5 };
+      ASSERT_BITMAP64_EQ_ARRAY(expected1, ARRAY_LENGTH(expected1), chunk);
+      roaring64_bitmap_free(chunk);
+
+      chunk = bitmap64_next_chunk(bitmap, iterator, 1);
+      uint64_t expected2[] = { UINT64_MAX - 1, UINT64_MAX };
+      ASSERT_BITMAP64_EQ_ARRAY(expected2, ARRAY_LENGTH(expected2), chunk);
+      roaring64_bitmap_free(chunk);
+
+      ASSERT_NULL(bitmap64_next_chunk(bitmap, iterator, 1));
+
+      roaring64_iterator_free(iterator);
+      roaring64_bitmap_free(bitmap);
+    }
+  
+    IT("Should split sparse high keys without filling the gaps")
+    {
+      Bitmap64* bitmap = roaring64_bitmap_create();
+      for (uint64_t i = 0; i < 6; i++) {
+        roaring64_bitmap_add(bitmap, i << 48);
+      }
+      roaring64_bitmap_add_range_closed(bitmap, 5ULL << 48, (5ULL << 48) + 2 * BITMAP64_CHUNK_READ_BATCH);
+      roaring64_iterator_t* iterator = roaring64_iterator_create(bitmap);
+
+      ASSERT_EQ(3, bitmap64_chunk_count(bitmap, 2));
+
+      Bitmap64* chunk = bitmap64_next_chunk(bitmap, iterator, 2);
+      uint64_t expected1[] = { 0, 1ULL << 48 };
+      ASSERT_BITMAP64_EQ_ARRAY(expected1, ARRAY_LENGTH(expected1), chunk);
+      roaring64_bitmap_free(chunk);
+
+      chunk = bitmap64_next_chunk(bitmap, iterator, 2);
+      uint64_t expected2[] = { 2ULL << 48, 3ULL << 48 };
+      ASSERT_BITMAP64_EQ_ARRAY(expected2, ARRAY_LENGTH(expected2), chunk);
+      roaring64_bitmap_free(chunk);
+
+      chunk = bitmap64_next_chunk(bitmap, iterator, 2);
+      ASSERT_EQ(2 * BITMAP64_CHUNK_READ_BATCH + 2, roaring64_bitmap_get_cardinality(chunk));
+      ASSERT_TRUE(roaring64_bitmap_contains(chunk, 4ULL << 48));
+      ASSERT_TRUE(roaring64_bitmap_contains(chunk, (5ULL << 48) + 2 * BITMAP64_CHUNK_READ_BATCH));
+      roaring64_bitmap_free(chunk);
+
+      ASSERT_NULL(bitmap64_next_chunk(bitmap, iterator, 2));
+
+      roaring64_iterator_free(iterator);
+      roaring64_bitmap_free(bitmap);
+    }
+  }
+}
@@ -0,0 +1,63 @@
+#include "data-structure.h"
+#include "../test-utils.h"
+
+static Bitmap64* operation_cardinality_source64(uint64_t seed) {
+  Bitmap64* bitmap = roaring64_bitmap_create();
+  for (uint64_t v = 0; v < 200000; v += seed) {
+    roaring64_bitmap_add(bitmap, v);
+  }
+  roaring64_bitmap_add_range(bitmap, seed * 1000, seed * 1000 + 5000);
+  return bitmap;
+}
+
+void test_bitmap64_operation_cardinality() {
+  DESCRIBE("bitmap64_operation_cardinality")
+  {
+    int operations[] = {
+        BITMAP_OPERATION_AND, BITMAP_OPERATION_OR, BITMAP_OPERATION_XOR, BITMAP_OPERATION_ANDOR,
+        BITMAP_OPERATION_ONE, BITMAP_OPERATION_ANDNOT, BITMAP_OPERATION_ORNOT
+    };
+    void (*materialized[])(Bitmap64*, uint32_t, const Bitmap64**) = {
+        bitmap64_and, bitmap64_or, bitmap64_xor, bitmap64_andor, bitmap64_one, bitmap64_andnot, bitmap64_ornot
+    };
+
+    IT("Should return 0 for an empty bitmap array")
+    {
+      for (size_t i = 0; i < ARRAY_LENGTH(operations); i++) {
+        ASSERT_EQ(0, bitmap64_operation_cardinality(operations[i], 0, NULL));
+      }
+    }
+
+    IT("Should match the cardinality of the materialized operations")
+    {
+      Bitmap64* a = operation_cardinality_source64(3);
+      Bitmap64* b = operation_cardinality_source64(5);
+      Bitmap64* c = operation_cardinality_source64(7);
+      Bitmap64* d = operation_cardinality_source64(11);
+      Bitmap64* empty = roaring64_bitmap_create();
+      const Bitmap64* bitmaps[] = {c, a, d, b};
+      const Bitmap64* with_empty[] = {a, empty, b};
+
+      for (size_t i = 0; i < ARRAY_LENGTH(operations); i++) {
+        for (uint32_t n = 1; n <= ARRAY_LENGTH(bitmaps); n++) {
+          Bitmap64* expected = roaring64_bitmap_create();
+          materialized[i](expected, n, bitmaps);
+          ASSERT_EQ(roaring64_bitmap_get_cardinality(expected), bitmap64_operation_cardinality(operations[i], n, bitmaps));
+          roaring64_bitmap_free(expected);
+        }
+
+        Bitmap64* expected = roaring64_bitmap_create();
+        materialized[i](expected, ARRAY_LENGTH(with_empty), with_empty);
+        ASSERT_EQ(roaring64_bitmap_get_cardinality(expected),
+                  bitmap64_operation_cardinality(operations[i], ARRAY_LENGTH(with_empty), with_empty));
+        roaring64_bitmap_free(expected);
+      }
+
+      roaring64_bitmap_free(a);
+      roaring64_bitmap_free(b);
+      roaring64_bitmap_free(c);
+      roaring64_bitmap_free(d);
+      roaring64_bitmap_free(empty);
+    }
+  }
+}
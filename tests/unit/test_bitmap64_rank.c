@@ -0,0 +1,29 @@
+#include "data-structure.h"
+#include "../test-utils.h"
+
+void test_bitmap64_rank() {
+  DESCRIBE("bitmap64_rank")
+  {
+    IT("Should count the elements smaller or equal to the value")
+    {
+      Bitmap64* bitmap = roaring64_bitmap_from(1, 10, 100, 1000);
+
+      ASSERT_EQ(0, bitmap64_rank(bitmap, 0));
+      ASSERT_EQ(1, bitmap64_rank(bitmap, 1));
+      ASSERT_EQ(2, bitmap64_rank(bitmap, 50));
+      ASSERT_EQ(4, bitmap64_rank(bitmap, 1000));
+      ASSERT_EQ(4, bitmap64_rank(bitmap, UINT64_MAX));
+
+      roaring64_bitmap_free(bitmap);
+    }
+
+    IT("Should return 0 for an empty bitmap")
+    {
+      Bitmap64* bitmap = roaring64_bitmap_create();
+
+      ASSERT_EQ(0, bitmap64_rank(bitmap, 100));
+
+      roaring64_bitmap_free(bitmap);
+    }
+  }
+}
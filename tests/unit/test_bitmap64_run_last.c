@@ -0,0 +1,40 @@
+#include "data-structure.h"
+#include "../test-utils.h"
+
+void test_bitmap64_run_last() {
+  DESCRIBE("bitmap64_run_last")
+  {
+    IT("Should return start for an isolated value")
+    {
+      Bitmap64* bitmap = roaring64_bitmap_from(1, 3, 1ULL << 40);
+
+      ASSERT_EQ(1, bitmap64_run_last(bitmap, 1));
+      ASSERT_EQ(3, bitmap64_run_last(bitmap, 3));
+      ASSERT_EQ(1ULL << 40, bitmap64_run_last(bitmap, 1ULL << 40));
+
+      roaring64_bitmap_free(bitmap);
+    }
+
+    IT("Should find the end of a run spanning several containers")
+    {
+      Bitmap64* bitmap = roaring64_bitmap_from_range(1ULL << 40, (1ULL << 40) + 1000000, 1);
+      roaring64_bitmap_add(bitmap, (1ULL << 40) + 1000001);
+
+      ASSERT_EQ((1ULL << 40) + 999999, bitmap64_run_last(bitmap, 1ULL << 40));
+      ASSERT_EQ((1ULL << 40) + 1000001, bitmap64_run_last(bitmap, (1ULL << 40) + 1000001));
+
+      roaring64_bitmap_free(bitmap);
+    }
+
+    IT("Should stop at UINT64_MAX")
+    {
+      Bitmap64* bitmap = roaring64_bitmap_from_range(UINT64_MAX - 100, UINT64_MAX, 1);
+      roaring64_bitmap_add(bitmap, UINT64_MAX);
+
+      ASSERT_EQ(UINT64_MAX, bitmap64_run_last(bitmap, UINT64_MAX - 100));
+      ASSERT_EQ(UINT64_MAX, bitmap64_run_last(bitmap, UINT64_MAX));
+
+      roaring64_bitmap_free(bitmap);
+    }
+  }
+}
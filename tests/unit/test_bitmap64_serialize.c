@@ -0,0 +1,62 @@
+#include "data-structure.h"
+#include "../test-utils.h"
+
+void test_bitmap64_serialize() {
+  DESCRIBE("bitmap64_serialize")
+  {
+    IT("Should round trip a bitmap")
+    {
+      Bitmap64* bitmap = roaring64_bitmap_from(1, 2, 3, 100000, 1ULL << 40, UINT64_MAX);
+      size_t size;
+      char* serialized = bitmap64_serialize(bitmap, &size);
+
+      Bitmap64* result = bitmap64_deserialize(serialized, size);
+      ASSERT_NOT_NULL(result);
+      ASSERT_BITMAP64_EQ(bitmap, result);
+
+      free(serialized);
+      roaring64_bitmap_free(result);
+      roaring64_bitmap_free(bitmap);
+    }
+
+    IT("Should round trip an empty bitmap")
+    {
+      Bitmap64* bitmap = roaring64_bitmap_create();
+      size_t size;
+      char* serialized = bitmap64_serialize(bitmap, &size);
+
+      Bitmap64* result = bitmap64_deserialize(serialized, size);
+      ASSERT_NOT_NULL(result);
+      ASSERT_TRUE(bitmap64_is_empty(result));
+
+      free(serialized);
+      roaring64_bitmap_free(result);
+      roaring64_bitmap_free(bitmap);
+    }
+
+    IT("Should reject truncated and oversized buffers")
+    {
+      Bitmap64* bitmap = roaring64_bitmap_from(1, 2, 3, 100000, 1ULL << 40, UINT64_MAX);
+      size_t size;
+      char* serialized = bitmap64_serialize(bitmap, &size);
+
+      ASSERT_NULL(bitmap64_deserialize(serialized, size - 1));
+
+      char* padded = malloc(size + 1);
+      memcpy(padded, serialized, size);
+      padded[size] = 0;
+      ASSERT_NULL(bitmap64_deserialize(padded, size + 1));
+
+      free(padded);
+      free(serialized);
+      roaring64_bitmap_free(bitmap);
+    }
+
+    IT("Should reject garbage")
+    {
+      const char garbage[] = "garbage";
+      ASSERT_NULL(bitmap64_deserialize(garbage, sizeof(garbage) - 1));
+      ASSERT_NULL(bitmap64_deserialize(garbage, 0));
+    }
+  }
+}
@@ -0,0 +1,43 @@
+#include "data-structure.h"
+#include "../test-utils.h"
+
+void test_bitmap_allocated_size() {
+  DESCRIBE("bitmap_allocated_size")
+  {
+    IT("Should count the index of an empty bitmap")
+    {
+      Bitmap* bitmap = roaring_bitmap_create();
+      ASSERT_TRUE(bitmap_allocated_size(bitmap, 0) >= sizeof(*bitmap));
+      roaring_bitmap_free(bitmap);
+    }
+
+    IT("Should count the allocated capacity of the containers")
+    {
+      Bitmap* bitmap = roaring_bitmap_create();
+      for (uint32_t key = 0; key < 8; key++) {
+        for (uint32_t i = 0; i < 65536; i += 2) {
+          roaring_bitmap_add(bitmap, (key << 16) | i);
+        }
+      }
+
+      ASSERT_TRUE(bitmap_allocated_size(bitmap, 0) >= 8 * 8192);
+
+      roaring_bitmap_free(bitmap);
+    }
+
+    IT("Should extrapolate a sample of the containers")
+    {
+      Bitmap* bitmap = roaring_bitmap_create();
+      for (uint32_t key = 0; key < 100; key++) {
+        for (uint32_t i = 0; i < 65536; i += 2) {
+          roaring_bitmap_add(bitmap, (key << 16) | i);
+        }
+      }
+
+      ASSERT_EQ(bitmap_allocated_size(bitmap, 0), bitmap_allocated_size(bitmap, 10));
+      ASSERT_EQ(bitmap_allocated_size(bitmap, 0), bitmap_allocated_size(bitmap, 1000));
+
+      roaring_bitmap_free(bitmap);
+    }
+  }
+}
@@ -78,5 +78,46 @@ void test_bitmap_and() {
       bitmap_free(bitmap1);
       bitmap_free(bitmap2);
     }
+
+    IT("Should not depend on the order of huge and tiny bitmaps")
+    {
+      Bitmap* huge = bitmap_alloc();
+      roaring_bitmap_add_range(huge, 0, 1000000);
+      Bitmap* tiny = roaring_bitmap_from(5, 500000, 2000000);
+      Bitmap* medium = bitmap_alloc();
+      roaring_bitmap_add_range(medium, 0, 600000);
+
+      const Bitmap* huge_first[] = { huge, medium, tiny };
+      const Bitmap* tiny_first[] = { tiny, medium, huge };
+      Bitmap* result1 = bitmap_alloc();
+      Bitmap* result2 = bitmap_alloc();
+      bitmap_and(result1, 3, huge_first);
+      bitmap_and(result2, 3, tiny_first);
+
+      uint32_t expected[] = { 5, 500000 };
+      ASSERT_BITMAP_EQ_ARRAY(expected, ARRAY_LENGTH(expected), result1);
+      ASSERT_BITMAP_EQ_ARRAY(expected, ARRAY_LENGTH(expected), result2);
+
+      bitmap_free(huge);
+      bitmap_free(tiny);
+      bitmap_free(medium);
+      bitmap_free(result1);
+      bitmap_free(result2);
+    }
+
+    IT("Should clear the destination when a source is empty")
+    {
+      Bitmap* bitmap1 = roaring_bitmap_from(1, 2, 3);
+      Bitmap* empty = bitmap_alloc();
+      Bitmap* result = roaring_bitmap_from(7);
+
+      const Bitmap* bitmaps[] = { bitmap1, empty, bitmap1 };
+      bitmap_and(result, 3, bitmaps);
+      ASSERT_BITMAP_SIZE(0, result);
+
+      bitmap_free(bitmap1);
+      bitmap_free(empty);
+      bitmap_free(result);
+    }
   }
 }
@@ -0,0 +1,37 @@
+#include "data-structure.h"
+#include "../test-utils.h"
+
+void test_bitmap_compact() {
+  DESCRIBE("bitmap_compact")
+  {
+    IT("Should reclaim memory from a bitmap built value by value")
+    {
+      Bitmap* bitmap = roaring_bitmap_create();
+      for (uint32_t i = 0; i < 10000; i++) {
+        roaring_bitmap_add(bitmap, i);
+      }
+      roaring_bitmap_add(bitmap, 100000);
+
+      ASSERT_TRUE(bitmap_compact(bitmap) > 0);
+      ASSERT_EQ(10001, roaring_bitmap_get_cardinality(bitmap));
+      ASSERT_TRUE(roaring_bitmap_contains(bitmap, 9999));
+      ASSERT_TRUE(roaring_bitmap_contains(bitmap, 100000));
+      ASSERT_FALSE(roaring_bitmap_contains(bitmap, 10000));
+
+      roaring_bitmap_free(bitmap);
+    }
+
+    IT("Should not reclaim anything twice")
+    {
+      Bitmap* bitmap = roaring_bitmap_create();
+      for (uint32_t i = 0; i < 10000; i += 3) {
+        roaring_bitmap_add(bitmap, i);
+      }
+
+      bitmap_compact(bitmap);
+      ASSERT_EQ(0, bitmap_compact(bitmap));
+
+      roaring_bitmap_free(bitmap);
+    }
+  }
+}
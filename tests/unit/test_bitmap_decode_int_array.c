@@ -0,0 +1,82 @@
+#include "data-structure.h"
+#include "../test-utils.h"
+
+void test_bitmap_decode_int_array() {
+  DESCRIBE("bitmap_decode_int_array")
+  {
+    IT("Should decode little-endian fixed width values")
+    {
+      unsigned char buffer[] = { 1, 0, 0, 0, 0, 1, 0, 0, 0xFF, 0xFF, 0xFF, 0xFF };
+      uint32_t* values;
+      size_t n;
+
+      ASSERT_TRUE(bitmap_decode_int_array(sizeof(buffer), buffer, BITMAP_INT_ENCODING_FIXED, &values, &n));
+      uint32_t expected[] = { 1, 256, UINT32_MAX };
+      ASSERT_ARRAY_EQ(expected, values, ARRAY_LENGTH(expected), n);
+
+      SAFE_FREE(values);
+    }
+
+    IT("Should reject a truncated fixed width buffer")
+    {
+      unsigned char buffer[] = { 1, 0, 0, 0, 2 };
+      uint32_t* values;
+      size_t n;
+
+      ASSERT_FALSE(bitmap_decode_int_array(sizeof(buffer), buffer, BITMAP_INT_ENCODING_FIXED, &values, &n));
+    }
+
+    IT("Should decode varints")
+    {
+      unsigned char buffer[] = { 0x01, 0xAC, 0x02, 0xFF, 0xFF, 0xFF, 0xFF, 0x0F };
+      uint32_t* values;
+      size_t n;
+
+      ASSERT_TRUE(bitmap_decode_int_array(sizeof(buffer), buffer, BITMAP_INT_ENCODING_VARINT, &values, &n));
+      uint32_t expected[] = { 1, 300, UINT32_MAX };
+      ASSERT_ARRAY_EQ(expected, values, ARRAY_LENGTH(expected), n);
+
+      SAFE_FREE(values);
+    }
+
+    IT("Should reject truncated and out of range varints")
+    {
+      unsigned char truncated[] = { 0x01, 0x80 };
+      unsigned char overflow[] = { 0xFF, 0xFF, 0xFF, 0xFF, 0x1F };
+      uint32_t* values;
+      size_t n;
+
+      ASSERT_FALSE(bitmap_decode_int_array(sizeof(truncated), truncated, BITMAP_INT_ENCODING_VARINT, &values, &n));
+      ASSERT_FALSE(bitmap_decode_int_array(sizeof(overflow), overflow, BITMAP_INT_ENCODING_VARINT, &values, &n));
+    }
+
+    IT("Should accumulate deltas")
+    {
+      unsigned char varints[] = { 0x05, 0x03, 0x00, 0x80, 0x01 };
+      unsigned char fixed[] = { 0xFF, 0xFF, 0xFF, 0xFF, 2, 0, 0, 0 };
+      uint32_t* values;
+      size_t n;
+
+      ASSERT_TRUE(bitmap_decode_int_array(sizeof(varints), varints, BITMAP_INT_ENCODING_DELTA | BITMAP_INT_ENCODING_VARINT, &values, &n));
+      uint32_t expected_varints[] = { 5, 8, 8, 136 };
+      ASSERT_ARRAY_EQ(expected_varints, values, ARRAY_LENGTH(expected_varints), n);
+      SAFE_FREE(values);
+
+      ASSERT_TRUE(bitmap_decode_int_array(sizeof(fixed), fixed, BITMAP_INT_ENCODING_DELTA, &values, &n));
+      uint32_t expected_fixed[] = { UINT32_MAX, 1 };
+      ASSERT_ARRAY_EQ(expected_fixed, values, ARRAY_LENGTH(expected_fixed), n);
+      SAFE_FREE(values);
+    }
+
+    IT("Should decode an empty buffer")
+    {
+      uint32_t* values;
+      size_t n;
+
+      ASSERT_TRUE(bitmap_decode_int_array(0, NULL, BITMAP_INT_ENCODING_VARINT, &values, &n));
+      ASSERT_EQ(0, n);
+
+      SAFE_FREE(values);
+    }
+  }
+}
@@ -178,4 +178,40 @@ void test_bitmap_getbits() {
       ASSERT_NULL(results);
     }
   }
+
+  DESCRIBE("bitmap_getbits_packed")
+  {
+    IT("Should set one bit per offset in request order")
+    {
+      Bitmap* bitmap = roaring_bitmap_from(1, 5, 100, 70000);
+      uint32_t values[] = { 100, 2, 5, 70000, 1, 3, 100, 9 };
+      unsigned char packed[sizeof(values)];
+      for (size_t i = 0; i < ARRAY_LENGTH(values); i++) {
+        for (size_t b = 0; b < 4; b++) {
+          packed[i * 4 + b] = (unsigned char) (values[i] >> (8 * b));
+        }
+      }
+      unsigned char bits[1] = { 0xFF };
+
+      bitmap_getbits_packed(bitmap, ARRAY_LENGTH(values), packed, bits);
+
+      ASSERT_EQ(0xBA, bits[0]);
+
+      roaring_bitmap_free(bitmap);
+    }
+
+    IT("Should pad the last byte with zeros")
+    {
+      Bitmap* bitmap = roaring_bitmap_from(7);
+      unsigned char packed[3 * 4] = { 0 };
+      packed[4] = 7;
+      unsigned char bits[1] = { 0xFF };
+
+      bitmap_getbits_packed(bitmap, 3, packed, bits);
+
+      ASSERT_EQ(0x40, bits[0]);
+
+      roaring_bitmap_free(bitmap);
+    }
+  }
 }
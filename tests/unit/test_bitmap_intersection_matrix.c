@@ -0,0 +1,69 @@
+#include "data-structure.h"
+#include "../test-utils.h"
+
+// The caller provides the diagonal, as R.SIMILARITY does from the cached cardinalities
+static void intersection_matrix_diagonal(uint32_t n, const Bitmap** bitmaps, uint64_t* matrix) {
+  for (uint32_t i = 0; i < n; i++) {
+    matrix[(uint64_t) i * n + i] = roaring_bitmap_get_cardinality(bitmaps[i]);
+  }
+}
+
+void test_bitmap_intersection_matrix() {
+  DESCRIBE("bitmap_intersection_matrix_rows")
+  {
+    IT("Should fill a symmetric matrix around the cardinalities on the diagonal")
+    {
+      Bitmap* a = roaring_bitmap_from(1, 2, 3, 4);
+      Bitmap* b = roaring_bitmap_from(3, 4, 5);
+      Bitmap* empty = roaring_bitmap_create();
+      const Bitmap* bitmaps[] = {a, b, empty, a};
+      uint64_t matrix[16];
+
+      intersection_matrix_diagonal(4, bitmaps, matrix);
+      bitmap_intersection_matrix_rows(4, bitmaps, 0, 1, matrix);
+
+      uint64_t expected[] = {
+          4, 2, 0, 4,
+          2, 3, 0, 2,
+          0, 0, 0, 0,
+          4, 2, 0, 4
+      };
+      for (size_t i = 0; i < ARRAY_LENGTH(expected); i++) {
+        ASSERT_EQ(expected[i], matrix[i]);
+      }
+
+      roaring_bitmap_free(a);
+      roaring_bitmap_free(b);
+      roaring_bitmap_free(empty);
+    }
+
+    IT("Should give the same matrix when the rows are split")
+    {
+      const uint32_t n = 9;
+      Bitmap* bitmaps[9];
+      for (uint32_t i = 0; i < n; i++) {
+        bitmaps[i] = roaring_bitmap_create();
+        for (uint32_t v = 0; v < 100000; v += i + 2) {
+          roaring_bitmap_add(bitmaps[i], v);
+        }
+      }
+
+      uint64_t whole[81];
+      uint64_t split[81];
+      intersection_matrix_diagonal(n, (const Bitmap**) bitmaps, whole);
+      intersection_matrix_diagonal(n, (const Bitmap**) bitmaps, split);
+      bitmap_intersection_matrix_rows(n, (const Bitmap**) bitmaps, 0, 1, whole);
+      for (uint32_t first_row = 0; first_row < 4; first_row++) {
+        bitmap_intersection_matrix_rows(n, (const Bitmap**) bitmaps, first_row, 4, split);
+      }
+
+      for (uint32_t i = 0; i < n * n; i++) {
+        ASSERT_EQ(whole[i], split[i]);
+      }
+
+      for (uint32_t i = 0; i < n; i++) {
+        roaring_bitmap_free(bitmaps[i]);
+      }
+    }
+  }
+}
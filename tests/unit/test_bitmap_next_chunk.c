@@ -0,0 +1,90 @@
+#include "data-structure.h"
+#include "../test-utils.h"
+
+void test_bitmap_next_chunk() {
+  DESCRIBE("bitmap_next_chunk")
+  {
+    IT("Should return no chunk for an empty bitmap")
+    {
+      Bitmap* bitmap = roaring_bitmap_create();
+      roaring_uint32_iterator_t* iterator = roaring_iterator_create(bitmap);
+
+      ASSERT_EQ(0, bitmap_chunk_count(bitmap, 2));
+      ASSERT_NULL(bitmap_next_chunk(bitmap, iterator, 2));
+
+      roaring_uint32_iterator_free(iterator);
+      roaring_bitmap_free(bitmap);
+    }
+
+    IT("Should split the bitmap by containers")
+    {
+      Bitmap* bitmap = roaring_bitmap_from(1, 2, 65536, 131072, 131073, 4000000);
+      roaring_uint32_iterator_t* iterator = roaring_iterator_create(bitmap);
+
+      ASSERT_EQ(2, bitmap_chunk_count(bitmap, 2));
+
+      Bitmap* chunk = bitmap_next_chunk(bitmap, iterator, 2);
+      uint32_t expected1[] = { 1, 2, 65536 };
+      ASSERT_BITMAP_EQ_ARRAY(expected1, ARRAY_LENGTH(expected1), chunk);
+      roaring_bitmap_free(chunk);
+
+      chunk = bitmap_next_chunk(bitmap, iterator, 2);
+      uint32_t expected2[] = { 131072, 131073, 4000000 };
+      ASSERT_BITMAP_EQ_ARRAY(expected2, ARRAY_LENGTH(expected2), chunk);
+      roaring_bitmap_free(chunk);
+
+      ASSERT_NULL(bitmap_next_chunk(bitmap, iterator, 2));
+
+      roaring_uint32_iterator_free(iterator);
+      roaring_bitmap_free(bitmap);
+    }
+
+    IT("Should handle the last container")
+    {
+      Bitmap* bitmap = roaring_bitmap_from(5, UINT32_MAX - 1, UINT32_MAX);
+      roaring_uint32_iterator_t* iterator = roaring_iterator_create(bitmap);
+
+      ASSERT_EQ(2, bitmap_chunk_count(bitmap, 1));
+
+      Bitmap* chunk = bitmap_next_chunk(bitmap, iterator, 1);
+      uint32_t expected1[] = { 5 };
+      ASSERT_BITMAP_EQ_ARRAY(expected1, ARRAY_LENGTH(expected1), chunk);
+      roaring_bitmap_free(chunk);
+
+      chunk = bitmap_next_chunk(bitmap, iterator, 1);
+      uint32_t expected2[] = { UINT32_MAX - 1, UINT32_MAX };
+      ASSERT_BITMAP_EQ_ARRAY(expected2, ARRAY_LENGTH(expected2), chunk);
+      roaring_bitmap_free(chunk);
+
+      ASSERT_NULL(bitmap_next_chunk(bitmap, iterator, 1));
+
+      roaring_uint32_iterator_free(iterator);
+      roaring_bitmap_free(bitmap);
+    }
+  
+    IT("Should copy only the containers of sparse chunks")
+    {
+      Bitmap* bitmap = roaring_bitmap_create();
+      for (uint32_t key = 0; key < 16; key++) {
+        roaring_bitmap_add(bitmap, (key << 28) | key);
+      }
+      roaring_bitmap_add_range_closed(bitmap, 0xF0000000, 0xF000FFFF);
+      roaring_uint32_iterator_t* iterator = roaring_iterator_create(bitmap);
+
+      ASSERT_EQ(4, bitmap_chunk_count(bitmap, 4));
+      for (uint32_t i = 0; i < 4; i++) {
+        Bitmap* chunk = bitmap_next_chunk(bitmap, iterator, 4);
+        roaring_statistics_t stats;
+        roaring_bitmap_statistics(chunk, &stats);
+        ASSERT_EQ(4, stats.n_containers);
+        ASSERT_TRUE(roaring_bitmap_contains(chunk, ((i * 4) << 28) | (i * 4)));
+        ASSERT_TRUE(roaring_bitmap_contains(chunk, ((i * 4 + 3) << 28) | (i * 4 + 3)));
+        roaring_bitmap_free(chunk);
+      }
+      ASSERT_NULL(bitmap_next_chunk(bitmap, iterator, 4));
+
+      roaring_uint32_iterator_free(iterator);
+      roaring_bitmap_free(bitmap);
+    }
+  }
+}
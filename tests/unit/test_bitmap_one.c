@@ -219,5 +219,46 @@ void test_bitmap_one() {
       roaring_bitmap_free(bitmap2);
       roaring_bitmap_free(result);
     }
+
+    IT("Should keep the values set in exactly one of many bitmaps across containers")
+    {
+      const uint32_t n = 40;
+      Bitmap* sources[40];
+      for (uint32_t i = 0; i < n; i++) {
+        sources[i] = bitmap_alloc();
+        // value v is set in the first (v % 5 + 1) sources
+        for (uint32_t v = 0; v < 300000; v += 997) {
+          if (i < v % 5 + 1) {
+            bitmap_setbit(sources[i], v, 1);
+          }
+        }
+        // one value per source in its own container
+        bitmap_setbit(sources[i], (i + 10) * 65536, 1);
+      }
+
+      Bitmap* result = bitmap_alloc();
+      bitmap_one(result, n, (const Bitmap**) sources);
+
+      Bitmap* expected = bitmap_alloc();
+      for (uint32_t v = 0; v < 300000; v += 997) {
+        uint32_t count = 0;
+        for (uint32_t i = 0; i < n; i++) {
+          count += bitmap_getbit(sources[i], v);
+        }
+        if (count == 1) {
+          bitmap_setbit(expected, v, 1);
+        }
+      }
+      for (uint32_t i = 0; i < n; i++) {
+        bitmap_setbit(expected, (i + 10) * 65536, 1);
+      }
+      ASSERT_BITMAP_EQ(expected, result);
+
+      for (uint32_t i = 0; i < n; i++) {
+        bitmap_free(sources[i]);
+      }
+      bitmap_free(expected);
+      bitmap_free(result);
+    }
   }
 }
@@ -0,0 +1,63 @@
+#include "data-structure.h"
+#include "../test-utils.h"
+
+static Bitmap* operation_cardinality_source(uint32_t seed) {
+  Bitmap* bitmap = roaring_bitmap_create();
+  for (uint32_t v = 0; v < 200000; v += seed) {
+    roaring_bitmap_add(bitmap, v);
+  }
+  roaring_bitmap_add_range(bitmap, seed * 1000, seed * 1000 + 5000);
+  return bitmap;
+}
+
+void test_bitmap_operation_cardinality() {
+  DESCRIBE("bitmap_operation_cardinality")
+  {
+    int operations[] = {
+        BITMAP_OPERATION_AND, BITMAP_OPERATION_OR, BITMAP_OPERATION_XOR, BITMAP_OPERATION_ANDOR,
+        BITMAP_OPERATION_ONE, BITMAP_OPERATION_ANDNOT, BITMAP_OPERATION_ORNOT
+    };
+    void (*materialized[])(Bitmap*, uint32_t, const Bitmap**) = {
+        bitmap_and, bitmap_or, bitmap_xor, bitmap_andor, bitmap_one, bitmap_andnot, bitmap_ornot
+    };
+
+    IT("Should return 0 for an empty bitmap array")
+    {
+      for (size_t i = 0; i < ARRAY_LENGTH(operations); i++) {
+        ASSERT_EQ(0, bitmap_operation_cardinality(operations[i], 0, NULL));
+      }
+    }
+
+    IT("Should match the cardinality of the materialized operations")
+    {
+      Bitmap* a = operation_cardinality_source(3);
+      Bitmap* b = operation_cardinality_source(5);
+      Bitmap* c = operation_cardinality_source(7);
+      Bitmap* d = operation_cardinality_source(11);
+      Bitmap* empty = roaring_bitmap_create();
+      const Bitmap* bitmaps[] = {c, a, d, b};
+      const Bitmap* with_empty[] = {a, empty, b};
+
+      for (size_t i = 0; i < ARRAY_LENGTH(operations); i++) {
+        for (uint32_t n = 1; n <= ARRAY_LENGTH(bitmaps); n++) {
+          Bitmap* expected = roaring_bitmap_create();
+          materialized[i](expected, n, bitmaps);
+          ASSERT_EQ(roaring_bitmap_get_cardinality(expected), bitmap_operation_cardinality(operations[i], n, bitmaps));
+          roaring_bitmap_free(expected);
+        }
+
+        Bitmap* expected = roaring_bitmap_create();
+        materialized[i](expected, ARRAY_LENGTH(with_empty), with_empty);
+        ASSERT_EQ(roaring_bitmap_get_cardinality(expected),
+                  bitmap_operation_cardinality(operations[i], ARRAY_LENGTH(with_empty), with_empty));
+        roaring_bitmap_free(expected);
+      }
+
+      roaring_bitmap_free(a);
+      roaring_bitmap_free(b);
+      roaring_bitmap_free(c);
+      roaring_bitmap_free(d);
+      roaring_bitmap_free(empty);
+    }
+  }
+}
@@ -79,5 +79,33 @@ void test_bitmap_or() {
       bitmap_free(bitmap1);
       bitmap_free(bitmap2);
     }
+
+    IT("Should union many bitmaps spread over several containers")
+    {
+      const uint32_t n = 1000;
+      Bitmap** sources = malloc(n * sizeof(*sources));
+      for (uint32_t i = 0; i < n; i++) {
+        sources[i] = bitmap_alloc();
+        bitmap_setbit(sources[i], i, 1);
+        bitmap_setbit(sources[i], (i % 8) * 65536 + i, 1);
+      }
+
+      Bitmap* result = bitmap_alloc();
+      bitmap_setbit(result, 4000000, 1);
+      bitmap_or(result, n, (const Bitmap**) sources);
+
+      Bitmap* expected = bitmap_alloc();
+      for (uint32_t i = 0; i < n; i++) {
+        roaring_bitmap_or_inplace(expected, sources[i]);
+      }
+      ASSERT_BITMAP_EQ(expected, result);
+
+      for (uint32_t i = 0; i < n; i++) {
+        bitmap_free(sources[i]);
+      }
+      free(sources);
+      bitmap_free(expected);
+      bitmap_free(result);
+    }
   }
 }
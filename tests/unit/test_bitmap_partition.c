@@ -0,0 +1,120 @@
+#include "data-structure.h"
+#include "../test-utils.h"
+
+static Bitmap* partition_source(uint32_t seed, uint32_t n_containers) {
+  Bitmap* bitmap = roaring_bitmap_create();
+  for (uint32_t key = 0; key < n_containers; key++) {
+    for (uint32_t i = 0; i < 64; i++) {
+      roaring_bitmap_add(bitmap, (key << 16) | ((i * 37 + key * seed) & 0xFFFF));
+    }
+  }
+  roaring_bitmap_add_range_closed(bitmap, seed << 16, (seed << 16) | 0xFFFF);
+  return bitmap;
+}
+
+static Bitmap* partitioned_op(void (*operation)(Bitmap*, uint32_t, const Bitmap**), uint32_t n, const Bitmap** bitmaps,
+                              uint32_t n_parts, const uint16_t* first_keys) {
+  Bitmap* result = roaring_bitmap_create();
+  Bitmap* views = malloc(n * sizeof(*views));
+  const Bitmap** view_ptrs = malloc(n * sizeof(*view_ptrs));
+
+  for (uint32_t part = 0; part < n_parts; part++) {
+    uint16_t last_key = part + 1 < n_parts ? first_keys[part + 1] - 1 : UINT16_MAX;
+    for (uint32_t i = 0; i < n; i++) {
+      bitmap_container_range_view(bitmaps[i], first_keys[part], last_key, &views[i]);
+      view_ptrs[i] = &views[i];
+    }
+
+    Bitmap* partial = roaring_bitmap_create();
+    operation(partial, n, view_ptrs);
+    roaring_bitmap_or_inplace(result, partial);
+    roaring_bitmap_free(partial);
+  }
+
+  free(view_ptrs);
+  free(views);
+  return result;
+}
+
+void test_bitmap_partition() {
+  DESCRIBE("bitmap_container_range_view")
+  {
+    IT("Should only expose the containers in the key range")
+    {
+      Bitmap* bitmap = roaring_bitmap_from(1, 65536 + 2, 2 * 65536 + 3, 5 * 65536 + 4);
+      Bitmap view;
+
+      bitmap_container_range_view(bitmap, 1, 4, &view);
+      uint32_t expected[] = {65536 + 2, 2 * 65536 + 3};
+      ASSERT_BITMAP_EQ_ARRAY(expected, ARRAY_LENGTH(expected), &view);
+
+      bitmap_container_range_view(bitmap, 6, UINT16_MAX, &view);
+      ASSERT_EQ(0, roaring_bitmap_get_cardinality(&view));
+
+      roaring_bitmap_free(bitmap);
+    }
+  }
+
+  DESCRIBE("bitmap_partition_keys")
+  {
+    IT("Should not split small inputs")
+    {
+      Bitmap* a = partition_source(3, 4);
+      Bitmap* b = partition_source(5, 4);
+      const Bitmap* bitmaps[] = {a, b};
+      uint16_t first_keys[8];
+
+      ASSERT_EQ(1, bitmap_partition_keys(2, bitmaps, 8, 256, first_keys));
+      ASSERT_EQ(0, first_keys[0]);
+
+      roaring_bitmap_free(a);
+      roaring_bitmap_free(b);
+    }
+
+    IT("Should split into increasing key ranges")
+    {
+      Bitmap* a = partition_source(3, 200);
+      Bitmap* b = partition_source(5, 100);
+      const Bitmap* bitmaps[] = {a, b};
+      uint16_t first_keys[4];
+
+      uint32_t n_parts = bitmap_partition_keys(2, bitmaps, 4, 16, first_keys);
+      ASSERT_EQ(4, n_parts);
+      ASSERT_EQ(0, first_keys[0]);
+      for (uint32_t i = 1; i < n_parts; i++) {
+        ASSERT_TRUE(first_keys[i] > first_keys[i - 1]);
+      }
+
+      roaring_bitmap_free(a);
+      roaring_bitmap_free(b);
+    }
+
+    IT("Should give the same result as the whole operation")
+    {
+      Bitmap* a = partition_source(3, 300);
+      Bitmap* b = partition_source(7, 200);
+      Bitmap* c = partition_source(11, 250);
+      const Bitmap* bitmaps[] = {a, b, c};
+      uint16_t first_keys[8];
+      uint32_t n_parts = bitmap_partition_keys(3, bitmaps, 8, 1, first_keys);
+
+      void (*operations[])(Bitmap*, uint32_t, const Bitmap**) = {
+          bitmap_or, bitmap_and, bitmap_xor, bitmap_andor, bitmap_one, bitmap_andnot, bitmap_ornot
+      };
+      for (size_t i = 0; i < ARRAY_LENGTH(operations); i++) {
+        Bitmap* expected = roaring_bitmap_create();
+        operations[i](expected, 3, bitmaps);
+        Bitmap* actual = partitioned_op(operations[i], 3, bitmaps, n_parts, first_keys);
+
+        ASSERT_TRUE(roaring_bitmap_equals(expected, actual));
+
+        roaring_bitmap_free(expected);
+        roaring_bitmap_free(actual);
+      }
+
+      roaring_bitmap_free(a);
+      roaring_bitmap_free(b);
+      roaring_bitmap_free(c);
+    }
+  }
+}
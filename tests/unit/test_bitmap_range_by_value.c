@@ -0,0 +1,67 @@
+#include "data-structure.h"
+#include "../test-utils.h"
+
+void test_bitmap_range_by_value() {
+  DESCRIBE("bitmap_range_by_value")
+  {
+    IT("Should count the values in the window")
+    {
+      Bitmap* bitmap = roaring_bitmap_from(1, 5, 7, 9, 12);
+
+      ASSERT_EQ(2, bitmap_range_cardinality(bitmap, 2, 7));
+      ASSERT_EQ(5, bitmap_range_cardinality(bitmap, 0, 12));
+      ASSERT_EQ(0, bitmap_range_cardinality(bitmap, 13, 100));
+
+      roaring_bitmap_free(bitmap);
+    }
+
+    IT("Should read the values in the window")
+    {
+      Bitmap* bitmap = roaring_bitmap_from(1, 5, 7, 9, 12);
+      size_t n;
+
+      uint32_t* values = bitmap_range_by_value(bitmap, 2, 10, 0, UINT64_MAX, &n);
+      uint32_t expected[] = { 5, 7, 9 };
+      ASSERT_ARRAY_EQ(expected, values, ARRAY_LENGTH(expected), n);
+
+      free(values);
+      roaring_bitmap_free(bitmap);
+    }
+
+    IT("Should apply offset and count")
+    {
+      Bitmap* bitmap = roaring_bitmap_from(1, 5, 7, 9, 12);
+      size_t n;
+
+      uint32_t* values = bitmap_range_by_value(bitmap, 2, 10, 1, 5, &n);
+      uint32_t expected1[] = { 7, 9 };
+      ASSERT_ARRAY_EQ(expected1, values, ARRAY_LENGTH(expected1), n);
+      free(values);
+
+      values = bitmap_range_by_value(bitmap, 0, 12, 1, 2, &n);
+      uint32_t expected2[] = { 5, 7 };
+      ASSERT_ARRAY_EQ(expected2, values, ARRAY_LENGTH(expected2), n);
+      free(values);
+
+      values = bitmap_range_by_value(bitmap, 2, 10, 3, 5, &n);
+      ASSERT_EQ(0, n);
+      free(values);
+
+      roaring_bitmap_free(bitmap);
+    }
+
+    IT("Should read windows across containers")
+    {
+      Bitmap* bitmap = roaring_bitmap_create();
+      roaring_bitmap_add_range_closed(bitmap, 65000, 140000);
+      size_t n;
+
+      uint32_t* values = bitmap_range_by_value(bitmap, 65530, 200000, 2, 4, &n);
+      uint32_t expected[] = { 65532, 65533, 65534, 65535 };
+      ASSERT_ARRAY_EQ(expected, values, ARRAY_LENGTH(expected), n);
+
+      free(values);
+      roaring_bitmap_free(bitmap);
+    }
+  }
+}
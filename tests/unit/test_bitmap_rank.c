@@ -0,0 +1,29 @@
+#include "data-structure.h"
+#include "../test-utils.h"
+
+void test_bitmap_rank() {
+  DESCRIBE("bitmap_rank")
+  {
+    IT("Should count the elements smaller or equal to the value")
+    {
+      Bitmap* bitmap = roaring_bitmap_from(1, 10, 100, 1000);
+
+      ASSERT_EQ(0, bitmap_rank(bitmap, 0));
+      ASSERT_EQ(1, bitmap_rank(bitmap, 1));
+      ASSERT_EQ(2, bitmap_rank(bitmap, 50));
+      ASSERT_EQ(4, bitmap_rank(bitmap, 1000));
+      ASSERT_EQ(4, bitmap_rank(bitmap, UINT32_MAX));
+
+      roaring_bitmap_free(bitmap);
+    }
+
+    IT("Should return 0 for an empty bitmap")
+    {
+      Bitmap* bitmap = roaring_bitmap_create();
+
+      ASSERT_EQ(0, bitmap_rank(bitmap, 100));
+
+      roaring_bitmap_free(bitmap);
+    }
+  }
+}
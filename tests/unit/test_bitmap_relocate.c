@@ -0,0 +1,79 @@
+#include "data-structure.h"
+#include "../test-utils.h"
+
+typedef struct {
+  uint32_t relocations;
+  uint32_t checks;
+  uint32_t stop_after;
+} RelocateCounter;
+
+static void* count_relocation(void* ptr, void* arg) {
+  (void) ptr;
+  ((RelocateCounter*) arg)->relocations++;
+  return NULL;
+}
+
+static bool stop_after_checks(void* arg) {
+  RelocateCounter* counter = arg;
+  return ++counter->checks >= counter->stop_after;
+}
+
+void test_bitmap_relocate() {
+  DESCRIBE("bitmap_relocate")
+  {
+    IT("Should visit every container when not stopped")
+    {
+      Bitmap* bitmap = roaring_bitmap_from(1, 65536 + 2, 2 * 65536 + 3);
+      RelocateCounter counter = {.stop_after = UINT32_MAX};
+
+      ASSERT_EQ(0, bitmap_relocate(bitmap, 0, count_relocation, stop_after_checks, &counter));
+      ASSERT_EQ(2, counter.checks);
+      ASSERT_TRUE(counter.relocations > 3);
+
+      roaring_bitmap_free(bitmap);
+    }
+
+    IT("Should resume from the returned container")
+    {
+      Bitmap* bitmap = roaring_bitmap_create();
+      for (uint32_t key = 0; key < 10; key++) {
+        roaring_bitmap_add(bitmap, key << 16);
+      }
+      RelocateCounter counter = {.stop_after = 4};
+
+      uint32_t cursor = bitmap_relocate(bitmap, 0, count_relocation, stop_after_checks, &counter);
+      ASSERT_EQ(4, cursor);
+
+      counter.checks = 0;
+      counter.stop_after = UINT32_MAX;
+      ASSERT_EQ(0, bitmap_relocate(bitmap, cursor, count_relocation, stop_after_checks, &counter));
+      ASSERT_EQ(5, counter.checks);
+
+      uint32_t expected[] = {0, 1 << 16, 2 << 16, 3 << 16, 4 << 16, 5 << 16, 6 << 16, 7 << 16, 8 << 16, 9 << 16};
+      ASSERT_BITMAP_EQ_ARRAY(expected, ARRAY_LENGTH(expected), bitmap);
+
+      roaring_bitmap_free(bitmap);
+    }
+
+    IT("Should leave empty and frozen bitmaps alone")
+    {
+      Bitmap* empty = roaring_bitmap_create();
+      RelocateCounter counter = {.stop_after = UINT32_MAX};
+      ASSERT_EQ(0, bitmap_relocate(empty, 0, count_relocation, stop_after_checks, &counter));
+      ASSERT_EQ(0, counter.checks);
+
+      Bitmap* bitmap = roaring_bitmap_from(1, 2, 65536 + 3);
+      char* buffer = malloc(roaring_bitmap_portable_size_in_bytes(bitmap));
+      roaring_bitmap_portable_serialize(bitmap, buffer);
+      Bitmap* frozen = roaring_bitmap_portable_deserialize_frozen(buffer);
+
+      ASSERT_EQ(0, bitmap_relocate(frozen, 0, count_relocation, stop_after_checks, &counter));
+      ASSERT_EQ(0, counter.relocations);
+
+      roaring_bitmap_free(frozen);
+      free(buffer);
+      roaring_bitmap_free(bitmap);
+      roaring_bitmap_free(empty);
+    }
+  }
+}
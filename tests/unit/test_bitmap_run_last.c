@@ -0,0 +1,50 @@
+#include "data-structure.h"
+#include "../test-utils.h"
+
+void test_bitmap_run_last() {
+  DESCRIBE("bitmap_run_last")
+  {
+    IT("Should return start for an isolated value")
+    {
+      Bitmap* bitmap = roaring_bitmap_from(1, 3, 7);
+
+      ASSERT_EQ(1, bitmap_run_last(bitmap, 1));
+      ASSERT_EQ(3, bitmap_run_last(bitmap, 3));
+      ASSERT_EQ(7, bitmap_run_last(bitmap, 7));
+
+      roaring_bitmap_free(bitmap);
+    }
+
+    IT("Should find the end of a run")
+    {
+      Bitmap* bitmap = roaring_bitmap_from(1, 2, 3, 7);
+
+      ASSERT_EQ(3, bitmap_run_last(bitmap, 1));
+      ASSERT_EQ(3, bitmap_run_last(bitmap, 2));
+
+      roaring_bitmap_free(bitmap);
+    }
+
+    IT("Should find the end of a run spanning several containers")
+    {
+      Bitmap* bitmap = roaring_bitmap_from_range(100, 1000000, 1);
+      roaring_bitmap_add(bitmap, 1000001);
+
+      ASSERT_EQ(999999, bitmap_run_last(bitmap, 100));
+      ASSERT_EQ(999999, bitmap_run_last(bitmap, 65536));
+      ASSERT_EQ(1000001, bitmap_run_last(bitmap, 1000001));
+
+      roaring_bitmap_free(bitmap);
+    }
+
+    IT("Should stop at UINT32_MAX")
+    {
+      Bitmap* bitmap = roaring_bitmap_from_range(UINT32_MAX - 100, (uint64_t) UINT32_MAX + 1, 1);
+
+      ASSERT_EQ(UINT32_MAX, bitmap_run_last(bitmap, UINT32_MAX - 100));
+      ASSERT_EQ(UINT32_MAX, bitmap_run_last(bitmap, UINT32_MAX));
+
+      roaring_bitmap_free(bitmap);
+    }
+  }
+}
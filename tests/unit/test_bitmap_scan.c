@@ -0,0 +1,57 @@
+#include "data-structure.h"
+#include "../test-utils.h"
+
+void test_bitmap_scan() {
+  DESCRIBE("bitmap_scan")
+  {
+    IT("Should read up to count values from the cursor")
+    {
+      Bitmap* bitmap = roaring_bitmap_from(1, 5, 7, 9, 65536, 4294967295);
+      size_t n;
+      bool has_more;
+
+      uint32_t* values = bitmap_scan(bitmap, 2, 2, &n, &has_more);
+      uint32_t expected[] = { 5, 7 };
+      ASSERT_ARRAY_EQ(expected, values, ARRAY_LENGTH(expected), n);
+      ASSERT_TRUE(has_more);
+
+      free(values);
+      roaring_bitmap_free(bitmap);
+    }
+
+    IT("Should page through the whole bitmap")
+    {
+      Bitmap* bitmap = roaring_bitmap_from(1, 5, 7, 9, 65536, 4294967295);
+      size_t n;
+      bool has_more;
+
+      uint32_t* values = bitmap_scan(bitmap, 0, 4, &n, &has_more);
+      uint32_t expected1[] = { 1, 5, 7, 9 };
+      ASSERT_ARRAY_EQ(expected1, values, ARRAY_LENGTH(expected1), n);
+      ASSERT_TRUE(has_more);
+      free(values);
+
+      values = bitmap_scan(bitmap, 10, 4, &n, &has_more);
+      uint32_t expected2[] = { 65536, 4294967295 };
+      ASSERT_ARRAY_EQ(expected2, values, ARRAY_LENGTH(expected2), n);
+      ASSERT_FALSE(has_more);
+      free(values);
+
+      roaring_bitmap_free(bitmap);
+    }
+
+    IT("Should return nothing past the maximum")
+    {
+      Bitmap* bitmap = roaring_bitmap_from(1, 5);
+      size_t n;
+      bool has_more;
+
+      uint32_t* values = bitmap_scan(bitmap, 6, 10, &n, &has_more);
+      ASSERT_EQ(0, n);
+      ASSERT_FALSE(has_more);
+
+      free(values);
+      roaring_bitmap_free(bitmap);
+    }
+  }
+}
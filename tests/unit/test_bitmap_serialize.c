@@ -0,0 +1,62 @@
+#include "data-structure.h"
+#include "../test-utils.h"
+
+void test_bitmap_serialize() {
+  DESCRIBE("bitmap_serialize")
+  {
+    IT("Should round trip a bitmap")
+    {
+      Bitmap* bitmap = roaring_bitmap_from(1, 2, 3, 100000, 4294967295);
+      size_t size;
+      char* serialized = bitmap_serialize(bitmap, &size);
+
+      Bitmap* result = bitmap_deserialize(serialized, size);
+      ASSERT_NOT_NULL(result);
+      ASSERT_BITMAP_EQ(bitmap, result);
+
+      free(serialized);
+      roaring_bitmap_free(result);
+      roaring_bitmap_free(bitmap);
+    }
+
+    IT("Should round trip an empty bitmap")
+    {
+      Bitmap* bitmap = roaring_bitmap_create();
+      size_t size;
+      char* serialized = bitmap_serialize(bitmap, &size);
+
+      Bitmap* result = bitmap_deserialize(serialized, size);
+      ASSERT_NOT_NULL(result);
+      ASSERT_TRUE(bitmap_is_empty(result));
+
+      free(serialized);
+      roaring_bitmap_free(result);
+      roaring_bitmap_free(bitmap);
+    }
+
+    IT("Should reject truncated and oversized buffers")
+    {
+      Bitmap* bitmap = roaring_bitmap_from(1, 2, 3, 100000, 4294967295);
+      size_t size;
+      char* serialized = bitmap_serialize(bitmap, &size);
+
+      ASSERT_NULL(bitmap_deserialize(serialized, size - 1));
+
+      char* padded = malloc(size + 1);
+      memcpy(padded, serialized, size);
+      padded[size] = 0;
+      ASSERT_NULL(bitmap_deserialize(padded, size + 1));
+
+      free(padded);
+      free(serialized);
+      roaring_bitmap_free(bitmap);
+    }
+
+    IT("Should reject garbage")
+    {
+      const char garbage[] = "garbage";
+      ASSERT_NULL(bitmap_deserialize(garbage, sizeof(garbage) - 1));
+      ASSERT_NULL(bitmap_deserialize(garbage, 0));
+    }
+  }
+}
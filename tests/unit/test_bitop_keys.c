@@ -50,5 +50,70 @@ void test_bitop_keys() {
       ASSERT(BitOpForEachKeyPosition("OR", 4, NULL, NULL) == 0, "variadic BITOP needs at least 3 keys");
       ASSERT(BitOpForEachKeyPosition("NOT", 6, NULL, NULL) == 0, "NOT should reject extra non-key arguments");
     }
+
+    IT("Should report only source keys for read-only operations")
+    {
+      BitOpKeyRecorder recorder = {0};
+      size_t count = BitOpReadForEachKeyPosition("ANDOR", 5, &recorder, record_bitop_key);
+
+      ASSERT(count == 3, "expected 3 keys, got %zu", count);
+      ASSERT(recorder.count == 3, "expected 3 recorded keys, got %zu", recorder.count);
+      for (size_t i = 0; i < recorder.count; i++) {
+        ASSERT(recorder.keys[i].pos == (int) i + 2, "expected source at position %zu", i + 2);
+        ASSERT(recorder.keys[i].flags == (REDISMODULE_CMD_KEY_RO | REDISMODULE_CMD_KEY_ACCESS), "unexpected source flags");
+      }
+
+      ASSERT(BitOpReadForEachKeyPosition("NOT", 4, NULL, NULL) == 0, "NOT has no read-only variant");
+      ASSERT(BitOpReadForEachKeyPosition("OR", 3, NULL, NULL) == 0, "read-only BITOP needs at least 2 keys");
+    }
+
+    IT("Should not report a trailing LIMIT as keys")
+    {
+      ASSERT(BitOpGetKeysEnd(6, "LIMIT") == 4, "LIMIT after two keys ends the key list");
+      ASSERT(BitOpGetKeysEnd(6, "src3") == 6, "without LIMIT every argument is a key");
+      ASSERT(BitOpGetKeysEnd(5, "LIMIT") == 3, "LIMIT after a single key is not a key either");
+      ASSERT(BitOpGetKeysEnd(4, "LIMIT") == 4, "LIMIT needs a key before it");
+      ASSERT(BitOpReadForEachKeyPosition("AND", BitOpGetKeysEnd(5, "LIMIT"), NULL, NULL) == 0,
+             "LIMIT after a single key reports no keys");
+
+      BitOpKeyRecorder recorder = {0};
+      size_t count = BitOpReadForEachKeyPosition("AND", BitOpGetKeysEnd(6, "LIMIT"), &recorder, record_bitop_key);
+      ASSERT(count == 2, "expected 2 keys, got %zu", count);
+      ASSERT(recorder.keys[1].pos == 3, "expected last key at position 3");
+    }
+
+    IT("Should not report a trailing METRIC as keys")
+    {
+      ASSERT(SimilarityKeysEnd(4, "METRIC") == 2, "METRIC after one key ends the key list");
+      ASSERT(SimilarityKeysEnd(4, "key2") == 4, "without METRIC every argument is a key");
+      ASSERT(SimilarityKeysEnd(3, "METRIC") == 3, "METRIC needs a key before it");
+    }
+
+    IT("Should report the query and candidate keys of TOPK")
+    {
+      BitOpKeyRecorder recorder = {0};
+      size_t count = TopKForEachKeyPosition(7, "cand1", "cand3", "METRIC", &recorder, record_bitop_key);
+
+      ASSERT(count == 3, "expected 3 keys, got %zu", count);
+      ASSERT(recorder.keys[0].pos == 1, "expected query at position 1");
+      ASSERT(recorder.keys[1].pos == 3, "expected first candidate at position 3");
+      ASSERT(recorder.keys[2].pos == 4, "expected second candidate at position 4");
+    }
+
+    IT("Should report the set key but no candidates for TOPK sources")
+    {
+      BitOpKeyRecorder recorder = {0};
+      size_t count = TopKForEachKeyPosition(5, "MEMBERS", NULL, "MEMBERS", &recorder, record_bitop_key);
+
+      ASSERT(count == 2, "expected 2 keys, got %zu", count);
+      ASSERT(recorder.keys[1].pos == 4, "expected set key at position 4");
+
+      ASSERT(TopKForEachKeyPosition(7, "MATCH", "COUNT", "COUNT", NULL, NULL) == 1, "MATCH candidates are only known at runtime");
+      ASSERT(TopKForEachKeyPosition(9, "MATCH", "COUNT", "METRIC", NULL, NULL) == 1, "MATCH with COUNT and METRIC");
+      ASSERT(TopKForEachKeyPosition(7, "MATCH", "METRIC", "METRIC", NULL, NULL) == 1, "MATCH without COUNT is still MATCH");
+      ASSERT(TopKForEachKeyPosition(7, "MATCH", "key2", "key2", NULL, NULL) == 5, "MATCH followed by three keys is a key list");
+      ASSERT(TopKForEachKeyPosition(6, "MATCH", "key1", "key1", NULL, NULL) == 4, "MATCH followed by two keys is a key list");
+      ASSERT(TopKForEachKeyPosition(3, "k", NULL, "query", NULL, NULL) == 0, "TOPK needs at least one candidate");
+    }
   }
 }
@@ -0,0 +1,84 @@
+#include "similarity.h"
+#include "../test-utils.h"
+
+void test_similarity() {
+  DESCRIBE("similarity_score")
+  {
+    IT("Should compute every metric from the intersection and cardinalities")
+    {
+      ASSERT_TRUE(similarity_score(SIMILARITY_JACCARD, 2, 3, 3) == 0.5);
+      ASSERT_TRUE(similarity_score(SIMILARITY_OVERLAP, 2, 4, 2) == 1);
+      ASSERT_TRUE(similarity_score(SIMILARITY_COSINE, 2, 4, 4) == 0.5);
+      ASSERT_TRUE(similarity_score(SIMILARITY_INTERSECTION, 7, 10, 20) == 7);
+    }
+
+    IT("Should return -1 for empty sets")
+    {
+      ASSERT_TRUE(similarity_score(SIMILARITY_JACCARD, 0, 0, 0) == -1);
+      ASSERT_TRUE(similarity_score(SIMILARITY_OVERLAP, 0, 0, 5) == -1);
+      ASSERT_TRUE(similarity_score(SIMILARITY_COSINE, 0, 5, 0) == -1);
+    }
+
+    IT("Should bound the score by the containment of the smallest set")
+    {
+      ASSERT_TRUE(similarity_upper_bound(SIMILARITY_JACCARD, 10, 40) == 0.25);
+      ASSERT_TRUE(similarity_upper_bound(SIMILARITY_INTERSECTION, 10, 40) == 10);
+      ASSERT_TRUE(similarity_upper_bound(SIMILARITY_OVERLAP, 10, 40) == 1);
+    }
+  }
+
+  DESCRIBE("similarity_topk")
+  {
+    IT("Should keep the k highest scores in decreasing order")
+    {
+      SimilarityTopK topk;
+      similarity_topk_init(&topk, 3);
+
+      double scores[] = {0.1, 0.9, 0.4, 0.3, 0.8, 0.2, 0.5};
+      for (size_t i = 0; i < ARRAY_LENGTH(scores); i++) {
+        similarity_topk_push(&topk, (SimilarityCandidate) {.score = scores[i], .item = &scores[i]});
+      }
+
+      ASSERT_EQ(3, topk.size);
+      ASSERT_FALSE(similarity_topk_accepts(&topk, 0.5));
+      ASSERT_TRUE(similarity_topk_accepts(&topk, 0.6));
+
+      similarity_topk_sort(&topk);
+      ASSERT_TRUE(topk.heap[0].score == 0.9);
+      ASSERT_TRUE(topk.heap[1].score == 0.8);
+      ASSERT_TRUE(topk.heap[2].score == 0.5);
+      ASSERT_TRUE(topk.heap[0].item == &scores[1]);
+
+      similarity_topk_free(&topk);
+    }
+
+    IT("Should not allocate K entries up front")
+    {
+      SimilarityTopK topk;
+      similarity_topk_init(&topk, UINT32_MAX);
+
+      for (uint32_t i = 0; i < 100; i++) {
+        similarity_topk_push(&topk, (SimilarityCandidate) {.score = i});
+      }
+
+      ASSERT_EQ(100, topk.size);
+      ASSERT_TRUE(topk.capacity < 1000);
+
+      similarity_topk_sort(&topk);
+      for (uint32_t i = 0; i < 100; i++) {
+        ASSERT_TRUE(topk.heap[i].score == 99 - i);
+      }
+
+      similarity_topk_free(&topk);
+    }
+
+    IT("Should accept nothing when k is 0")
+    {
+      SimilarityTopK topk;
+      similarity_topk_init(&topk, 0);
+      similarity_topk_push(&topk, (SimilarityCandidate) {.score = 1});
+      ASSERT_EQ(0, topk.size);
+      similarity_topk_free(&topk);
+    }
+  }
+}